@@ -0,0 +1,129 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "../include/docker_monitor.h"
+#include "../include/alert_engine.h"
+
+/* times alert_engine_evaluate over a synthetic table: every container gets a
+   new sample each tick and every 16 ticks its values step across some of
+   the thresholds, so rules keep moving between pending, firing and resolved */
+
+static const char *rules[] = {
+    "cpu_high: cpu_percent > 80 for 30s",
+    "cpu_busy: cpu_percent > 50",
+    "cpu_idle: cpu_percent < 1 for 5m",
+    "cpu_rising: rate(cpu_percent) > 20/min",
+    "cpu_falling: rate(cpu_percent) < -20/min for 10s",
+    "mem_high: memory_percent > 90 for 30s",
+    "mem_warn: memory_percent >= 75",
+    "mem_low: memory_percent <= 5",
+    "mem_leak: rate(memory_working_set) > 10M/min for 2m",
+    "ws_big: memory_working_set > 1G",
+    "rx_high: network_rx_rate > 10M",
+    "tx_high: network_tx_rate > 10M",
+    "rx_burst: rate(network_rx_rate) > 1M/s",
+    "tx_burst: rate(network_tx_rate) > 1M/s",
+    "read_high: block_read_rate > 50M for 15s",
+    "write_high: block_write_rate > 50M for 15s",
+    "read_idle: block_read_rate < 1",
+    "write_spike: rate(block_write_rate) > 5M/s",
+    "cpu_steady: cpu_percent >= 10 for 1h",
+    "restart",
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void advance(monitor_state_t *state, uint64_t tick) {
+    for (int i = 0; i < state->container_slots; i++) {
+        container_monitor_t *container = &state->containers[i];
+        unsigned phase = (unsigned)(tick / 16 * 7 + i * 13);
+        
+        container->stats.sample_ns = (tick + 1) * 1000000000ULL;
+        container->stats.cpu_usage += 1000000;
+        container->cpu_percent = phase % 100;
+        container->memory_percent = (phase * 3) % 100;
+        container->memory_working_set = (uint64_t)container->memory_percent * 20 * 1024 * 1024;
+        container->network_rx_rate = (phase % 40) * 512.0 * 1024;
+        container->network_tx_rate = (phase % 30) * 512.0 * 1024;
+        container->block_read_rate = (phase % 120) * 1024.0 * 1024;
+        container->block_write_rate = (phase % 90) * 1024.0 * 1024;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int containers = 500;
+    double benchtime = 1.0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n': containers = atoi(optarg); break;
+        case 't': benchtime = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n containers] [-t seconds]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (containers <= 0 || benchtime <= 0) {
+        fprintf(stderr, "usage: %s [-n containers] [-t seconds]\n", argv[0]);
+        return 1;
+    }
+    
+    monitor_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.containers = calloc(containers, sizeof(container_monitor_t));
+    if (!state.containers) {
+        return 1;
+    }
+    state.container_slots = containers;
+    state.container_count = containers;
+    for (int i = 0; i < containers; i++) {
+        container_monitor_t *container = &state.containers[i];
+        snprintf(container->info.id, sizeof(container->info.id), "%064x", i);
+        snprintf(container->info.name, sizeof(container->info.name), "bench-%d", i);
+        container->in_use = 1;
+        container->is_running = 1;
+    }
+    
+    alert_engine_t *engine = alert_engine_create();
+    int rule_count = sizeof(rules) / sizeof(rules[0]);
+    if (!engine || alert_engine_set_log(engine, "/dev/null") != 0) {
+        return 1;
+    }
+    for (int i = 0; i < rule_count; i++) {
+        if (alert_engine_add_rule(engine, rules[i]) != 0) {
+            fprintf(stderr, "bad rule: %s\n", rules[i]);
+            return 1;
+        }
+    }
+    
+    uint64_t tick = 0;
+    long transitions = 0;
+    long iterations = 0;
+    double evaluating = 0.0;
+    double start = now_seconds();
+    
+    /* only the evaluation is timed, not the synthetic update before it */
+    while (now_seconds() - start < benchtime) {
+        advance(&state, tick++);
+        double before = now_seconds();
+        transitions += alert_engine_evaluate(engine, &state);
+        evaluating += now_seconds() - before;
+        iterations++;
+    }
+    
+    printf("BenchmarkAlertEvaluate/%dx%d\t%10ld\t%12.0f ns/op\t%8.1f ns/container\t%8.1f transitions/op\n",
+           containers, rule_count, iterations, evaluating * 1e9 / iterations,
+           evaluating * 1e9 / iterations / containers, (double)transitions / iterations);
+    
+    alert_engine_destroy(engine);
+    free(state.containers);
+    return 0;
+}
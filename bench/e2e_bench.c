@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "../include/docker_monitor.h"
+#include "../include/docker_api.h"
+#include "../include/docker_events.h"
+
+/* runs the real list/stats path against bench/fake_dockerd for each
+   container count and prints one JSON line per run. The monitor side runs
+   in a child of its own so CPU time and peak RSS belong to it alone */
+
+#define MAX_TICKS 10000
+
+typedef struct {
+    int ok;
+    int containers_seen;
+    double first_tick_ms;
+    double tick_ms_p50;
+    double tick_ms_p95;
+    double tick_ms_max;
+    double requests_per_sec;
+    double cpu_ms_per_tick;
+} run_result_t;
+
+typedef struct {
+    const char *daemon;
+    int ticks;
+    int workers;
+    int latency_ms;
+    int cpus;
+    int use_events;
+} bench_options_t;
+
+static double now_ms(void);
+static double cpu_ms(void);
+static int compare_double(const void *a, const void *b);
+static pid_t start_daemon(const bench_options_t *options, const char *socket_path, int containers);
+static int wait_for_socket(const char *socket_path);
+static void run_monitor(const bench_options_t *options, const char *socket_path, int containers,
+                        run_result_t *result);
+static int run_scenario(const bench_options_t *options, int containers);
+static void usage(const char *program);
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static double cpu_ms(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static pid_t start_daemon(const bench_options_t *options, const char *socket_path, int containers) {
+    char count[16], latency[16], cpus[16];
+    pid_t pid;
+    
+    snprintf(count, sizeof(count), "%d", containers);
+    snprintf(latency, sizeof(latency), "%d", options->latency_ms);
+    snprintf(cpus, sizeof(cpus), "%d", options->cpus);
+    
+    pid = fork();
+    if (pid == 0) {
+        execl(options->daemon, options->daemon, "-s", socket_path, "-n", count, "-l", latency, "-c", cpus,
+              (char *)NULL);
+        perror(options->daemon);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int wait_for_socket(const char *socket_path) {
+    struct sockaddr_un addr;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    
+    for (int attempt = 0; attempt < 500; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            close(fd);
+            return 0;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        usleep(10000);
+    }
+    return -1;
+}
+
+/* the same calls main() makes for one host, minus the output */
+static void run_monitor(const bench_options_t *options, const char *socket_path, int containers,
+                        run_result_t *result) {
+    static double ticks_ms[MAX_TICKS];
+    monitor_state_t state;
+    http_pool_stats_t before, after;
+    
+    memset(&state, 0, sizeof(state));
+    memset(result, 0, sizeof(*result));
+    snprintf(state.config.host, sizeof(state.config.host), "%s%s", UNIX_HOST_PREFIX, socket_path);
+    
+    monitor_add_host(&state, state.config.host);
+    state.hosts[0].client = docker_client_create(&state.config);
+    if (!state.hosts[0].client || docker_client_connect(state.hosts[0].client) != 0) {
+        cleanup_monitor_state(&state);
+        return;
+    }
+    if (options->use_events) {
+        state.hosts[0].events = docker_events_create(state.hosts[0].client, 0);
+    }
+    init_monitor_state(&state, 1, options->workers);
+    
+    /* the first tick pays for the full list and for opening connections */
+    double start = now_ms();
+    if (refresh_container_list(&state) != 0 || get_container_stats(&state) != 0) {
+        cleanup_monitor_state(&state);
+        return;
+    }
+    result->first_tick_ms = now_ms() - start;
+    
+    docker_client_get_pool_stats(state.hosts[0].client, &before);
+    double cpu_start = cpu_ms();
+    double run_start = now_ms();
+    for (int tick = 0; tick < options->ticks; tick++) {
+        start = now_ms();
+        if (refresh_container_list(&state) != 0 || get_container_stats(&state) != 0) {
+            cleanup_monitor_state(&state);
+            return;
+        }
+        ticks_ms[tick] = now_ms() - start;
+    }
+    double elapsed = now_ms() - run_start;
+    result->cpu_ms_per_tick = (cpu_ms() - cpu_start) / options->ticks;
+    docker_client_get_pool_stats(state.hosts[0].client, &after);
+    
+    qsort(ticks_ms, options->ticks, sizeof(double), compare_double);
+    result->tick_ms_p50 = ticks_ms[(options->ticks - 1) / 2];
+    result->tick_ms_p95 = ticks_ms[(int)(options->ticks * 0.95 + 0.999999) - 1];
+    result->tick_ms_max = ticks_ms[options->ticks - 1];
+    result->requests_per_sec = elapsed > 0 ? (after.requests - before.requests) * 1e3 / elapsed : 0;
+    
+    /* a run that lost containers or samples measured the wrong thing */
+    for (int i = 0; i < state.container_slots; i++) {
+        if (state.containers[i].in_use && state.containers[i].stats.memory_limit > 0) {
+            result->containers_seen++;
+        }
+    }
+    result->ok = result->containers_seen == containers;
+    
+    cleanup_monitor_state(&state);
+}
+
+static int run_scenario(const bench_options_t *options, int containers) {
+    char socket_path[108];
+    run_result_t result;
+    struct rusage usage;
+    int status;
+    int pipe_fds[2];
+    
+    snprintf(socket_path, sizeof(socket_path), "/tmp/docker_monitor_bench.%d.sock", (int)getpid());
+    
+    pid_t daemon = start_daemon(options, socket_path, containers);
+    if (daemon < 0 || wait_for_socket(socket_path) != 0) {
+        fprintf(stderr, "fake daemon did not come up on %s\n", socket_path);
+        if (daemon > 0) {
+            kill(daemon, SIGTERM);
+            waitpid(daemon, NULL, 0);
+        }
+        return -1;
+    }
+    
+    if (pipe(pipe_fds) != 0) {
+        perror("pipe");
+        kill(daemon, SIGTERM);
+        waitpid(daemon, NULL, 0);
+        return -1;
+    }
+    
+    pid_t monitor = fork();
+    if (monitor == 0) {
+        close(pipe_fds[0]);
+        run_monitor(options, socket_path, containers, &result);
+        ssize_t written = write(pipe_fds[1], &result, sizeof(result));
+        _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+    }
+    close(pipe_fds[1]);
+    
+    memset(&result, 0, sizeof(result));
+    ssize_t got = read(pipe_fds[0], &result, sizeof(result));
+    close(pipe_fds[0]);
+    if (monitor < 0 || wait4(monitor, &status, 0, &usage) < 0) {
+        status = -1;
+    }
+    
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+    
+    if (got != (ssize_t)sizeof(result) || status != 0 || !result.ok) {
+        fprintf(stderr, "run with %d containers failed (saw %d)\n", containers, result.containers_seen);
+        return -1;
+    }
+    
+    double cpu_seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    
+    printf("{\"bench\":\"e2e\",\"containers\":%d,\"ticks\":%d,\"workers\":%d,\"latency_ms\":%d,\"cpus\":%d,"
+           "\"events\":%s,\"first_tick_ms\":%.3f,\"tick_ms_p50\":%.3f,\"tick_ms_p95\":%.3f,\"tick_ms_max\":%.3f,"
+           "\"requests_per_sec\":%.1f,\"cpu_ms_per_tick\":%.3f,\"cpu_seconds\":%.3f,\"peak_rss_kb\":%ld}\n",
+           containers, options->ticks, options->workers, options->latency_ms, options->cpus,
+           options->use_events ? "true" : "false", result.first_tick_ms, result.tick_ms_p50, result.tick_ms_p95,
+           result.tick_ms_max, result.requests_per_sec, result.cpu_ms_per_tick, cpu_seconds, usage.ru_maxrss);
+    fflush(stdout);
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-t ticks] [-w workers] [-l latency_ms] [-c cpus] [-E] [containers...]\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    static const int default_counts[] = { 10, 100, 1000 };
+    bench_options_t options = { NULL, 20, DEFAULT_CONCURRENCY, 0, 8, 1 };
+    char daemon[4096];
+    int failed = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "t:w:l:c:E")) != -1) {
+        switch (opt) {
+        case 't': options.ticks = atoi(optarg); break;
+        case 'w': options.workers = atoi(optarg); break;
+        case 'l': options.latency_ms = atoi(optarg); break;
+        case 'c': options.cpus = atoi(optarg); break;
+        case 'E': options.use_events = 0; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.ticks <= 0 || options.ticks > MAX_TICKS || options.workers <= 0 || options.latency_ms < 0 ||
+        options.cpus <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    
+    /* the daemon is built next to this binary */
+    const char *slash = strrchr(argv[0], '/');
+    snprintf(daemon, sizeof(daemon), "%.*s/fake_dockerd", slash ? (int)(slash - argv[0]) : 1,
+             slash ? argv[0] : ".");
+    options.daemon = daemon;
+    
+    if (optind == argc) {
+        for (size_t i = 0; i < sizeof(default_counts) / sizeof(default_counts[0]); i++) {
+            failed |= run_scenario(&options, default_counts[i]) != 0;
+        }
+    } else {
+        for (int i = optind; i < argc; i++) {
+            failed |= run_scenario(&options, atoi(argv[i])) != 0;
+        }
+    }
+    
+    return failed;
+}
@@ -0,0 +1,467 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+/* a stand-in for dockerd on a unix socket: synthetic /containers/json,
+   /containers/<id>/stats (polled and streamed) and an idle /events stream.
+   With -t it listens on 127.0.0.1:<port> instead, with -C/-K over TLS like
+   dockerd --tlsverify on 2376 (-A also requires a client certificate) */
+
+#define DEFAULT_SOCKET "/tmp/fake_dockerd.sock"
+#define REQUEST_BUFFER 8192
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} text_t;
+
+typedef struct {
+    int fd;
+    SSL *ssl;
+} peer_t;
+
+static const char *socket_path = DEFAULT_SOCKET;
+static int container_count = 100;
+static int latency_ms = 0;
+static int max_requests = 0;
+static int cpu_count = 8;
+static char *list_body;
+static size_t list_len;
+static int tcp_port = 0;
+static const char *cert_path;
+static const char *key_path;
+static const char *ca_path;
+static SSL_CTX *tls_ctx;
+
+static void append(text_t *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void make_list_body(void);
+static void make_stats_body(text_t *text, int index);
+static ssize_t peer_read(peer_t *peer, char *buffer, size_t len);
+static int write_all(peer_t *peer, const char *data, size_t len);
+static int send_response(peer_t *peer, int status, const char *body, size_t len);
+static int send_stream(peer_t *peer, int index);
+static void hold_events(peer_t *peer);
+static int container_index(const char *path);
+static int handle_request(peer_t *peer, const char *path, text_t *scratch);
+static void *serve_connection(void *arg);
+static SSL_CTX *make_tls_context(void);
+static int listen_unix(void);
+static int listen_tcp(void);
+static void stop(int sig);
+static void usage(const char *program);
+
+static void append(text_t *text, const char *format, ...) {
+    va_list args;
+    
+    for (;;) {
+        size_t room = text->capacity - text->len;
+        va_start(args, format);
+        int n = vsnprintf(text->data + text->len, room, format, args);
+        va_end(args);
+        
+        if ((size_t)n < room) {
+            text->len += n;
+            return;
+        }
+        text->capacity = text->capacity * 2 + n;
+        text->data = realloc(text->data, text->capacity);
+        if (!text->data) {
+            abort();
+        }
+    }
+}
+
+static void make_list_body(void) {
+    text_t text = { malloc(4096), 0, 4096 };
+    
+    append(&text, "[");
+    for (int i = 0; i < container_count; i++) {
+        append(&text, "%s{\"Id\":\"", i ? "," : "");
+        for (int part = 0; part < 8; part++) {
+            append(&text, "%08x", i);
+        }
+        append(&text, "\",\"Names\":[\"/bench-%d\"],\"Image\":\"nginx:alpine\",\"ImageID\":\"sha256:%064d\","
+                      "\"Command\":\"/docker-entrypoint.sh nginx -g 'daemon off;'\",\"Created\":1714550000,"
+                      "\"Ports\":[{\"PrivatePort\":80,\"Type\":\"tcp\"}],\"Labels\":{\"com.example.bench\":\"%d\"},"
+                      "\"State\":\"running\",\"Status\":\"Up 5 minutes\",\"HostConfig\":{\"NetworkMode\":\"default\"},"
+                      "\"Mounts\":[]}", i, i, i);
+    }
+    append(&text, "]");
+    
+    list_body = text.data;
+    list_len = text.len;
+}
+
+/* counters grow with the clock so consecutive samples give steady rates */
+static void make_stats_body(text_t *text, int index) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    uint64_t previous = now - 1000000000ULL;
+    uint64_t share = index % 10 + 1;
+    uint64_t seconds = now / 1000000000ULL;
+    
+    text->len = 0;
+    append(text, "{\"read\":\"2024-05-01T10:00:00.000000000Z\",\"preread\":\"2024-05-01T09:59:59.000000000Z\","
+                 "\"pids_stats\":{\"current\":12},\"blkio_stats\":{\"io_service_bytes_recursive\":["
+                 "{\"major\":8,\"minor\":0,\"op\":\"read\",\"value\":%llu},"
+                 "{\"major\":8,\"minor\":0,\"op\":\"write\",\"value\":%llu}]},",
+           (unsigned long long)(seconds * 4096), (unsigned long long)(seconds * 8192 * share));
+    
+    for (int s = 0; s < 2; s++) {
+        uint64_t at = s == 0 ? now : previous;
+        append(text, "\"%s\":{\"cpu_usage\":{\"total_usage\":%llu,\"percpu_usage\":[",
+               s == 0 ? "cpu_stats" : "precpu_stats", (unsigned long long)(at / 100 * share));
+        for (int cpu = 0; cpu < cpu_count; cpu++) {
+            append(text, "%s%llu", cpu ? "," : "", (unsigned long long)(at / 100 * share / cpu_count));
+        }
+        append(text, "],\"usage_in_kernelmode\":10000000,\"usage_in_usermode\":30000000},"
+                     "\"system_cpu_usage\":%llu,\"online_cpus\":%d},",
+               (unsigned long long)(at * cpu_count), cpu_count);
+    }
+    
+    append(text, "\"memory_stats\":{\"usage\":%llu,\"stats\":{\"active_file\":8192,\"inactive_file\":4096,"
+                 "\"anon\":%llu,\"file\":12288},\"limit\":8000000000},"
+                 "\"name\":\"/bench-%d\",\"id\":\"%08x\","
+                 "\"networks\":{\"eth0\":{\"rx_bytes\":%llu,\"rx_packets\":%llu,\"rx_errors\":0,\"rx_dropped\":0,"
+                 "\"tx_bytes\":%llu,\"tx_packets\":%llu,\"tx_errors\":0,\"tx_dropped\":0}}}",
+           (unsigned long long)((index + 1) * 1048576ULL + 4096), (unsigned long long)((index + 1) * 1048576ULL),
+           index, index, (unsigned long long)(seconds * 1000 * share), (unsigned long long)seconds,
+           (unsigned long long)(seconds * 500 * share), (unsigned long long)seconds);
+}
+
+static ssize_t peer_read(peer_t *peer, char *buffer, size_t len) {
+    if (peer->ssl) {
+        int n = SSL_read(peer->ssl, buffer, (int)len);
+        return n > 0 ? n : (SSL_get_error(peer->ssl, n) == SSL_ERROR_ZERO_RETURN ? 0 : -1);
+    }
+    return read(peer->fd, buffer, len);
+}
+
+static int write_all(peer_t *peer, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = peer->ssl ? SSL_write(peer->ssl, data, (int)len) : write(peer->fd, data, len);
+        if (n <= 0 && peer->ssl) {
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int send_response(peer_t *peer, int status, const char *body, size_t len) {
+    char head[256];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n",
+                            status, status == 200 ? "OK" : "Not Found", len);
+    
+    if (write_all(peer, head, head_len) != 0) {
+        return -1;
+    }
+    return write_all(peer, body, len);
+}
+
+static int send_stream(peer_t *peer, int index) {
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n";
+    text_t text = { malloc(4096), 0, 4096 };
+    char size[32];
+    
+    if (write_all(peer, head, sizeof(head) - 1) != 0) {
+        free(text.data);
+        return -1;
+    }
+    
+    for (;;) {
+        make_stats_body(&text, index);
+        append(&text, "\n\r\n");
+        int size_len = snprintf(size, sizeof(size), "%zx\r\n", text.len - 2);
+        if (write_all(peer, size, size_len) != 0 || write_all(peer, text.data, text.len) != 0) {
+            break;
+        }
+        sleep(1);
+    }
+    
+    free(text.data);
+    return -1;
+}
+
+/* no events are ever sent; the stream stays open until the client goes away */
+static void hold_events(peer_t *peer) {
+    static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n";
+    char buffer[256];
+    
+    if (write_all(peer, head, sizeof(head) - 1) != 0) {
+        return;
+    }
+    while (peer_read(peer, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+static int container_index(const char *path) {
+    char prefix[9];
+    
+    if (strncmp(path, "/containers/", 12) != 0 || strlen(path + 12) < 8) {
+        return -1;
+    }
+    memcpy(prefix, path + 12, 8);
+    prefix[8] = '\0';
+    
+    char *end;
+    long index = strtol(prefix, &end, 16);
+    return *end == '\0' && index < container_count ? (int)index : -1;
+}
+
+static int handle_request(peer_t *peer, const char *path, text_t *scratch) {
+    static const char not_found[] = "{\"message\":\"page not found\"}";
+    
+    if (strncmp(path, "/events", 7) == 0) {
+        hold_events(peer);
+        return -1;
+    }
+    
+    if (latency_ms > 0) {
+        struct timespec delay = { latency_ms / 1000, (latency_ms % 1000) * 1000000L };
+        nanosleep(&delay, NULL);
+    }
+    
+    if (strncmp(path, "/containers/json", 16) == 0) {
+        return send_response(peer, 200, list_body, list_len);
+    }
+    
+    int index = container_index(path);
+    if (index >= 0 && strstr(path, "/stats")) {
+        if (strstr(path, "stream=true")) {
+            return send_stream(peer, index);
+        }
+        make_stats_body(scratch, index);
+        return send_response(peer, 200, scratch->data, scratch->len);
+    }
+    
+    return send_response(peer, 404, not_found, sizeof(not_found) - 1);
+}
+
+static void *serve_connection(void *arg) {
+    peer_t peer = { (int)(intptr_t)arg, NULL };
+    char buffer[REQUEST_BUFFER];
+    size_t len = 0;
+    int served = 0;
+    text_t scratch = { malloc(4096), 0, 4096 };
+    
+    if (tls_ctx) {
+        peer.ssl = SSL_new(tls_ctx);
+        if (!peer.ssl || SSL_set_fd(peer.ssl, peer.fd) != 1 || SSL_accept(peer.ssl) != 1) {
+            ERR_print_errors_fp(stderr);
+            goto done;
+        }
+    }
+    
+    for (;;) {
+        char *end = memmem(buffer, len, "\r\n\r\n", 4);
+        
+        if (!end) {
+            if (len == sizeof(buffer)) {
+                break;
+            }
+            ssize_t n = peer_read(&peer, buffer + len, sizeof(buffer) - len);
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+            continue;
+        }
+        
+        char path[1024];
+        if (sscanf(buffer, "%*s %1023s", path) != 1 || handle_request(&peer, path, &scratch) != 0) {
+            break;
+        }
+        /* -k: drop the connection like a proxy with a keep-alive limit */
+        if (max_requests > 0 && ++served >= max_requests) {
+            break;
+        }
+        
+        size_t used = end + 4 - buffer;
+        memmove(buffer, buffer + used, len - used);
+        len -= used;
+    }
+
+done:
+    if (peer.ssl) {
+        SSL_shutdown(peer.ssl);
+        SSL_free(peer.ssl);
+    }
+    free(scratch.data);
+    close(peer.fd);
+    return NULL;
+}
+
+/* the default server session cache and stateless tickets let clients
+   resume; the id context is required once client certificates are checked */
+static SSL_CTX *make_tls_context(void) {
+    static const unsigned char id_context[] = "fake_dockerd";
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    
+    if (!ctx || SSL_CTX_use_certificate_chain_file(ctx, cert_path) != 1 ||
+        SSL_CTX_use_PrivateKey_file(ctx, key_path, SSL_FILETYPE_PEM) != 1) {
+        ERR_print_errors_fp(stderr);
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    SSL_CTX_set_session_id_context(ctx, id_context, sizeof(id_context) - 1);
+    
+    if (ca_path) {
+        if (SSL_CTX_load_verify_locations(ctx, ca_path, NULL) != 1) {
+            ERR_print_errors_fp(stderr);
+            SSL_CTX_free(ctx);
+            return NULL;
+        }
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    }
+    return ctx;
+}
+
+static int listen_unix(void) {
+    struct sockaddr_un addr;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    
+    if (server < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 256) != 0) {
+        perror(socket_path);
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+static int listen_tcp(void) {
+    struct sockaddr_in addr;
+    int one = 1;
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    
+    if (server < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(tcp_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 256) != 0) {
+        perror("bind");
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+static void stop(int sig) {
+    (void)sig;
+    if (!tcp_port) {
+        unlink(socket_path);
+    }
+    _exit(0);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "usage: %s [-s socket | -t port [-C cert -K key [-A ca]]] [-n containers] [-l latency_ms] "
+            "[-c cpus] [-k requests]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    struct sockaddr_un addr;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "s:t:C:K:A:n:l:c:k:")) != -1) {
+        switch (opt) {
+        case 's': socket_path = optarg; break;
+        case 't': tcp_port = atoi(optarg); break;
+        case 'C': cert_path = optarg; break;
+        case 'K': key_path = optarg; break;
+        case 'A': ca_path = optarg; break;
+        case 'n': container_count = atoi(optarg); break;
+        case 'l': latency_ms = atoi(optarg); break;
+        case 'k': max_requests = atoi(optarg); break;
+        case 'c': cpu_count = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (container_count < 0 || latency_ms < 0 || cpu_count <= 0 || max_requests < 0 || strlen(socket_path) >= sizeof(addr.sun_path) ||
+        tcp_port < 0 || tcp_port > 65535 || !cert_path != !key_path || (cert_path && !tcp_port) ||
+        (ca_path && !cert_path)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (cert_path && !(tls_ctx = make_tls_context())) {
+        return 1;
+    }
+    
+    make_list_body();
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    
+    int server = tcp_port ? listen_tcp() : listen_unix();
+    if (server < 0) {
+        return 1;
+    }
+    
+    for (;;) {
+        int fd = accept(server, NULL, NULL);
+        pthread_t thread;
+        
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        if (tcp_port) {
+            /* like dockerd; head and body are separate writes */
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (pthread_create(&thread, NULL, serve_connection, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    
+    if (!tcp_port) {
+        unlink(socket_path);
+    }
+    return 1;
+}
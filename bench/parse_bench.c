@@ -0,0 +1,502 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <json-c/json.h>
+#include "../include/docker_api.h"
+#include "../include/alloc_stats.h"
+
+/* prints results in the `go test -bench` line format, so runs from before
+   and after a parser change can be compared with benchstat */
+
+#define MAX_CORPUS 32
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} text_t;
+
+typedef enum {
+    DOC_STATS,
+    DOC_LIST
+} doc_kind_t;
+
+typedef struct {
+    char name[64];
+    doc_kind_t kind;
+    char *data;
+    size_t len;
+} corpus_doc_t;
+
+typedef struct {
+    int cgroup_version;
+    int cpus;
+    int networks;
+    int block_devices;
+} stats_shape_t;
+
+typedef int (*parse_fn)(const corpus_doc_t *doc, void *out);
+
+
+static void append(text_t *text, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static char *make_stats_document(const stats_shape_t *shape);
+static char *make_list_document(int count);
+static void add_doc(corpus_doc_t *corpus, int *count, doc_kind_t kind, const char *name, char *data);
+static int load_doc(corpus_doc_t *corpus, int *count, const char *path);
+static int dom_parse_stats(const char *json_data, container_stats_t *stats);
+static int dom_parse_list(const char *json_data, container_list_t *list);
+static int scan_stats(const corpus_doc_t *doc, void *out);
+static int dom_stats(const corpus_doc_t *doc, void *out);
+static int scan_list(const corpus_doc_t *doc, void *out);
+static int dom_list(const corpus_doc_t *doc, void *out);
+static int check_doc(const corpus_doc_t *doc);
+static double now_seconds(void);
+static void run_bench(const char *name, const corpus_doc_t *doc, parse_fn parse, double benchtime);
+
+static void append(text_t *text, const char *format, ...) {
+    va_list args;
+    
+    for (;;) {
+        size_t room = text->capacity - text->len;
+        va_start(args, format);
+        int n = vsnprintf(text->data + text->len, room, format, args);
+        va_end(args);
+        
+        if ((size_t)n < room) {
+            text->len += n;
+            return;
+        }
+        text->capacity = text->capacity * 2 + n;
+        text->data = realloc(text->data, text->capacity);
+        if (!text->data) {
+            abort();
+        }
+    }
+}
+
+/* shaped like real /containers/<id>/stats?stream=false answers: cgroup v1
+   reports percpu_usage, total_* memory keys and Read/Write/Sync/Async/Total
+   per device, v2 drops percpu_usage and lowercases the blkio ops */
+static char *make_stats_document(const stats_shape_t *shape) {
+    static const char *v1_ops[] = { "Read", "Write", "Sync", "Async", "Discard", "Total" };
+    static const char *v2_ops[] = { "read", "write" };
+    static const char *v1_memory_keys[] = {
+        "active_anon", "active_file", "cache", "dirty", "hierarchical_memory_limit",
+        "hierarchical_memsw_limit", "inactive_anon", "inactive_file", "mapped_file", "pgfault",
+        "pgmajfault", "pgpgin", "pgpgout", "rss", "rss_huge", "total_active_anon", "total_active_file",
+        "total_cache", "total_dirty", "total_inactive_anon", "total_inactive_file", "total_mapped_file",
+        "total_pgfault", "total_pgmajfault", "total_pgpgin", "total_pgpgout", "total_rss",
+        "total_rss_huge", "total_unevictable", "total_writeback", "unevictable", "writeback"
+    };
+    static const char *v2_memory_keys[] = {
+        "active_anon", "active_file", "anon", "anon_thp", "file", "file_dirty", "file_mapped",
+        "file_writeback", "inactive_anon", "inactive_file", "kernel_stack", "pgactivate",
+        "pgdeactivate", "pgfault", "pglazyfree", "pglazyfreed", "pgmajfault", "pgrefill",
+        "pgscan", "pgsteal", "shmem", "slab", "slab_reclaimable", "slab_unreclaimable", "sock",
+        "thp_collapse_alloc", "thp_fault_alloc", "unevictable", "workingset_activate",
+        "workingset_nodereclaim", "workingset_refault"
+    };
+    const char **ops = shape->cgroup_version == 1 ? v1_ops : v2_ops;
+    int op_count = shape->cgroup_version == 1 ? 6 : 2;
+    const char **memory_keys = shape->cgroup_version == 1 ? v1_memory_keys : v2_memory_keys;
+    size_t memory_key_count = shape->cgroup_version == 1 ? sizeof(v1_memory_keys) / sizeof(v1_memory_keys[0])
+                                                         : sizeof(v2_memory_keys) / sizeof(v2_memory_keys[0]);
+    const char *sections[] = { "cpu_stats", "precpu_stats" };
+    text_t text = { malloc(4096), 0, 4096 };
+    
+    append(&text, "{\"read\":\"2024-05-01T10:00:00.000000000Z\",\"preread\":\"2024-05-01T09:59:59.000000000Z\","
+                  "\"pids_stats\":{\"current\":12,\"limit\":18446744073709551615},"
+                  "\"blkio_stats\":{\"io_service_bytes_recursive\":[");
+    for (int device = 0; device < shape->block_devices; device++) {
+        for (int op = 0; op < op_count; op++) {
+            append(&text, "%s{\"major\":8,\"minor\":%d,\"op\":\"%s\",\"value\":%d}",
+                   device || op ? "," : "", device * 16, ops[op], 4096 * (device + 1) * (op + 1));
+        }
+    }
+    append(&text, "],\"io_serviced_recursive\":%s,\"io_queue_recursive\":null,\"io_service_time_recursive\":null,"
+                  "\"io_wait_time_recursive\":null,\"io_merged_recursive\":null,\"io_time_recursive\":null,"
+                  "\"sectors_recursive\":null},\"num_procs\":0,\"storage_stats\":{},",
+           shape->cgroup_version == 1 ? "[{\"major\":8,\"minor\":0,\"op\":\"Read\",\"value\":12}]" : "null");
+    
+    for (int s = 0; s < 2; s++) {
+        append(&text, "\"%s\":{\"cpu_usage\":{\"total_usage\":%d,", sections[s], 48397000 + s);
+        if (shape->cgroup_version == 1) {
+            append(&text, "\"percpu_usage\":[");
+            for (int cpu = 0; cpu < shape->cpus; cpu++) {
+                append(&text, "%s%d", cpu ? "," : "", 1512000 + cpu * 317);
+            }
+            append(&text, "],");
+        }
+        append(&text, "\"usage_in_kernelmode\":10000000,\"usage_in_usermode\":30000000},"
+                      "\"system_cpu_usage\":%llu,\"online_cpus\":%d,"
+                      "\"throttling_data\":{\"periods\":0,\"throttled_periods\":0,\"throttled_time\":0}},",
+               5578660000000ULL + s, shape->cpus);
+    }
+    
+    append(&text, "\"memory_stats\":{\"usage\":2867200,%s\"stats\":{",
+           shape->cgroup_version == 1 ? "\"max_usage\":6651904,\"failcnt\":0," : "");
+    for (size_t i = 0; i < memory_key_count; i++) {
+        append(&text, "%s\"%s\":%zu", i ? "," : "", memory_keys[i], 4096 * (i + 1));
+    }
+    append(&text, "},\"limit\":8000000000},\"name\":\"/bench\",\"id\":\"%064d\",\"networks\":{", 0);
+    for (int net = 0; net < shape->networks; net++) {
+        append(&text, "%s\"eth%d\":{\"rx_bytes\":%d,\"rx_packets\":60,\"rx_errors\":0,\"rx_dropped\":0,"
+                      "\"tx_bytes\":%d,\"tx_packets\":60,\"tx_errors\":0,\"tx_dropped\":0}",
+               net ? "," : "", net, 7476 + net, 3000 + net);
+    }
+    append(&text, "}}");
+    
+    return text.data;
+}
+
+static char *make_list_document(int count) {
+    text_t text = { malloc(4096), 0, 4096 };
+    
+    append(&text, "[");
+    for (int i = 0; i < count; i++) {
+        append(&text, "%s{\"Id\":\"%064x\",\"Names\":[\"/bench-%d\"],\"Image\":\"nginx:alpine\","
+                      "\"ImageID\":\"sha256:%064x\",\"Command\":\"/docker-entrypoint.sh nginx -g 'daemon off;'\","
+                      "\"Created\":%d,\"Ports\":[{\"IP\":\"0.0.0.0\",\"PrivatePort\":80,\"PublicPort\":%d,\"Type\":\"tcp\"}],"
+                      "\"Labels\":{\"com.docker.compose.project\":\"bench\",\"com.docker.compose.service\":\"web\","
+                      "\"maintainer\":\"NGINX Docker Maintainers <docker-maint@nginx.com>\"},"
+                      "\"State\":\"running\",\"Status\":\"Up 5 minutes\",\"HostConfig\":{\"NetworkMode\":\"default\"},"
+                      "\"NetworkSettings\":{\"Networks\":{\"bridge\":{\"IPAMConfig\":null,\"Links\":null,\"Aliases\":null,"
+                      "\"NetworkID\":\"%064x\",\"EndpointID\":\"%064x\",\"Gateway\":\"172.17.0.1\","
+                      "\"IPAddress\":\"172.17.0.%d\",\"IPPrefixLen\":16,\"MacAddress\":\"02:42:ac:11:00:02\"}}},"
+                      "\"Mounts\":[{\"Type\":\"volume\",\"Name\":\"data-%d\",\"Source\":\"/var/lib/docker/volumes/data/_data\","
+                      "\"Destination\":\"/data\",\"Driver\":\"local\",\"Mode\":\"z\",\"RW\":true,\"Propagation\":\"\"}]}",
+               i ? "," : "", i + 1, i, i + 7, 1714550000 + i, 8000 + i, i + 11, i + 13, i % 250 + 2, i);
+    }
+    append(&text, "]");
+    
+    return text.data;
+}
+
+static void add_doc(corpus_doc_t *corpus, int *count, doc_kind_t kind, const char *name, char *data) {
+    corpus_doc_t *doc = &corpus[(*count)++];
+    
+    snprintf(doc->name, sizeof(doc->name), "%s", name);
+    doc->kind = kind;
+    doc->data = data;
+    doc->len = strlen(data);
+}
+
+/* captured payloads: an array is a container list, anything else a stats answer */
+static int load_doc(corpus_doc_t *corpus, int *count, const char *path) {
+    FILE *file = fopen(path, "rb");
+    text_t text = { malloc(4096), 0, 4096 };
+    char chunk[4096];
+    size_t n;
+    
+    if (!file) {
+        perror(path);
+        free(text.data);
+        return -1;
+    }
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        append(&text, "%.*s", (int)n, chunk);
+    }
+    fclose(file);
+    
+    const char *base = strrchr(path, '/');
+    const char *start = text.data + strspn(text.data, " \t\r\n");
+    add_doc(corpus, count, *start == '[' ? DOC_LIST : DOC_STATS, base ? base + 1 : path, text.data);
+    return 0;
+}
+
+/* reference: the json-c DOM parsers the scanner replaced */
+static uint64_t dom_u64(json_object *object, const char *key) {
+    json_object *value;
+    
+    if (object && json_object_object_get_ex(object, key, &value) && value) {
+        return json_object_get_uint64(value);
+    }
+    return 0;
+}
+
+static void dom_parse_cpu(json_object *cpu_stats, uint64_t *usage, uint64_t *system_usage, uint32_t *online_cpus) {
+    json_object *cpu_usage, *percpu_usage;
+    
+    if (json_object_object_get_ex(cpu_stats, "cpu_usage", &cpu_usage) && cpu_usage) {
+        *usage = dom_u64(cpu_usage, "total_usage");
+        if (online_cpus && json_object_object_get_ex(cpu_usage, "percpu_usage", &percpu_usage) &&
+            json_object_is_type(percpu_usage, json_type_array)) {
+            *online_cpus = json_object_array_length(percpu_usage);
+        }
+    }
+    *system_usage = dom_u64(cpu_stats, "system_cpu_usage");
+    if (online_cpus && dom_u64(cpu_stats, "online_cpus") > 0) {
+        *online_cpus = dom_u64(cpu_stats, "online_cpus");
+    }
+}
+
+static int dom_parse_stats(const char *json_data, container_stats_t *stats) {
+    json_object *root, *section, *details, *entries;
+    
+    root = json_tokener_parse(json_data);
+    if (!root) {
+        return -1;
+    }
+    
+    memset(stats, 0, sizeof(*stats));
+    if (json_object_object_get_ex(root, "cpu_stats", &section)) {
+        dom_parse_cpu(section, &stats->cpu_usage, &stats->cpu_system_usage, &stats->online_cpus);
+    }
+    if (json_object_object_get_ex(root, "precpu_stats", &section)) {
+        dom_parse_cpu(section, &stats->precpu_usage, &stats->precpu_system_usage, NULL);
+    }
+    if (json_object_object_get_ex(root, "memory_stats", &section)) {
+        stats->memory_usage = dom_u64(section, "usage");
+        stats->memory_limit = dom_u64(section, "limit");
+        if (json_object_object_get_ex(section, "stats", &details)) {
+            stats->memory_inactive_file = dom_u64(details, "inactive_file");
+        }
+    }
+    if (json_object_object_get_ex(root, "networks", &section)) {
+        struct json_object_iterator it = json_object_iter_begin(section);
+        struct json_object_iterator end = json_object_iter_end(section);
+        
+        while (!json_object_iter_equal(&it, &end)) {
+            stats->network_rx_bytes += dom_u64(json_object_iter_peek_value(&it), "rx_bytes");
+            stats->network_tx_bytes += dom_u64(json_object_iter_peek_value(&it), "tx_bytes");
+            json_object_iter_next(&it);
+        }
+    }
+    if (json_object_object_get_ex(root, "blkio_stats", &section) &&
+        json_object_object_get_ex(section, "io_service_bytes_recursive", &entries) &&
+        json_object_is_type(entries, json_type_array)) {
+        for (size_t i = 0; i < json_object_array_length(entries); i++) {
+            json_object *entry = json_object_array_get_idx(entries, i), *op;
+            if (!json_object_object_get_ex(entry, "op", &op)) continue;
+            if (strcasecmp(json_object_get_string(op), "read") == 0) {
+                stats->block_read_bytes += dom_u64(entry, "value");
+            } else if (strcasecmp(json_object_get_string(op), "write") == 0) {
+                stats->block_write_bytes += dom_u64(entry, "value");
+            }
+        }
+    }
+    
+    json_object_put(root);
+    return 0;
+}
+
+static int dom_parse_list(const char *json_data, container_list_t *list) {
+    json_object *root = json_tokener_parse(json_data);
+    
+    if (!root || !json_object_is_type(root, json_type_array)) {
+        json_object_put(root);
+        return -1;
+    }
+    
+    for (size_t i = 0; i < json_object_array_length(root); i++) {
+        json_object *container = json_object_array_get_idx(root, i);
+        json_object *id, *names, *image, *status, *created;
+        container_info_t info;
+        
+        if (!json_object_object_get_ex(container, "Id", &id) ||
+            !json_object_object_get_ex(container, "Names", &names) ||
+            !json_object_object_get_ex(container, "Image", &image) ||
+            !json_object_object_get_ex(container, "Status", &status) ||
+            !json_object_object_get_ex(container, "Created", &created)) {
+            continue;
+        }
+        
+        memset(&info, 0, sizeof(info));
+        snprintf(info.id, sizeof(info.id), "%s", json_object_get_string(id));
+        const char *name = json_object_array_length(names) > 0 ?
+                           json_object_get_string(json_object_array_get_idx(names, 0)) : "unknown";
+        snprintf(info.name, sizeof(info.name), "%s", name[0] == '/' ? name + 1 : name);
+        snprintf(info.image, sizeof(info.image), "%s", json_object_get_string(image));
+        snprintf(info.status, sizeof(info.status), "%s", json_object_get_string(status));
+        info.created = json_object_get_int64(created);
+        container_list_append(list, &info);
+    }
+    
+    json_object_put(root);
+    return list->count;
+}
+
+static int scan_stats(const corpus_doc_t *doc, void *out) {
+    return docker_parse_container_stats(doc->data, doc->len, out);
+}
+
+static int dom_stats(const corpus_doc_t *doc, void *out) {
+    return dom_parse_stats(doc->data, out);
+}
+
+static int scan_list(const corpus_doc_t *doc, void *out) {
+    container_list_t *list = out;
+    list->count = 0;
+    return docker_parse_container_list(doc->data, doc->len, NULL, list) < 0 ? -1 : 0;
+}
+
+static int dom_list(const corpus_doc_t *doc, void *out) {
+    container_list_t *list = out;
+    list->count = 0;
+    return dom_parse_list(doc->data, list) < 0 ? -1 : 0;
+}
+
+/* both paths must agree before their speed means anything */
+static int check_doc(const corpus_doc_t *doc) {
+    if (doc->kind == DOC_STATS) {
+        container_stats_t scanned, reference;
+        
+        if (scan_stats(doc, &scanned) != 0 || dom_stats(doc, &reference) != 0 ||
+            scanned.cpu_usage != reference.cpu_usage || scanned.precpu_usage != reference.precpu_usage ||
+            scanned.cpu_system_usage != reference.cpu_system_usage || scanned.online_cpus != reference.online_cpus ||
+            scanned.memory_usage != reference.memory_usage || scanned.memory_limit != reference.memory_limit ||
+            scanned.memory_inactive_file != reference.memory_inactive_file ||
+            scanned.network_rx_bytes != reference.network_rx_bytes || scanned.network_tx_bytes != reference.network_tx_bytes ||
+            scanned.block_read_bytes != reference.block_read_bytes || scanned.block_write_bytes != reference.block_write_bytes) {
+            fprintf(stderr, "%s: stats parsers disagree\n", doc->name);
+            return -1;
+        }
+        return 0;
+    }
+    
+    container_list_t scanned = {0}, reference = {0};
+    int result = 0;
+    
+    if (scan_list(doc, &scanned) != 0 || dom_list(doc, &reference) != 0 || scanned.count != reference.count) {
+        result = -1;
+    }
+    for (int i = 0; result == 0 && i < scanned.count; i++) {
+        if (strcmp(scanned.items[i].id, reference.items[i].id) != 0 ||
+            strcmp(scanned.items[i].name, reference.items[i].name) != 0 ||
+            strcmp(scanned.items[i].image, reference.items[i].image) != 0 ||
+            strcmp(scanned.items[i].status, reference.items[i].status) != 0 ||
+            scanned.items[i].created != reference.items[i].created) {
+            result = -1;
+        }
+    }
+    if (result != 0) {
+        fprintf(stderr, "%s: list parsers disagree (%d vs %d containers)\n", doc->name, scanned.count, reference.count);
+    }
+    container_list_free(&scanned);
+    container_list_free(&reference);
+    return result;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* grows the iteration count until one round takes benchtime, then reports
+   that round; one warm-up call first so reusable buffers are in place */
+static void run_bench(const char *name, const corpus_doc_t *doc, parse_fn parse, double benchtime) {
+    container_stats_t stats;
+    container_list_t list = {0};
+    void *out = doc->kind == DOC_STATS ? (void *)&stats : (void *)&list;
+    long iterations = 1;
+    double seconds;
+    uint64_t allocs, bytes;
+    
+    parse(doc, out);
+    for (;;) {
+        alloc_stats_t before, after;
+        
+        alloc_stats_get(&before);
+        double start = now_seconds();
+        
+        for (long i = 0; i < iterations; i++) {
+            parse(doc, out);
+        }
+        seconds = now_seconds() - start;
+        alloc_stats_get(&after);
+        allocs = after.allocations - before.allocations;
+        bytes = after.bytes - before.bytes;
+        
+        if (seconds >= benchtime || iterations >= 1000000000L) {
+            break;
+        }
+        long next = seconds > 0 ? (long)(iterations * benchtime * 1.2 / seconds) : iterations * 100;
+        if (next > iterations * 100) next = iterations * 100;
+        iterations = next > iterations ? next : iterations + 1;
+    }
+    
+    printf("Benchmark%s/%s\t%10ld\t%12.0f ns/op\t%8.2f MB/s\t%10llu B/op\t%8llu allocs/op\n",
+           name, doc->name, iterations, seconds * 1e9 / iterations,
+           (double)doc->len * iterations / seconds / 1e6,
+           (unsigned long long)(bytes / iterations), (unsigned long long)(allocs / iterations));
+    fflush(stdout);
+    container_list_free(&list);
+}
+
+int main(int argc, char *argv[]) {
+    static const struct {
+        const char *name;
+        stats_shape_t shape;
+    } stats_shapes[] = {
+        { "v1-4cpu", { 1, 4, 1, 1 } },
+        { "v1-128cpu", { 1, 128, 2, 4 } },
+        { "v2-8cpu", { 2, 8, 1, 1 } },
+        { "v2-32cpu", { 2, 32, 2, 2 } },
+        { "v2-64net", { 2, 16, 64, 2 } },
+    };
+    static const int list_sizes[] = { 1, 100, 1000 };
+    corpus_doc_t corpus[MAX_CORPUS];
+    int count = 0;
+    double benchtime = 0.5;
+    int with_dom = 1;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "t:s")) != -1) {
+        switch (opt) {
+        case 't': benchtime = atof(optarg); break;
+        case 's': with_dom = 0; break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-s] [payload.json...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (benchtime <= 0 || argc - optind > MAX_CORPUS) {
+        fprintf(stderr, "usage: %s [-t seconds] [-s] [payload.json...]\n", argv[0]);
+        return 1;
+    }
+    
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            if (load_doc(corpus, &count, argv[i]) != 0) {
+                return 1;
+            }
+        }
+    } else {
+        char name[64];
+        
+        for (size_t i = 0; i < sizeof(stats_shapes) / sizeof(stats_shapes[0]); i++) {
+            add_doc(corpus, &count, DOC_STATS, stats_shapes[i].name, make_stats_document(&stats_shapes[i].shape));
+        }
+        for (size_t i = 0; i < sizeof(list_sizes) / sizeof(list_sizes[0]); i++) {
+            snprintf(name, sizeof(name), "%d", list_sizes[i]);
+            add_doc(corpus, &count, DOC_LIST, name, make_list_document(list_sizes[i]));
+        }
+    }
+    
+    for (int i = 0; i < count; i++) {
+        if (check_doc(&corpus[i]) != 0) {
+            return 1;
+        }
+        printf("# %s %s: %zu bytes\n", corpus[i].kind == DOC_STATS ? "stats" : "list", corpus[i].name, corpus[i].len);
+    }
+    
+    for (int i = 0; i < count; i++) {
+        int stats = corpus[i].kind == DOC_STATS;
+        
+        run_bench(stats ? "ParseStats" : "ParseList", &corpus[i], stats ? scan_stats : scan_list, benchtime);
+        if (with_dom) {
+            run_bench(stats ? "ParseStatsDOM" : "ParseListDOM", &corpus[i], stats ? dom_stats : dom_list, benchtime);
+        }
+    }
+    
+    for (int i = 0; i < count; i++) {
+        free(corpus[i].data);
+    }
+    return 0;
+}
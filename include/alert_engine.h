@@ -0,0 +1,37 @@
+#ifndef ALERT_ENGINE_H
+#define ALERT_ENGINE_H
+
+#include "docker_monitor.h"
+
+#define MAX_ALERT_RULES 64
+#define MAX_ALERT_NAME 64
+#define MAX_ALERT_HOOKS 16
+
+typedef struct alert_engine alert_engine_t;
+
+alert_engine_t *alert_engine_create(void);
+void alert_engine_destroy(alert_engine_t *engine);
+
+/* one rule per call or per line of the file ('#' starts a comment):
+     [<name>:] <metric> <op> <value>[K|M|G] [for <duration>]
+     [<name>:] rate(<metric>) <op> <value>/<s|min|h> [for <duration>]
+     [<name>:] restart
+   metric is one of cpu_percent, memory_percent, memory_working_set,
+   network_rx_rate, network_tx_rate, block_read_rate, block_write_rate;
+   op is >, >=, < or <=; a duration is seconds or <n>s, <n>m, <n>h */
+int alert_engine_add_rule(alert_engine_t *engine, const char *rule);
+int alert_engine_load_rules(alert_engine_t *engine, const char *path);
+int alert_engine_rule_count(const alert_engine_t *engine);
+
+/* transitions go to every configured sink, to stderr when there is none:
+   an NDJSON file with one webhook-style payload per line, and a shell
+   command run with ALERT_* variables in its environment */
+int alert_engine_set_log(alert_engine_t *engine, const char *path);
+void alert_engine_set_exec(alert_engine_t *engine, const char *command);
+
+/* checks every rule against the containers sampled since the last call,
+   timing durations and rates by sample time so replays behave the same;
+   returns the number of alerts that fired or resolved */
+int alert_engine_evaluate(alert_engine_t *engine, const monitor_state_t *state);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* malloc, calloc, realloc and free are wrapped around glibc's own
+   __libc_* entry points for the whole process, libraries included, and
+   counted with relaxed atomic adds */
+typedef struct {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+    uint64_t ticks;
+    uint64_t quiet_ticks;
+    uint64_t last_tick;
+    uint64_t max_tick;
+} alloc_stats_t;
+
+/* closes a tick: the allocations since the previous call are its own */
+void alloc_stats_tick(void);
+void alloc_stats_get(alloc_stats_t *stats);
+void alloc_stats_print(FILE *out);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* bump allocator for scratch memory that lives until the end of a tick.
+   A tick that outgrows the current block chains another one; the next reset
+   folds the chain into a single block of the combined size, so after the
+   first few ticks every allocation is a pointer bump and a reset is free.
+   Not thread-safe: the main loop owns it */
+typedef struct arena_block arena_block_t;
+
+typedef struct {
+    arena_block_t *head;
+    size_t capacity;
+} arena_t;
+
+void arena_init(arena_t *arena);
+void arena_free(arena_t *arena);
+
+/* 16-byte aligned; NULL only when a new block cannot be allocated */
+void *arena_alloc(arena_t *arena, size_t size);
+void *arena_calloc(arena_t *arena, size_t count, size_t size);
+
+/* invalidates everything handed out since the previous reset */
+void arena_reset(arena_t *arena);
+
+#endif
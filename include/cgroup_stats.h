@@ -0,0 +1,15 @@
+#ifndef CGROUP_STATS_H
+#define CGROUP_STATS_H
+
+#include "docker_monitor.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define PROC_ROOT "/proc"
+
+int cgroup_stats_init(const char *cgroup_root, const char *proc_root);
+void cgroup_stats_cleanup(void);
+int cgroup_get_container_stats(const char *container_id, container_stats_t *stats);
+void cgroup_stats_retain(const container_info_t *containers, int count);
+void cgroup_stats_forget(const char *container_id);
+
+#endif
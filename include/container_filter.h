@@ -0,0 +1,53 @@
+#ifndef CONTAINER_FILTER_H
+#define CONTAINER_FILTER_H
+
+#include <stdint.h>
+#include "docker_monitor.h"
+#include "text_buffer.h"
+#include "json_scan.h"
+
+#define MAX_SELECTORS 32
+
+typedef enum {
+    SELECT_NAME,
+    SELECT_ID,
+    SELECT_LABEL,
+    SELECT_IMAGE
+} selector_kind_t;
+
+/* pattern is the label key for SELECT_LABEL, value its optional value */
+typedef struct {
+    selector_kind_t kind;
+    char pattern[MAX_CONTAINER_NAME];
+    char value[MAX_CONTAINER_NAME];
+    int has_value;
+} container_selector_t;
+
+/* a container is watched when every kind of selector present matches: any
+   one name, id or image selector of that kind, and all label selectors.
+   Patterns are fnmatch globs; an id without wildcards matches as a prefix,
+   an image without a tag matches any tag */
+typedef struct container_filter {
+    container_selector_t selectors[MAX_SELECTORS];
+    int count;
+} container_filter_t;
+
+/* longest label key a selector may name: keys of /containers/json and of
+   event attributes are JSON object keys and are read up to this length */
+#define CONTAINER_FILTER_MAX_LABEL_KEY (JSON_SCAN_MAX_KEY - 1)
+
+/* spec is name=<glob>, id=<glob>, image=<glob> or label=<key>[=<value>] */
+int container_filter_add(container_filter_t *filter, const char *spec);
+
+/* appends the selectors the daemon can evaluate as members of a filters=
+   JSON object for /containers/json or, with events set, for /events. The
+   daemon then returns a superset of the matching containers; returns the
+   number of members appended */
+int container_filter_append_json(const container_filter_t *filter, int events, text_buffer_t *out);
+
+/* bit i is set for each label selector i that key=value satisfies; the
+   labels of one container are OR-ed together and passed to match */
+uint32_t container_filter_label(const container_filter_t *filter, const char *key, const char *value);
+int container_filter_match(const container_filter_t *filter, const container_info_t *info, uint32_t labels);
+
+#endif
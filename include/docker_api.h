@@ -2,19 +2,49 @@
 #define DOCKER_API_H
 
 #include "docker_monitor.h"
-#include <json-c/json.h>
+#include "http_client.h"
+#include "container_filter.h"
+
+typedef enum {
+    DOCKER_EVENT_OTHER,
+    DOCKER_EVENT_START,
+    DOCKER_EVENT_DIE,
+    DOCKER_EVENT_DESTROY,
+    DOCKER_EVENT_RENAME,
+    DOCKER_EVENT_PAUSE,
+    DOCKER_EVENT_UNPAUSE
+} docker_event_type_t;
 
 typedef struct {
-    char *response;
-    size_t size;
-} http_response_t;
+    docker_event_type_t type;
+    char id[MAX_CONTAINER_ID];
+    char name[MAX_CONTAINER_NAME];
+    char image[MAX_CONTAINER_NAME];
+    time_t time;
+    int selected;
+} docker_event_t;
+
+typedef struct docker_client docker_client_t;
 
-int docker_api_init(const docker_config_t *config);
-void docker_api_cleanup(void);
-int docker_get_containers(container_info_t *containers, int max_count);
-int docker_get_container_stats(const char *container_id, container_stats_t *stats);
-int docker_parse_container_list(const char *json_data, container_info_t *containers, int max_count);
-int docker_parse_container_stats(const char *json_data, container_stats_t *stats);
+/* one client per daemon; clients share nothing, so any number of them can be
+   driven from the same threads. Only a client for the local host can read
+   statistics from cgroup. The config's filter, if any, must outlive the client */
+docker_client_t *docker_client_create(const docker_config_t *config);
+void docker_client_destroy(docker_client_t *client);
+int docker_client_connect(docker_client_t *client);
+void docker_client_get_pool_stats(docker_client_t *client, http_pool_stats_t *stats);
+const container_filter_t *docker_client_filter(docker_client_t *client);
+int docker_get_containers(docker_client_t *client, container_list_t *list);
+int docker_get_container_stats(docker_client_t *client, const char *container_id, container_stats_t *stats);
+int docker_open_stats_stream(docker_client_t *client, http_stream_t *stream, const char *container_id);
+int docker_open_event_stream(docker_client_t *client, http_stream_t *stream);
+void docker_release_container(docker_client_t *client, const char *container_id);
+/* containers and events the filter (may be NULL) rejects are dropped; a
+   rejected event has selected cleared */
+int docker_parse_container_list(const char *json_data, size_t len, const container_filter_t *filter,
+                                container_list_t *list);
+int docker_parse_container_stats(const char *json_data, size_t len, container_stats_t *stats);
+int docker_parse_event(const char *json_data, const container_filter_t *filter, docker_event_t *event);
 char *format_bytes(uint64_t bytes);
 char *format_percentage(double value);
 void print_error(const char *message);
@@ -0,0 +1,19 @@
+#ifndef DOCKER_EVENTS_H
+#define DOCKER_EVENTS_H
+
+#include "docker_monitor.h"
+
+typedef struct docker_events docker_events_t;
+
+struct docker_client;
+
+/* events of one host; containers it adds are tagged with that host index */
+docker_events_t *docker_events_create(struct docker_client *client, int host);
+void docker_events_destroy(docker_events_t *events);
+int docker_events_connect(docker_events_t *events);
+int docker_events_poll(docker_events_t *events, monitor_state_t *state);
+
+/* set when an event could not be applied on its own and the full list is needed */
+int docker_events_want_resync(docker_events_t *events);
+
+#endif
@@ -3,39 +3,62 @@
 
 #include <stdint.h>
 #include <time.h>
+#include "arena.h"
 
-#define MAX_CONTAINERS 100
+#define MAX_CONTAINER_ID 65
 #define MAX_CONTAINER_NAME 256
 #define MAX_JSON_SIZE 8192
 #define DOCKER_SOCKET "/var/run/docker.sock"
+#define UNIX_HOST_PREFIX "unix://"
+#define DEFAULT_CONCURRENCY 8
+#define MAX_CONCURRENCY 64
 
 typedef struct {
-    char id[64];
+    char id[MAX_CONTAINER_ID];
     char name[MAX_CONTAINER_NAME];
     char image[MAX_CONTAINER_NAME];
     char status[32];
     time_t created;
     time_t last_seen;
+    int host;
 } container_info_t;
 
 typedef struct {
     uint64_t cpu_usage;
     uint64_t cpu_system_usage;
+    uint64_t precpu_usage;
+    uint64_t precpu_system_usage;
+    uint32_t online_cpus;
     uint64_t memory_usage;
     uint64_t memory_limit;
+    uint64_t memory_inactive_file;
     uint64_t network_rx_bytes;
     uint64_t network_tx_bytes;
     uint64_t block_read_bytes;
     uint64_t block_write_bytes;
     time_t timestamp;
+    uint64_t sample_ns;
 } container_stats_t;
 
+/* stats holds the latest raw counters; the derived fields below are
+   computed against the previous sample (or precpu_stats on the first one).
+   poll_* belong to the poll scheduler */
 typedef struct {
     container_info_t info;
     container_stats_t stats;
     double cpu_percent;
     double memory_percent;
+    uint64_t memory_working_set;
+    double network_rx_rate;
+    double network_tx_rate;
+    double block_read_rate;
+    double block_write_rate;
+    struct timeseries *history;
+    int poll_every;
+    int64_t poll_due;
+    float poll_activity;
     int is_running;
+    int in_use;
 } container_monitor_t;
 
 typedef struct {
@@ -45,22 +68,90 @@ typedef struct {
     char cert_path[256];
     char key_path[256];
     char ca_path[256];
+    int connect_timeout_ms;
+    int read_timeout_ms;
+    int use_cgroup;
+    char cgroup_root[256];
+    char proc_root[256];
+    const struct container_filter *filter;
 } docker_config_t;
 
+struct stats_worker_pool;
+struct container_filter;
+struct poll_scheduler;
+struct top_k;
+struct docker_events;
+struct docker_client;
+
+typedef struct {
+    container_info_t *items;
+    int count;
+    int capacity;
+} container_list_t;
+
+/* one entry per watched daemon; containers refer to it through info.host.
+   Replayed hosts have no client */
+typedef struct {
+    char name[256];
+    struct docker_client *client;
+    struct docker_events *events;
+    container_list_t pending;
+    int resync;
+    int list_result;
+    int reachable;
+} monitor_host_t;
+
+typedef struct {
+    int containers;
+    int running;
+    double cpu_percent;
+    uint64_t memory;
+    uint64_t memory_limit;
+} monitor_summary_t;
+
+/* containers[] slots stay put while a container is present; iterate up to
+   container_slots and skip slots that are not in_use */
 typedef struct {
-    container_monitor_t containers[MAX_CONTAINERS];
+    container_monitor_t *containers;
     int container_count;
+    int container_slots;
+    int container_capacity;
+    int *free_slots;
+    int free_count;
+    int32_t *index;
+    int index_capacity;
+    int index_used;
     time_t last_update;
     int interval;
     int running;
+    int concurrency;
+    struct stats_worker_pool *workers;
+    struct poll_scheduler *scheduler;
+    monitor_host_t *hosts;
+    int host_count;
+    /* scratch memory for the current tick, reset at the end of every
+       main loop iteration; main thread only */
+    arena_t scratch;
     docker_config_t config;
 } monitor_state_t;
 
-void init_monitor_state(monitor_state_t *state, int interval);
+void init_monitor_state(monitor_state_t *state, int interval, int concurrency);
 void cleanup_monitor_state(monitor_state_t *state);
-int get_container_list(monitor_state_t *state);
+int refresh_container_list(monitor_state_t *state);
+container_monitor_t *monitor_find_container(const monitor_state_t *state, int host, const char *id);
+container_monitor_t *monitor_add_container(monitor_state_t *state, const container_info_t *info);
+void monitor_remove_container(monitor_state_t *state, int host, const char *id);
+void monitor_table_free(monitor_state_t *state);
+int monitor_add_host(monitor_state_t *state, const char *name);
+const char *monitor_host_name(const monitor_state_t *state, int host);
+/* top, when set, is offered every running container of the pass */
+void monitor_summarize(const monitor_state_t *state, int host, monitor_summary_t *summary, struct top_k *top);
+int container_list_append(container_list_t *list, const container_info_t *info);
+void container_list_free(container_list_t *list);
 int get_container_stats(monitor_state_t *state);
+void update_container_stats(container_monitor_t *container, const container_stats_t *stats);
 void print_container_stats(const monitor_state_t *state);
-void print_summary(const monitor_state_t *state);
+void print_summary(const monitor_state_t *state, struct top_k *top);
+uint64_t monotonic_ns(void);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,154 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+/* one connection per stats worker and host (see MAX_CONCURRENCY); a worker
+   holds its connection until the response is released */
+#define HTTP_POOL_SIZE 64
+#define HTTP_REQUEST_SIZE 1024
+#define HTTP_MAX_HEADER_SIZE 16384
+#define HTTP_MAX_STREAM_LINE (1024 * 1024)
+/* a larger response is taken for a broken daemon rather than buffered */
+#define HTTP_MAX_BODY_SIZE (256 * 1024 * 1024)
+#define HTTP_MAX_IDLE_BUFFER (256 * 1024)
+#define HTTP_IDLE_BUFFER_SECONDS 300
+#define HTTP_CONNECT_TIMEOUT_MS 3000
+#define HTTP_IO_TIMEOUT_MS 10000
+#define HTTP_BACKOFF_MIN_MS 1000
+#define HTTP_BACKOFF_MAX_MS 30000
+
+struct ssl_st;
+struct tls_client;
+struct resolver;
+
+/* each connection keeps its receive buffer between requests, so a steady
+   stream of similar responses does not allocate at all; ssl is set when
+   the pool speaks TLS */
+typedef struct {
+    int fd;
+    struct ssl_st *ssl;
+    int in_use;
+    int keep_alive;
+    char *buffer;
+    size_t capacity;
+    time_t large_used;
+} http_conn_t;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t connects;
+    uint64_t reused;
+    uint64_t retries;
+    uint64_t failures;
+    uint64_t tls_handshakes;
+    uint64_t tls_resumed;
+    uint64_t timeouts;
+    uint64_t skipped;
+} http_pool_stats_t;
+
+typedef struct {
+    char host[256];
+    int port;
+    char unix_path[108];
+    http_conn_t conns[HTTP_POOL_SIZE];
+    struct tls_client *tls;
+    struct resolver *resolver;
+    int connect_timeout_ms;
+    int io_timeout_ms;
+    /* after a connect failure or timeout the host is given a rest that
+       doubles with every failure in a row; meanwhile requests fail at once
+       and when it is over a single request probes the host */
+    int failures_in_row;
+    uint64_t retry_at;
+    int probing;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    http_pool_stats_t stats;
+} http_pool_t;
+
+/* body points into the connection buffer (NUL-terminated for convenience)
+   and stays valid until http_response_release hands the connection back */
+typedef struct {
+    http_conn_t *conn;
+    int status;
+    const char *body;
+    size_t len;
+} http_response_t;
+
+typedef struct {
+    int status;
+    long long content_length;
+    int chunked;
+    int keep_alive;
+    size_t header_size;
+} http_response_head_t;
+
+enum {
+    HTTP_CHUNK_SIZE,
+    HTTP_CHUNK_DATA,
+    HTTP_CHUNK_DATA_END,
+    HTTP_CHUNK_TRAILER,
+    HTTP_CHUNK_DONE
+};
+
+typedef struct {
+    int state;
+    uint64_t remaining;
+} http_chunk_decoder_t;
+
+typedef struct {
+    int fd;
+    struct ssl_st *ssl;
+    int head_done;
+    http_response_head_t head;
+    http_chunk_decoder_t decoder;
+    char *buffer;
+    size_t capacity;
+    size_t len;
+    size_t decoded;
+    size_t raw;
+} http_stream_t;
+
+typedef void (*http_line_cb)(void *ctx, char *line, size_t len);
+
+/* unix_path != NULL selects a unix socket, otherwise host:port over TCP */
+int http_pool_init(http_pool_t *pool, const char *host, int port, const char *unix_path);
+void http_pool_cleanup(http_pool_t *pool);
+
+/* connect_ms bounds name lookup, connect and TLS handshake; io_ms every
+   wait for the daemon on a pooled connection. 0 keeps the default */
+void http_pool_set_timeouts(http_pool_t *pool, int connect_ms, int io_ms);
+
+/* every connection of the pool, streams included, is wrapped in TLS from
+   then on; see tls_client.h for the paths */
+int http_pool_enable_tls(http_pool_t *pool, const char *ca_path, const char *cert_path, const char *key_path);
+int http_pool_prime(http_pool_t *pool);
+int http_pool_request(http_pool_t *pool, const char *method, const char *path, http_response_t *response);
+void http_response_release(http_pool_t *pool, http_response_t *response);
+void http_pool_get_stats(http_pool_t *pool, http_pool_stats_t *stats);
+/* connects and, for a TLS pool, completes the handshake; the connect
+   stage covers both */
+int http_pool_connect(http_pool_t *pool, struct ssl_st **ssl);
+int http_format_request(const http_pool_t *pool, const char *method, const char *path,
+                        char *buffer, size_t size);
+
+/* long-lived streaming responses (stats?stream=true, /events) on a dedicated
+   non-blocking connection; http_stream_read returns -1 once the stream ends */
+int http_stream_open(http_stream_t *stream, http_pool_t *pool, const char *path);
+void http_stream_close(http_stream_t *stream);
+int http_stream_read(http_stream_t *stream, http_line_cb cb, void *ctx);
+
+/* returns 1 when the head is complete, 0 if more data is needed, -1 on malformed input */
+int http_parse_response_head(const char *data, size_t len, http_response_head_t *head);
+
+/* decodes chunked data from in to out (out may alias in at a lower or equal address);
+   returns 1 after the terminating chunk, 0 if more data is needed, -1 on error */
+void http_chunk_decoder_init(http_chunk_decoder_t *dec);
+int http_chunk_decode(http_chunk_decoder_t *dec, const char *in, size_t in_len,
+                      char *out, size_t *produced, size_t *consumed);
+
+#endif
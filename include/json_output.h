@@ -0,0 +1,29 @@
+#ifndef JSON_OUTPUT_H
+#define JSON_OUTPUT_H
+
+#include "docker_monitor.h"
+#include "text_buffer.h"
+#include "top_k.h"
+
+typedef struct {
+    int fd;
+    text_buffer_t buffer;
+} json_output_t;
+
+/* NDJSON: one object per container (or one summary object per host) per tick,
+   rendered into one reused buffer and flushed with a single write. With top
+   the summary objects are followed by the ranked containers, each with its
+   "rank" */
+int json_output_init(json_output_t *out, int fd);
+void json_output_free(json_output_t *out);
+int json_output_write_tick(json_output_t *out, const monitor_state_t *state, int summary_only, top_k_t *top);
+
+/* one {"timestamp":...,"stages":{...}} object with the stage latencies in microseconds */
+int json_output_write_stages(json_output_t *out, time_t timestamp);
+
+void json_output_render_container(text_buffer_t *buffer, const monitor_state_t *state,
+                                  const container_monitor_t *container);
+void json_output_render_summary(text_buffer_t *buffer, const monitor_state_t *state, top_k_t *top);
+void json_output_append_string(text_buffer_t *buffer, const char *value);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef JSON_SCAN_H
+#define JSON_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_SCAN_MAX_DEPTH 32
+#define JSON_SCAN_MAX_KEY 64
+#define JSON_SCAN_MAX_TOKEN 512
+
+typedef enum {
+    JSON_SCAN_STRING,
+    JSON_SCAN_NUMBER,
+    JSON_SCAN_TRUE,
+    JSON_SCAN_FALSE,
+    JSON_SCAN_NULL,
+    JSON_SCAN_OBJECT_START,
+    JSON_SCAN_OBJECT_END,
+    JSON_SCAN_ARRAY_START,
+    JSON_SCAN_ARRAY_END
+} json_scan_event_t;
+
+typedef struct {
+    char type;
+    int index;
+    char key[JSON_SCAN_MAX_KEY];
+} json_scan_level_t;
+
+typedef struct json_scan json_scan_t;
+
+/* called for every value; the path of the value (levels[0..depth-1]) is
+   available through json_scan_match/json_scan_key while the callback runs.
+   value/len hold the unescaped string or the number text, truncated to
+   JSON_SCAN_MAX_TOKEN - 1 bytes */
+typedef void (*json_scan_cb)(void *ctx, const json_scan_t *scan, json_scan_event_t event,
+                             const char *value, size_t len);
+
+struct json_scan {
+    int state;
+    int depth;
+    int done;
+    json_scan_level_t levels[JSON_SCAN_MAX_DEPTH];
+    char token[JSON_SCAN_MAX_TOKEN];
+    size_t token_len;
+    int in_key;
+    const char *literal;
+    int literal_pos;
+    uint32_t unicode;
+    int unicode_digits;
+    uint32_t high_surrogate;
+    json_scan_cb cb;
+    void *ctx;
+};
+
+/* incremental scanner: the document may be fed in any number of pieces and
+   nothing is allocated; feed returns -1 on malformed input */
+void json_scan_init(json_scan_t *scan, json_scan_cb cb, void *ctx);
+int json_scan_feed(json_scan_t *scan, const char *data, size_t len);
+int json_scan_finish(json_scan_t *scan);
+
+/* path is dot-separated keys, "*" matches any key or array index */
+int json_scan_match(const json_scan_t *scan, const char *path);
+const char *json_scan_key(const json_scan_t *scan, int level);
+int json_scan_index(const json_scan_t *scan, int level);
+int json_scan_depth(const json_scan_t *scan);
+
+uint64_t json_scan_u64(const char *value, size_t len);
+int64_t json_scan_i64(const char *value, size_t len);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include "docker_monitor.h"
+#include "text_buffer.h"
+
+#define METRICS_DEFAULT_ADDRESS "0.0.0.0"
+#define METRICS_BYTES_PER_CONTAINER 2048
+
+typedef struct metrics_exporter metrics_exporter_t;
+
+/* listen_address is "port" or "address:port"; the server runs on its own thread */
+metrics_exporter_t *metrics_exporter_start(const char *listen_address);
+void metrics_exporter_stop(metrics_exporter_t *exporter);
+
+/* renders the state on the caller's thread and swaps it in for the server */
+int metrics_exporter_publish(metrics_exporter_t *exporter, const monitor_state_t *state);
+
+int metrics_render(text_buffer_t *out, const monitor_state_t *state);
+
+#endif
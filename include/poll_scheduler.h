@@ -0,0 +1,29 @@
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include "docker_monitor.h"
+
+#define POLL_MAX_EVERY 32
+
+/* a timer wheel of per-container poll deadlines counted in ticks. Containers
+   whose CPU or memory moves are polled every tick, quiet ones back off by
+   doubling up to max_every ticks; budget caps the stats requests sent to
+   one daemon per tick (0 - no cap) */
+typedef struct poll_scheduler poll_scheduler_t;
+
+poll_scheduler_t *poll_scheduler_create(int max_every, int budget);
+void poll_scheduler_destroy(poll_scheduler_t *scheduler);
+
+/* a new container is polled on the next tick */
+void poll_scheduler_add(poll_scheduler_t *scheduler, container_monitor_t *container, int slot);
+
+/* advances one tick and picks the containers to poll, least recently
+   sampled first; ones over budget move to the next tick */
+int poll_scheduler_begin(poll_scheduler_t *scheduler, monitor_state_t *state);
+int poll_scheduler_slot(const poll_scheduler_t *scheduler, int index);
+
+/* adapts each polled container's interval to how much it changed and
+   puts it back on the wheel */
+void poll_scheduler_end(poll_scheduler_t *scheduler, monitor_state_t *state);
+
+#endif
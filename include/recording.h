@@ -0,0 +1,28 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include "docker_monitor.h"
+
+/* the file is append-only: an 8 byte magic followed by frames of
+   [type][varint length][payload]. Every session starts with a frame that
+   resets the string table and the per-container delta state, so separate
+   runs can append to the same file. Every container entry names its host */
+#define RECORDING_MAGIC "DMONREC1"
+#define RECORDING_MAGIC_LEN 8
+
+typedef struct recording_writer recording_writer_t;
+typedef struct recording_reader recording_reader_t;
+
+/* opens or creates path for appending; a torn frame left by a crash is cut off */
+recording_writer_t *recording_writer_open(const char *path);
+int recording_write_tick(recording_writer_t *writer, const monitor_state_t *state);
+void recording_writer_close(recording_writer_t *writer);
+
+recording_reader_t *recording_reader_open(const char *path);
+
+/* applies the next recorded tick to state through the normal update path.
+   Returns 1 when a tick was applied, 0 at the end and -1 on a damaged frame */
+int recording_reader_next(recording_reader_t *reader, monitor_state_t *state);
+void recording_reader_close(recording_reader_t *reader);
+
+#endif
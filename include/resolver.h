@@ -0,0 +1,34 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include <sys/socket.h>
+
+#define RESOLVER_MAX_ADDRS 8
+#define RESOLVER_TTL_SECONDS 60
+#define RESOLVER_RETRY_SECONDS 5
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+} resolver_addr_t;
+
+/* addresses of one daemon host, IPv4 and IPv6, from getaddrinfo. They are
+   kept for RESOLVER_TTL_SECONDS; an expired list is still handed out while
+   a lookup in the background replaces it, so only the very first lookup
+   of a name is waited for. Numeric addresses never expire. Safe to use
+   from the stats workers */
+typedef struct resolver resolver_t;
+
+resolver_t *resolver_create(const char *host, int port);
+void resolver_destroy(resolver_t *resolver);
+
+/* copies up to max addresses, the one that last worked first. Waits at
+   most timeout_ms when nothing is cached yet; returns the count, or -1
+   with the reason in error (may be NULL) */
+int resolver_lookup(resolver_t *resolver, int timeout_ms, resolver_addr_t *addrs, int max,
+                    char *error, size_t error_size);
+
+/* the address a connection succeeded with is tried first next time */
+void resolver_prefer(resolver_t *resolver, const resolver_addr_t *addr);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* process-wide latency histograms for the stages of a tick. Recording is two
+   clock reads and a few relaxed atomic adds, so it stays on in production */
+typedef enum {
+    STAGE_CONNECT,
+    STAGE_WAIT,
+    STAGE_RECEIVE,
+    STAGE_PARSE_LIST,
+    STAGE_PARSE_STATS,
+    STAGE_CGROUP,
+    STAGE_COLLECT,
+    STAGE_ALERTS,
+    STAGE_RENDER,
+    STAGE_METRICS,
+    STAGE_COUNT
+} stage_id_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+} stage_summary_t;
+
+uint64_t stage_now(void);
+
+/* records now - start for stage and returns now, so stages can be chained */
+uint64_t stage_record(stage_id_t stage, uint64_t start);
+
+const char *stage_name(stage_id_t stage);
+
+/* percentiles are the upper bound of their bucket, within 1/16 of the value */
+void stage_summarize(stage_id_t stage, stage_summary_t *summary);
+void stage_print(FILE *out);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef STATS_STREAM_H
+#define STATS_STREAM_H
+
+#include "docker_monitor.h"
+
+typedef struct stats_stream stats_stream_t;
+
+stats_stream_t *stats_stream_create(void);
+void stats_stream_destroy(stats_stream_t *streams);
+int stats_stream_sync(stats_stream_t *streams, monitor_state_t *state);
+int stats_stream_poll(stats_stream_t *streams, int timeout_ms);
+int stats_stream_count(const stats_stream_t *streams);
+
+#endif
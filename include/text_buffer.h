@@ -0,0 +1,29 @@
+#ifndef TEXT_BUFFER_H
+#define TEXT_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* growable output buffer that is reset and reused between renders; an
+   allocation failure is sticky until the next reset, so a long series of
+   appends can be checked once at the end */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    int failed;
+} text_buffer_t;
+
+int text_buffer_init(text_buffer_t *buffer, size_t capacity);
+void text_buffer_free(text_buffer_t *buffer);
+void text_buffer_reset(text_buffer_t *buffer);
+int text_buffer_reserve(text_buffer_t *buffer, size_t extra);
+int text_buffer_append(text_buffer_t *buffer, const char *data, size_t len);
+int text_buffer_append_str(text_buffer_t *buffer, const char *str);
+int text_buffer_append_u64(text_buffer_t *buffer, uint64_t value);
+int text_buffer_append_i64(text_buffer_t *buffer, int64_t value);
+int text_buffer_append_fixed(text_buffer_t *buffer, double value, int decimals);
+int text_buffer_printf(text_buffer_t *buffer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define TS_RAW_CAPACITY 300
+#define TS_MINUTE_CAPACITY 180
+#define TS_HOUR_CAPACITY 168
+
+typedef enum {
+    TS_CPU_PERCENT,
+    TS_MEMORY_WORKING_SET,
+    TS_MEMORY_PERCENT,
+    TS_NETWORK_RX_RATE,
+    TS_NETWORK_TX_RATE,
+    TS_BLOCK_READ_RATE,
+    TS_BLOCK_WRITE_RATE,
+    TS_METRIC_COUNT
+} ts_metric_t;
+
+/* every tier is a ring of struct-of-arrays columns, so a scan over one
+   metric walks one contiguous array */
+typedef struct {
+    int head;
+    int count;
+    int64_t time[TS_RAW_CAPACITY];
+    float value[TS_METRIC_COUNT][TS_RAW_CAPACITY];
+} ts_raw_tier_t;
+
+#define TS_ROLLUP_TIER(capacity) struct {         \
+    int head;                                     \
+    int count;                                    \
+    int64_t start[capacity];                      \
+    uint32_t samples[capacity];                   \
+    float min[TS_METRIC_COUNT][capacity];         \
+    float max[TS_METRIC_COUNT][capacity];         \
+    float sum[TS_METRIC_COUNT][capacity];         \
+    float last[TS_METRIC_COUNT][capacity];        \
+}
+
+typedef struct timeseries {
+    ts_raw_tier_t raw;
+    TS_ROLLUP_TIER(TS_MINUTE_CAPACITY) minute;
+    TS_ROLLUP_TIER(TS_HOUR_CAPACITY) hour;
+} timeseries_t;
+
+typedef struct {
+    double min;
+    double max;
+    double avg;
+    double last;
+    double p95;
+    uint32_t samples;
+    int resolution;
+} ts_summary_t;
+
+timeseries_t *timeseries_create(void);
+void timeseries_destroy(timeseries_t *series);
+
+/* O(1): writes the raw sample and folds it into the open minute/hour buckets */
+void timeseries_append(timeseries_t *series, time_t time, const float values[TS_METRIC_COUNT]);
+
+/* summarises [now - window, now] from the finest tier that still covers the
+   window; from the rollup tiers p95 is taken over bucket averages.
+   Returns -1 when there are no samples in the window */
+int timeseries_query(const timeseries_t *series, ts_metric_t metric, time_t now, int window,
+                     ts_summary_t *summary);
+
+/* copies up to max of the most recent raw values, oldest first */
+int timeseries_recent(const timeseries_t *series, ts_metric_t metric, float *values, int max);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef TLS_CLIENT_H
+#define TLS_CLIENT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* OpenSSL's SSL; kept opaque so only tls_client.c needs its headers */
+struct ssl_st;
+
+/* one TLS context per daemon. The newest session ticket the daemon issued
+   is kept and offered on every new connection, so after the first full
+   handshake reconnects are abbreviated handshakes without certificate
+   exchange. Safe to use from the stats workers */
+typedef struct tls_client tls_client_t;
+
+/* the peer is verified against ca_path, or the system store without it;
+   cert_path/key_path add a client certificate (docker --tlsverify) */
+tls_client_t *tls_client_create(const char *host, const char *ca_path, const char *cert_path,
+                                const char *key_path);
+void tls_client_destroy(tls_client_t *tls);
+
+/* runs the handshake on a connected socket; NULL on failure, which is
+   reported once per distinct reason. *resumed tells whether the cached
+   session was accepted */
+struct ssl_st *tls_client_connect(tls_client_t *tls, int fd, int *resumed);
+void tls_close(struct ssl_st *ssl);
+
+/* recv/send semantics: -1 with errno EAGAIN when a non-blocking socket
+   has nothing more, 0 once the peer closed the connection */
+ssize_t tls_recv(struct ssl_st *ssl, void *buffer, size_t len);
+ssize_t tls_send(struct ssl_st *ssl, const void *data, size_t len);
+
+/* an idle connection may have received session tickets or a close_notify;
+   returns 1 when it is still usable for the next request */
+int tls_idle_ok(struct ssl_st *ssl, int fd);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include "docker_monitor.h"
+
+#define MAX_TOP_K 1000
+
+typedef enum {
+    TOP_CPU,
+    TOP_MEMORY,
+    TOP_NETWORK,
+    TOP_IO,
+    TOP_METRIC_COUNT
+} top_metric_t;
+
+/* the k running containers with the largest value of one metric, kept in a
+   bounded min-heap: a container that does not beat the smallest kept value
+   costs one comparison, so a pass over n containers is O(n log k) */
+typedef struct top_k top_k_t;
+
+top_k_t *top_k_create(top_metric_t metric, int k);
+void top_k_destroy(top_k_t *top);
+
+/* cpu, memory, network (rx + tx) or io (read + write); -1 for anything else */
+int top_k_parse_metric(const char *name);
+const char *top_k_metric_name(top_metric_t metric);
+top_metric_t top_k_metric(const top_k_t *top);
+double top_k_value(top_metric_t metric, const container_monitor_t *container);
+
+/* a tick starts with reset; monitor_summarize adds the running containers
+   of its pass */
+void top_k_reset(top_k_t *top);
+void top_k_add(top_k_t *top, const container_monitor_t *container, int slot);
+
+/* sorts the kept containers largest first and returns their count and
+   container slots; the next add needs a reset first */
+int top_k_sorted(top_k_t *top, const int **slots);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef TUI_H
+#define TUI_H
+
+#include <stdint.h>
+#include "docker_monitor.h"
+
+typedef enum {
+    TUI_SORT_CPU,
+    TUI_SORT_MEMORY,
+    TUI_SORT_NETWORK,
+    TUI_SORT_IO,
+    TUI_SORT_NAME,
+    TUI_SORT_COUNT
+} tui_sort_t;
+
+typedef enum {
+    TUI_NONE,
+    TUI_REDRAW,
+    TUI_QUIT
+} tui_action_t;
+
+typedef struct tui tui_t;
+
+/* puts the terminal into raw mode on the alternate screen and captures
+   stderr, whose last line is shown in the status row; NULL when stdin or
+   stdout is not a terminal. tui_close restores all of it */
+tui_t *tui_open(void);
+void tui_close(tui_t *tui);
+
+/* readable when a key is waiting */
+int tui_input_fd(const tui_t *tui);
+
+/* reads the pending keys; TUI_REDRAW when the view or the window size changed */
+tui_action_t tui_handle_input(tui_t *tui);
+
+/* draws the table into a cell grid and writes only the cells that differ
+   from the previous frame, in a single write */
+int tui_render(tui_t *tui, const monitor_state_t *state);
+
+void tui_get_stats(const tui_t *tui, uint64_t *frames, uint64_t *bytes);
+
+#endif
@@ -0,0 +1,715 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../include/alert_engine.h"
+#include "../include/docker_api.h"
+#include "../include/json_output.h"
+#include "../include/text_buffer.h"
+#include "../include/timeseries.h"
+
+typedef enum {
+    RULE_THRESHOLD,
+    RULE_RATE,
+    RULE_RESTART
+} rule_kind_t;
+
+typedef enum {
+    OP_GT,
+    OP_GE,
+    OP_LT,
+    OP_LE
+} rule_op_t;
+
+/* rates are kept per second whatever unit the rule was written in */
+typedef struct {
+    char name[MAX_ALERT_NAME];
+    char text[128];
+    rule_kind_t kind;
+    ts_metric_t metric;
+    rule_op_t op;
+    double threshold;
+    uint64_t hold_ns;
+} alert_rule_t;
+
+typedef struct {
+    uint64_t since_ns;
+    int firing;
+} rule_state_t;
+
+/* the last evaluated sample of the container in a table slot */
+typedef struct {
+    char id[MAX_CONTAINER_ID];
+    int host;
+    uint64_t sample_ns;
+    double values[TS_METRIC_COUNT];
+} slot_state_t;
+
+/* restarts are told apart by (host, name): with the event stream a restarted
+   container leaves the table on die and comes back in another slot */
+typedef struct {
+    uint64_t key;
+    char id[MAX_CONTAINER_ID];
+    time_t created;
+    uint64_t cpu_usage;
+    uint64_t seen_ns;
+} known_container_t;
+
+struct alert_engine {
+    alert_rule_t rules[MAX_ALERT_RULES];
+    int rule_count;
+    int restart_rules;
+    slot_state_t *slots;
+    rule_state_t *states;
+    int slot_capacity;
+    known_container_t *known;
+    int known_count;
+    int known_capacity;
+    FILE *log;
+    char *command;
+    int hooks;
+    text_buffer_t buffer;
+};
+
+static const char *metric_names[TS_METRIC_COUNT] = {
+    "cpu_percent", "memory_working_set", "memory_percent",
+    "network_rx_rate", "network_tx_rate", "block_read_rate", "block_write_rate"
+};
+
+/* variables handed to the hook, in the order run_hook fills them */
+static const char *hook_vars[] = {
+    "ALERT_STATUS", "ALERT_RULE", "ALERT_EXPR", "ALERT_HOST", "ALERT_ID", "ALERT_NAME", "ALERT_VALUE"
+};
+
+#define HOOK_VARS ((int)(sizeof(hook_vars) / sizeof(hook_vars[0])))
+#define KNOWN_EXPIRE_NS (3600ULL * 1000000000ULL)
+
+static int parse_rule(const char *text, alert_rule_t *rule);
+static int parse_number(const char *text, double *value, const char **end);
+static int parse_duration(const char *text, uint64_t *ns);
+static int reserve_slots(alert_engine_t *engine, int slots);
+static int check_restart(alert_engine_t *engine, const container_monitor_t *container);
+static known_container_t *find_known(alert_engine_t *engine, uint64_t key);
+static int grow_known(alert_engine_t *engine);
+static void notify(alert_engine_t *engine, const monitor_state_t *state, const container_monitor_t *container,
+                   const alert_rule_t *rule, int firing, double value);
+static void run_hook(alert_engine_t *engine, const monitor_state_t *state, const container_monitor_t *container,
+                     const alert_rule_t *rule, int firing, double value);
+static int is_hook_var(const char *entry);
+static void reap_hooks(alert_engine_t *engine);
+
+alert_engine_t *alert_engine_create(void) {
+    alert_engine_t *engine = calloc(1, sizeof(alert_engine_t));
+    if (!engine) {
+        return NULL;
+    }
+    
+    if (text_buffer_init(&engine->buffer, 512) != 0) {
+        free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+void alert_engine_destroy(alert_engine_t *engine) {
+    if (!engine) {
+        return;
+    }
+    
+    if (engine->log) {
+        fclose(engine->log);
+    }
+    reap_hooks(engine);
+    text_buffer_free(&engine->buffer);
+    free(engine->command);
+    free(engine->slots);
+    free(engine->states);
+    free(engine->known);
+    free(engine);
+}
+
+int alert_engine_add_rule(alert_engine_t *engine, const char *text) {
+    alert_rule_t rule;
+    
+    if (engine->rule_count >= MAX_ALERT_RULES || parse_rule(text, &rule) != 0) {
+        return -1;
+    }
+    
+    /* per-slot states are laid out by rule count, so they start over */
+    free(engine->states);
+    free(engine->slots);
+    engine->states = NULL;
+    engine->slots = NULL;
+    engine->slot_capacity = 0;
+    
+    engine->rules[engine->rule_count++] = rule;
+    engine->restart_rules += rule.kind == RULE_RESTART;
+    return 0;
+}
+
+int alert_engine_load_rules(alert_engine_t *engine, const char *path) {
+    char line[512];
+    char message[640];
+    int number = 0;
+    FILE *file = fopen(path, "r");
+    
+    if (!file) {
+        print_error("Не удалось открыть файл правил");
+        return -1;
+    }
+    
+    while (fgets(line, sizeof(line), file)) {
+        char *start = line;
+        
+        number++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        while (isspace((unsigned char)*start)) start++;
+        if (!*start) {
+            continue;
+        }
+        
+        if (alert_engine_add_rule(engine, start) != 0) {
+            snprintf(message, sizeof(message), "Некорректное правило в строке %d: %s", number, start);
+            print_error(message);
+            fclose(file);
+            return -1;
+        }
+    }
+    
+    fclose(file);
+    return 0;
+}
+
+int alert_engine_rule_count(const alert_engine_t *engine) {
+    return engine->rule_count;
+}
+
+int alert_engine_set_log(alert_engine_t *engine, const char *path) {
+    FILE *log = fopen(path, "a");
+    if (!log) {
+        print_error("Не удалось открыть журнал тревог");
+        return -1;
+    }
+    
+    if (engine->log) {
+        fclose(engine->log);
+    }
+    engine->log = log;
+    return 0;
+}
+
+void alert_engine_set_exec(alert_engine_t *engine, const char *command) {
+    free(engine->command);
+    engine->command = command ? strdup(command) : NULL;
+}
+
+int alert_engine_evaluate(alert_engine_t *engine, const monitor_state_t *state) {
+    int transitions = 0;
+    
+    if (engine->rule_count == 0 || reserve_slots(engine, state->container_slots) != 0) {
+        return 0;
+    }
+    
+    reap_hooks(engine);
+    
+    for (int slot = 0; slot < state->container_slots; slot++) {
+        const container_monitor_t *container = &state->containers[slot];
+        slot_state_t *previous = &engine->slots[slot];
+        rule_state_t *states = &engine->states[slot * engine->rule_count];
+        
+        if (!container->in_use) {
+            previous->id[0] = '\0';
+            continue;
+        }
+        
+        /* a slot reused by another container starts from scratch */
+        if (previous->host != container->info.host || strcmp(previous->id, container->info.id) != 0) {
+            memset(previous, 0, sizeof(*previous));
+            memset(states, 0, engine->rule_count * sizeof(rule_state_t));
+            snprintf(previous->id, sizeof(previous->id), "%s", container->info.id);
+            previous->host = container->info.host;
+        }
+        
+        uint64_t now = container->stats.sample_ns;
+        if (!container->is_running || now == 0 || now == previous->sample_ns) {
+            continue;
+        }
+        
+        double values[TS_METRIC_COUNT] = {
+            container->cpu_percent, (double)container->memory_working_set, container->memory_percent,
+            container->network_rx_rate, container->network_tx_rate,
+            container->block_read_rate, container->block_write_rate
+        };
+        double seconds = previous->sample_ns > 0 && now > previous->sample_ns
+                         ? (now - previous->sample_ns) / 1e9 : 0.0;
+        int restarted = engine->restart_rules > 0 && check_restart(engine, container);
+        
+        for (int i = 0; i < engine->rule_count; i++) {
+            const alert_rule_t *rule = &engine->rules[i];
+            rule_state_t *rule_state = &states[i];
+            double value = values[rule->metric];
+            int holds;
+            
+            if (rule->kind == RULE_RESTART) {
+                if (restarted) {
+                    notify(engine, state, container, rule, 1, 0.0);
+                    transitions++;
+                }
+                continue;
+            }
+            
+            if (rule->kind == RULE_RATE) {
+                if (seconds <= 0.0) {
+                    continue;
+                }
+                value = (value - previous->values[rule->metric]) / seconds;
+            }
+            
+            switch (rule->op) {
+            case OP_GT: holds = value > rule->threshold; break;
+            case OP_GE: holds = value >= rule->threshold; break;
+            case OP_LT: holds = value < rule->threshold; break;
+            default: holds = value <= rule->threshold; break;
+            }
+            
+            if (!holds) {
+                if (rule_state->firing) {
+                    notify(engine, state, container, rule, 0, value);
+                    transitions++;
+                }
+                rule_state->since_ns = 0;
+                rule_state->firing = 0;
+                continue;
+            }
+            
+            if (rule_state->since_ns == 0) {
+                rule_state->since_ns = now;
+            }
+            if (!rule_state->firing && now - rule_state->since_ns >= rule->hold_ns) {
+                rule_state->firing = 1;
+                notify(engine, state, container, rule, 1, value);
+                transitions++;
+            }
+        }
+        
+        memcpy(previous->values, values, sizeof(values));
+        previous->sample_ns = now;
+    }
+    
+    if (engine->log && transitions > 0) {
+        fflush(engine->log);
+    }
+    return transitions;
+}
+
+static int parse_rule(const char *text, alert_rule_t *rule) {
+    char buffer[256];
+    char *tokens[6];
+    int count = 0;
+    const char *end;
+    
+    memset(rule, 0, sizeof(*rule));
+    if (strlen(text) >= sizeof(buffer)) {
+        return -1;
+    }
+    strcpy(buffer, text);
+    
+    /* "name:" is optional, the rule text itself names an unnamed rule */
+    char *body = buffer;
+    char *colon = strchr(buffer, ':');
+    if (colon && strcspn(buffer, " \t<>=(") > (size_t)(colon - buffer)) {
+        *colon = '\0';
+        body = colon + 1;
+        if (!buffer[0] || strlen(buffer) >= sizeof(rule->name)) {
+            return -1;
+        }
+        snprintf(rule->name, sizeof(rule->name), "%s", buffer);
+    }
+    
+    for (char *token = strtok(body, " \t"); token; token = strtok(NULL, " \t")) {
+        if (count == 6) {
+            return -1;
+        }
+        tokens[count++] = token;
+    }
+    if (count == 0) {
+        return -1;
+    }
+    
+    /* the canonical text is what notifications show */
+    size_t len = 0;
+    for (int i = 0; i < count; i++) {
+        len += snprintf(rule->text + len, sizeof(rule->text) - len, "%s%s", i > 0 ? " " : "", tokens[i]);
+        if (len >= sizeof(rule->text)) {
+            return -1;
+        }
+    }
+    if (!rule->name[0]) {
+        snprintf(rule->name, sizeof(rule->name), "%.*s", (int)sizeof(rule->name) - 1, rule->text);
+    }
+    
+    if (count == 1 && strcmp(tokens[0], "restart") == 0) {
+        rule->kind = RULE_RESTART;
+        return 0;
+    }
+    if (count != 3 && count != 5) {
+        return -1;
+    }
+    
+    char *metric = tokens[0];
+    size_t metric_len = strlen(metric);
+    if (strncmp(metric, "rate(", 5) == 0 && metric[metric_len - 1] == ')') {
+        rule->kind = RULE_RATE;
+        metric[metric_len - 1] = '\0';
+        metric += 5;
+    }
+    
+    int found = 0;
+    for (int i = 0; i < TS_METRIC_COUNT; i++) {
+        if (strcmp(metric, metric_names[i]) == 0) {
+            rule->metric = i;
+            found = 1;
+        }
+    }
+    if (!found) {
+        return -1;
+    }
+    
+    if (strcmp(tokens[1], ">") == 0) rule->op = OP_GT;
+    else if (strcmp(tokens[1], ">=") == 0) rule->op = OP_GE;
+    else if (strcmp(tokens[1], "<") == 0) rule->op = OP_LT;
+    else if (strcmp(tokens[1], "<=") == 0) rule->op = OP_LE;
+    else return -1;
+    
+    if (parse_number(tokens[2], &rule->threshold, &end) != 0) {
+        return -1;
+    }
+    if (rule->kind == RULE_RATE) {
+        if (strcmp(end, "/s") == 0) {
+        } else if (strcmp(end, "/min") == 0 || strcmp(end, "/m") == 0) {
+            rule->threshold /= 60.0;
+        } else if (strcmp(end, "/h") == 0) {
+            rule->threshold /= 3600.0;
+        } else {
+            return -1;
+        }
+    } else if (*end) {
+        return -1;
+    }
+    
+    if (count == 5 && (strcmp(tokens[3], "for") != 0 || parse_duration(tokens[4], &rule->hold_ns) != 0)) {
+        return -1;
+    }
+    return 0;
+}
+
+/* K, M and G are powers of 1024, as in the byte sizes the monitor prints */
+static int parse_number(const char *text, double *value, const char **end) {
+    char *tail;
+    
+    *value = strtod(text, &tail);
+    if (tail == text) {
+        return -1;
+    }
+    
+    switch (*tail) {
+    case 'K': *value *= 1024.0; tail++; break;
+    case 'M': *value *= 1024.0 * 1024.0; tail++; break;
+    case 'G': *value *= 1024.0 * 1024.0 * 1024.0; tail++; break;
+    default: break;
+    }
+    *end = tail;
+    return 0;
+}
+
+static int parse_duration(const char *text, uint64_t *ns) {
+    char *tail;
+    double seconds = strtod(text, &tail);
+    
+    if (tail == text || seconds < 0) {
+        return -1;
+    }
+    if (strcmp(tail, "m") == 0 || strcmp(tail, "min") == 0) {
+        seconds *= 60.0;
+    } else if (strcmp(tail, "h") == 0) {
+        seconds *= 3600.0;
+    } else if (*tail && strcmp(tail, "s") != 0) {
+        return -1;
+    }
+    
+    *ns = (uint64_t)(seconds * 1e9);
+    return 0;
+}
+
+static int reserve_slots(alert_engine_t *engine, int slots) {
+    if (slots <= engine->slot_capacity) {
+        return 0;
+    }
+    
+    int capacity = engine->slot_capacity ? engine->slot_capacity : 64;
+    while (capacity < slots) {
+        capacity *= 2;
+    }
+    
+    slot_state_t *slot_states = realloc(engine->slots, capacity * sizeof(slot_state_t));
+    if (!slot_states) {
+        return -1;
+    }
+    engine->slots = slot_states;
+    
+    rule_state_t *states = realloc(engine->states, (size_t)capacity * engine->rule_count * sizeof(rule_state_t));
+    if (!states) {
+        return -1;
+    }
+    engine->states = states;
+    
+    memset(&engine->slots[engine->slot_capacity], 0, (capacity - engine->slot_capacity) * sizeof(slot_state_t));
+    memset(&engine->states[engine->slot_capacity * engine->rule_count], 0,
+           (size_t)(capacity - engine->slot_capacity) * engine->rule_count * sizeof(rule_state_t));
+    engine->slot_capacity = capacity;
+    return 0;
+}
+
+/* a known name with another id and creation time is a recreated container,
+   the same id with a CPU counter that went backwards one restarted in place.
+   The creation time of the same id is not compared: a container re-added
+   from a start event carries the event time until the next list resync.
+   Recordings made before creation times were stored replay with 0, and
+   there a new id alone counts */
+static int check_restart(alert_engine_t *engine, const container_monitor_t *container) {
+    uint64_t key = 1469598103934665603ULL ^ (uint64_t)container->info.host;
+    
+    for (const char *p = container->info.name; *p; p++) {
+        key = (key ^ (unsigned char)*p) * 1099511628211ULL;
+    }
+    if (key == 0) {
+        key = 1;
+    }
+    
+    known_container_t *known = find_known(engine, key);
+    if (!known) {
+        return 0;
+    }
+    
+    int restarted = 0;
+    if (known->key == key) {
+        restarted = strcmp(known->id, container->info.id) != 0
+                        ? known->created != container->info.created || container->info.created == 0
+                        : container->stats.cpu_usage < known->cpu_usage;
+    }
+    
+    if (known->key != key) {
+        known->key = key;
+        engine->known_count++;
+    }
+    snprintf(known->id, sizeof(known->id), "%s", container->info.id);
+    known->created = container->info.created;
+    known->cpu_usage = container->stats.cpu_usage;
+    known->seen_ns = container->stats.sample_ns;
+    return restarted;
+}
+
+/* open addressing with linear probing; returns the entry for key or the
+   empty one where it would go */
+static known_container_t *find_known(alert_engine_t *engine, uint64_t key) {
+    if (engine->known_count * 2 >= engine->known_capacity && grow_known(engine) != 0) {
+        return NULL;
+    }
+    
+    int mask = engine->known_capacity - 1;
+    for (int i = (int)(key & mask);; i = (i + 1) & mask) {
+        if (engine->known[i].key == key || engine->known[i].key == 0) {
+            return &engine->known[i];
+        }
+    }
+}
+
+/* names not seen for an hour are dropped on the way, so churn does not
+   grow the table forever */
+static int grow_known(alert_engine_t *engine) {
+    known_container_t *old = engine->known;
+    int old_capacity = engine->known_capacity;
+    uint64_t newest = 0;
+    int live = 0;
+    
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].key && old[i].seen_ns > newest) {
+            newest = old[i].seen_ns;
+        }
+    }
+    for (int i = 0; i < old_capacity; i++) {
+        live += old[i].key && old[i].seen_ns + KNOWN_EXPIRE_NS >= newest;
+    }
+    
+    int capacity = 64;
+    while (capacity < live * 4) {
+        capacity *= 2;
+    }
+    
+    known_container_t *known = calloc(capacity, sizeof(known_container_t));
+    if (!known) {
+        return -1;
+    }
+    
+    engine->known = known;
+    engine->known_capacity = capacity;
+    engine->known_count = 0;
+    for (int i = 0; i < old_capacity; i++) {
+        if (old[i].key && old[i].seen_ns + KNOWN_EXPIRE_NS >= newest) {
+            *find_known(engine, old[i].key) = old[i];
+            engine->known_count++;
+        }
+    }
+    
+    free(old);
+    return 0;
+}
+
+static void notify(alert_engine_t *engine, const monitor_state_t *state, const container_monitor_t *container,
+                   const alert_rule_t *rule, int firing, double value) {
+    const char *host = monitor_host_name(state, container->info.host);
+    time_t now = time(NULL);
+    
+    if (!engine->log && !engine->command) {
+        char stamp[16];
+        struct tm tm_info;
+        
+        localtime_r(&now, &tm_info);
+        strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm_info);
+        if (rule->kind == RULE_RESTART) {
+            fprintf(stderr, "[%s] Тревога %s: контейнер %s перезапущен\n", stamp, rule->name, container->info.name);
+        } else {
+            fprintf(stderr, "[%s] %s %s: контейнер %s, %s%s%s = %.2f%s (%s)\n", stamp,
+                    firing ? "Тревога" : "Норма", rule->name, container->info.name,
+                    rule->kind == RULE_RATE ? "rate(" : "", metric_names[rule->metric],
+                    rule->kind == RULE_RATE ? ")" : "", value, rule->kind == RULE_RATE ? "/с" : "", rule->text);
+        }
+    }
+    
+    if (engine->log) {
+        text_buffer_t *buffer = &engine->buffer;
+        
+        text_buffer_reset(buffer);
+        text_buffer_append_str(buffer, "{\"timestamp\":");
+        text_buffer_append_i64(buffer, now);
+        text_buffer_append_str(buffer, ",\"status\":");
+        text_buffer_append_str(buffer, firing ? "\"firing\"" : "\"resolved\"");
+        text_buffer_append_str(buffer, ",\"rule\":");
+        json_output_append_string(buffer, rule->name);
+        text_buffer_append_str(buffer, ",\"expr\":");
+        json_output_append_string(buffer, rule->text);
+        text_buffer_append_str(buffer, ",\"host\":");
+        json_output_append_string(buffer, host);
+        text_buffer_append_str(buffer, ",\"id\":");
+        json_output_append_string(buffer, container->info.id);
+        text_buffer_append_str(buffer, ",\"name\":");
+        json_output_append_string(buffer, container->info.name);
+        if (rule->kind != RULE_RESTART) {
+            text_buffer_append_str(buffer, ",\"value\":");
+            text_buffer_append_fixed(buffer, value, 4);
+        }
+        text_buffer_append_str(buffer, "}\n");
+        if (!buffer->failed) {
+            fwrite(buffer->data, 1, buffer->len, engine->log);
+        }
+    }
+    
+    if (engine->command) {
+        run_hook(engine, state, container, rule, firing, value);
+    }
+}
+
+/* the hook runs detached and is reaped on a later tick; a burst beyond
+   MAX_ALERT_HOOKS hooks in flight is reported instead of starting more.
+   The environment is built up front and the hook is started with
+   posix_spawn, since the workers and the exporter are running threads.
+   Its stdout goes to stderr so -j and --tui output stay intact */
+static void run_hook(alert_engine_t *engine, const monitor_state_t *state, const container_monitor_t *container,
+                     const alert_rule_t *rule, int firing, double value) {
+    extern char **environ;
+    char vars[HOOK_VARS][512];
+    char number[32];
+    const char *values[HOOK_VARS];
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t none;
+    pid_t pid;
+    int count = 0;
+    int result;
+    
+    if (engine->hooks >= MAX_ALERT_HOOKS) {
+        fprintf(stderr, "Тревога %s: обработчик не запущен, уже выполняется %d\n", rule->name, engine->hooks);
+        return;
+    }
+    
+    snprintf(number, sizeof(number), "%.4f", value);
+    values[0] = firing ? "firing" : "resolved";
+    values[1] = rule->name;
+    values[2] = rule->text;
+    values[3] = monitor_host_name(state, container->info.host);
+    values[4] = container->info.id;
+    values[5] = container->info.name;
+    values[6] = number;
+    
+    while (environ[count]) {
+        count++;
+    }
+    char **envp = malloc((count + HOOK_VARS + 1) * sizeof(char *));
+    if (!envp) {
+        print_error("Не удалось запустить обработчик тревоги");
+        return;
+    }
+    count = 0;
+    for (char **entry = environ; *entry; entry++) {
+        if (!is_hook_var(*entry)) {
+            envp[count++] = *entry;
+        }
+    }
+    for (int i = 0; i < HOOK_VARS; i++) {
+        snprintf(vars[i], sizeof(vars[i]), "%s=%s", hook_vars[i], values[i]);
+        envp[count++] = vars[i];
+    }
+    envp[count] = NULL;
+    
+    /* the monitor keeps SIGUSR1 blocked outside its main loop */
+    sigemptyset(&none);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, STDERR_FILENO, STDOUT_FILENO);
+    
+    char *argv[] = { "sh", "-c", engine->command, NULL };
+    result = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, envp);
+    
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    free(envp);
+    
+    if (result != 0) {
+        print_error("Не удалось запустить обработчик тревоги");
+        return;
+    }
+    engine->hooks++;
+}
+
+static int is_hook_var(const char *entry) {
+    for (int i = 0; i < HOOK_VARS; i++) {
+        size_t len = strlen(hook_vars[i]);
+        if (strncmp(entry, hook_vars[i], len) == 0 && entry[len] == '=') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void reap_hooks(alert_engine_t *engine) {
+    while (engine->hooks > 0 && waitpid(-1, NULL, WNOHANG) > 0) {
+        engine->hooks--;
+    }
+}
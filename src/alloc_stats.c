@@ -0,0 +1,89 @@
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdatomic.h>
+#include "../include/alloc_stats.h"
+
+/* exported by glibc for exactly this kind of wrapper; calling them avoids
+   the recursion of looking up the next malloc with dlsym, which allocates */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static _Atomic uint64_t allocations;
+static _Atomic uint64_t frees;
+static _Atomic uint64_t bytes;
+
+/* only the main loop closes ticks */
+static uint64_t tick_start;
+static uint64_t ticks;
+static uint64_t quiet_ticks;
+static uint64_t last_tick;
+static uint64_t max_tick;
+
+static void count_allocation(size_t size);
+
+void *malloc(size_t size) {
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+/* a realloc that stays in place is counted too: the point is the call */
+void *realloc(void *ptr, size_t size) {
+    count_allocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    if (ptr) {
+        atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    }
+    __libc_free(ptr);
+}
+
+void alloc_stats_tick(void) {
+    uint64_t now = atomic_load_explicit(&allocations, memory_order_relaxed);
+    
+    last_tick = now - tick_start;
+    tick_start = now;
+    if (last_tick > max_tick) {
+        max_tick = last_tick;
+    }
+    if (last_tick == 0) {
+        quiet_ticks++;
+    }
+    ticks++;
+}
+
+void alloc_stats_get(alloc_stats_t *stats) {
+    stats->allocations = atomic_load_explicit(&allocations, memory_order_relaxed);
+    stats->frees = atomic_load_explicit(&frees, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&bytes, memory_order_relaxed);
+    stats->ticks = ticks;
+    stats->quiet_ticks = quiet_ticks;
+    stats->last_tick = last_tick;
+    stats->max_tick = max_tick;
+}
+
+void alloc_stats_print(FILE *out) {
+    alloc_stats_t stats;
+    
+    alloc_stats_get(&stats);
+    fprintf(out, "Выделения памяти: %llu (освобождено %llu, %llu байт), тактов без выделений %llu из %llu, "
+            "в последнем такте %llu, максимум за такт %llu\n",
+            (unsigned long long)stats.allocations, (unsigned long long)stats.frees,
+            (unsigned long long)stats.bytes, (unsigned long long)stats.quiet_ticks,
+            (unsigned long long)stats.ticks, (unsigned long long)stats.last_tick,
+            (unsigned long long)stats.max_tick);
+    fflush(out);
+}
+
+static void count_allocation(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&bytes, size, memory_order_relaxed);
+}
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+struct arena_block {
+    arena_block_t *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static arena_block_t *new_block(size_t size);
+
+void arena_init(arena_t *arena) {
+    arena->head = NULL;
+    arena->capacity = 0;
+}
+
+void arena_free(arena_t *arena) {
+    arena_block_t *block = arena->head;
+    
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena_init(arena);
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    arena_block_t *block = arena->head;
+    
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!block || block->size - block->used < size) {
+        /* doubling keeps the number of blocks in one tick logarithmic */
+        size_t block_size = arena->capacity > ARENA_MIN_BLOCK ? arena->capacity : ARENA_MIN_BLOCK;
+        if (block_size < size) {
+            block_size = size;
+        }
+        
+        block = new_block(block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->head;
+        arena->head = block;
+        arena->capacity += block_size;
+    }
+    
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void *arena_calloc(arena_t *arena, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    
+    void *ptr = arena_alloc(arena, count * size);
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void arena_reset(arena_t *arena) {
+    arena_block_t *block = arena->head;
+    
+    if (block && block->next) {
+        /* the tick needed more than one block: replace the chain with one
+           block that holds all of it; on failure the chain is simply freed */
+        size_t capacity = arena->capacity;
+        
+        arena_free(arena);
+        block = new_block(capacity);
+        if (block) {
+            arena->head = block;
+            arena->capacity = capacity;
+        }
+    } else if (block) {
+        block->used = 0;
+    }
+}
+
+static arena_block_t *new_block(size_t size) {
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+    
+    if (block) {
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+    }
+    return block;
+}
@@ -0,0 +1,484 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../include/cgroup_stats.h"
+
+#define CGROUP_READ_SIZE 8192
+/* only the aggregate "cpu " line of /proc/stat is read */
+#define PROC_STAT_LINE_SIZE 512
+
+typedef struct {
+    char id[MAX_CONTAINER_ID];
+    int cpu_fd;
+    int memory_fd;
+    int memory_limit_fd;
+    int memory_stat_fd;
+    int io_fd;
+    int net_fd;
+    int retained;
+} cgroup_entry_t;
+
+static struct {
+    char cgroup_root[256];
+    char proc_root[256];
+    int version;
+    int stat_fd;
+    long clock_ticks;
+    uint32_t online_cpus;
+    uint64_t memory_total;
+    cgroup_entry_t **entries;
+    int count;
+    int capacity;
+    pthread_mutex_t lock;
+    int initialized;
+} backend = { .lock = PTHREAD_MUTEX_INITIALIZER, .stat_fd = -1 };
+
+static const char *v2_layouts[] = {
+    "%s/system.slice/docker-%s.scope",
+    "%s/docker/%s",
+    NULL
+};
+
+static const char *v1_layouts[] = {
+    "%s/%s/docker/%s",
+    "%s/%s/system.slice/docker-%s.scope",
+    NULL
+};
+
+static cgroup_entry_t *lookup_entry(const char *container_id);
+static cgroup_entry_t *open_entry(const char *container_id);
+static void close_entry(cgroup_entry_t *entry);
+static int open_v1_file(const char *controller, const char *container_id, const char *file);
+static int open_cgroup_file(const char *dir, const char *file);
+static int open_net_dev(const char *procs_path);
+static ssize_t read_fd(int fd, char *buffer, size_t size);
+static uint64_t read_u64_fd(int fd, int *ok);
+static uint64_t parse_key_value(const char *text, const char *key);
+static void parse_io_stat(const char *text, uint64_t *read_bytes, uint64_t *write_bytes);
+static void parse_blkio(const char *text, uint64_t *read_bytes, uint64_t *write_bytes);
+static void parse_net_dev(const char *text, uint64_t *rx_bytes, uint64_t *tx_bytes);
+static uint64_t read_system_cpu_usage(uint32_t *online_cpus);
+
+int cgroup_stats_init(const char *cgroup_root, const char *proc_root) {
+    char path[512];
+    char buffer[CGROUP_READ_SIZE];
+    struct stat st;
+    
+    cgroup_stats_cleanup();
+    
+    snprintf(backend.cgroup_root, sizeof(backend.cgroup_root), "%s", cgroup_root ? cgroup_root : CGROUP_ROOT);
+    snprintf(backend.proc_root, sizeof(backend.proc_root), "%s", proc_root ? proc_root : PROC_ROOT);
+    
+    snprintf(path, sizeof(path), "%s/cgroup.controllers", backend.cgroup_root);
+    if (stat(path, &st) == 0) {
+        backend.version = 2;
+    } else {
+        snprintf(path, sizeof(path), "%s/memory", backend.cgroup_root);
+        if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            return -1;
+        }
+        backend.version = 1;
+    }
+    
+    snprintf(path, sizeof(path), "%s/stat", backend.proc_root);
+    backend.stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (backend.stat_fd == -1) {
+        return -1;
+    }
+    
+    backend.clock_ticks = sysconf(_SC_CLK_TCK);
+    if (backend.clock_ticks <= 0) {
+        backend.clock_ticks = 100;
+    }
+    
+    /* counting "cpuN" lines would need all of /proc/stat, which outgrows any
+       fixed buffer on hosts with a few hundred CPUs */
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    backend.online_cpus = cpus > 0 ? (uint32_t)cpus : 1;
+    
+    snprintf(path, sizeof(path), "%s/meminfo", backend.proc_root);
+    int meminfo_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (meminfo_fd != -1) {
+        if (read_fd(meminfo_fd, buffer, sizeof(buffer)) > 0) {
+            backend.memory_total = parse_key_value(buffer, "MemTotal:") * 1024;
+        }
+        close(meminfo_fd);
+    }
+    
+    backend.initialized = 1;
+    return 0;
+}
+
+void cgroup_stats_cleanup(void) {
+    pthread_mutex_lock(&backend.lock);
+    for (int i = 0; i < backend.count; i++) {
+        close_entry(backend.entries[i]);
+    }
+    free(backend.entries);
+    backend.entries = NULL;
+    backend.count = 0;
+    backend.capacity = 0;
+    
+    if (backend.stat_fd != -1) {
+        close(backend.stat_fd);
+        backend.stat_fd = -1;
+    }
+    backend.initialized = 0;
+    pthread_mutex_unlock(&backend.lock);
+}
+
+void cgroup_stats_retain(const container_info_t *containers, int count) {
+    pthread_mutex_lock(&backend.lock);
+    for (int i = 0; i < backend.count; i++) {
+        backend.entries[i]->retained = 0;
+        for (int j = 0; j < count; j++) {
+            if (strcmp(backend.entries[i]->id, containers[j].id) == 0) {
+                backend.entries[i]->retained = 1;
+                break;
+            }
+        }
+    }
+    
+    /* open fds pin the cgroup in the kernel, so drop them as soon as the container is gone */
+    for (int i = backend.count - 1; i >= 0; i--) {
+        if (!backend.entries[i]->retained) {
+            close_entry(backend.entries[i]);
+            backend.entries[i] = backend.entries[--backend.count];
+        }
+    }
+    pthread_mutex_unlock(&backend.lock);
+}
+
+void cgroup_stats_forget(const char *container_id) {
+    pthread_mutex_lock(&backend.lock);
+    for (int i = 0; i < backend.count; i++) {
+        if (strcmp(backend.entries[i]->id, container_id) == 0) {
+            close_entry(backend.entries[i]);
+            backend.entries[i] = backend.entries[--backend.count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&backend.lock);
+}
+
+int cgroup_get_container_stats(const char *container_id, container_stats_t *stats) {
+    char buffer[CGROUP_READ_SIZE];
+    cgroup_entry_t *entry;
+    int ok = 1;
+    
+    if (!backend.initialized || !container_id || !stats) {
+        return -1;
+    }
+    
+    entry = lookup_entry(container_id);
+    if (!entry) {
+        return -1;
+    }
+    
+    memset(stats, 0, sizeof(container_stats_t));
+    stats->timestamp = time(NULL);
+    stats->sample_ns = monotonic_ns();
+    
+    if (backend.version == 2) {
+        if (read_fd(entry->cpu_fd, buffer, sizeof(buffer)) > 0) {
+            stats->cpu_usage = parse_key_value(buffer, "usage_usec") * 1000;
+        } else {
+            ok = 0;
+        }
+    } else {
+        stats->cpu_usage = read_u64_fd(entry->cpu_fd, &ok);
+    }
+    
+    stats->memory_usage = read_u64_fd(entry->memory_fd, &ok);
+    stats->memory_limit = read_u64_fd(entry->memory_limit_fd, &ok);
+    if (stats->memory_limit == 0 || (backend.memory_total && stats->memory_limit > backend.memory_total)) {
+        stats->memory_limit = backend.memory_total;
+    }
+    
+    if (entry->memory_stat_fd != -1 && read_fd(entry->memory_stat_fd, buffer, sizeof(buffer)) > 0) {
+        stats->memory_inactive_file = parse_key_value(buffer, backend.version == 2 ? "inactive_file" : "total_inactive_file");
+    }
+    
+    if (entry->io_fd != -1 && read_fd(entry->io_fd, buffer, sizeof(buffer)) >= 0) {
+        if (backend.version == 2) {
+            parse_io_stat(buffer, &stats->block_read_bytes, &stats->block_write_bytes);
+        } else {
+            parse_blkio(buffer, &stats->block_read_bytes, &stats->block_write_bytes);
+        }
+    }
+    
+    if (entry->net_fd != -1 && read_fd(entry->net_fd, buffer, sizeof(buffer)) > 0) {
+        parse_net_dev(buffer, &stats->network_rx_bytes, &stats->network_tx_bytes);
+    }
+    
+    stats->cpu_system_usage = read_system_cpu_usage(&stats->online_cpus);
+    
+    if (!ok) {
+        /* the cgroup went away (container stopped or restarted); reopen on next call */
+        pthread_mutex_lock(&backend.lock);
+        for (int i = 0; i < backend.count; i++) {
+            if (backend.entries[i] == entry) {
+                close_entry(entry);
+                backend.entries[i] = backend.entries[--backend.count];
+                break;
+            }
+        }
+        pthread_mutex_unlock(&backend.lock);
+        return -1;
+    }
+    
+    return 0;
+}
+
+static cgroup_entry_t *lookup_entry(const char *container_id) {
+    cgroup_entry_t *entry = NULL;
+    
+    pthread_mutex_lock(&backend.lock);
+    for (int i = 0; i < backend.count; i++) {
+        if (strcmp(backend.entries[i]->id, container_id) == 0) {
+            entry = backend.entries[i];
+            break;
+        }
+    }
+    
+    if (!entry && backend.count == backend.capacity) {
+        int new_capacity = backend.capacity ? backend.capacity * 2 : 64;
+        cgroup_entry_t **new_entries = realloc(backend.entries, new_capacity * sizeof(cgroup_entry_t *));
+        if (!new_entries) {
+            pthread_mutex_unlock(&backend.lock);
+            return NULL;
+        }
+        backend.entries = new_entries;
+        backend.capacity = new_capacity;
+    }
+    
+    if (!entry) {
+        entry = open_entry(container_id);
+        if (entry) {
+            backend.entries[backend.count++] = entry;
+        }
+    }
+    pthread_mutex_unlock(&backend.lock);
+    
+    return entry;
+}
+
+static cgroup_entry_t *open_entry(const char *container_id) {
+    char path[512];
+    cgroup_entry_t *entry = calloc(1, sizeof(cgroup_entry_t));
+    
+    if (!entry) {
+        return NULL;
+    }
+    
+    snprintf(entry->id, sizeof(entry->id), "%s", container_id);
+    entry->cpu_fd = entry->memory_fd = entry->memory_limit_fd = entry->memory_stat_fd = entry->io_fd = entry->net_fd = -1;
+    
+    if (backend.version == 2) {
+        for (int i = 0; v2_layouts[i]; i++) {
+            struct stat st;
+            snprintf(path, sizeof(path), v2_layouts[i], backend.cgroup_root, container_id);
+            if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+                entry->cpu_fd = open_cgroup_file(path, "cpu.stat");
+                entry->memory_fd = open_cgroup_file(path, "memory.current");
+                entry->memory_limit_fd = open_cgroup_file(path, "memory.max");
+                entry->memory_stat_fd = open_cgroup_file(path, "memory.stat");
+                entry->io_fd = open_cgroup_file(path, "io.stat");
+                strncat(path, "/cgroup.procs", sizeof(path) - strlen(path) - 1);
+                entry->net_fd = open_net_dev(path);
+                break;
+            }
+        }
+    } else {
+        entry->cpu_fd = open_v1_file("cpuacct", container_id, "cpuacct.usage");
+        if (entry->cpu_fd == -1) {
+            entry->cpu_fd = open_v1_file("cpu,cpuacct", container_id, "cpuacct.usage");
+        }
+        entry->memory_fd = open_v1_file("memory", container_id, "memory.usage_in_bytes");
+        entry->memory_limit_fd = open_v1_file("memory", container_id, "memory.limit_in_bytes");
+        entry->memory_stat_fd = open_v1_file("memory", container_id, "memory.stat");
+        entry->io_fd = open_v1_file("blkio", container_id, "blkio.throttle.io_service_bytes");
+        
+        for (int i = 0; v1_layouts[i] && entry->net_fd == -1; i++) {
+            snprintf(path, sizeof(path), v1_layouts[i], backend.cgroup_root, "memory", container_id);
+            strncat(path, "/cgroup.procs", sizeof(path) - strlen(path) - 1);
+            entry->net_fd = open_net_dev(path);
+        }
+    }
+    
+    if (entry->cpu_fd == -1 || entry->memory_fd == -1 || entry->memory_limit_fd == -1) {
+        close_entry(entry);
+        return NULL;
+    }
+    
+    return entry;
+}
+
+static void close_entry(cgroup_entry_t *entry) {
+    int fds[] = { entry->cpu_fd, entry->memory_fd, entry->memory_limit_fd, entry->memory_stat_fd, entry->io_fd, entry->net_fd };
+    
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (fds[i] != -1) {
+            close(fds[i]);
+        }
+    }
+    free(entry);
+}
+
+static int open_v1_file(const char *controller, const char *container_id, const char *file) {
+    char path[512];
+    
+    for (int i = 0; v1_layouts[i]; i++) {
+        snprintf(path, sizeof(path), v1_layouts[i], backend.cgroup_root, controller, container_id);
+        int fd = open_cgroup_file(path, file);
+        if (fd != -1) {
+            return fd;
+        }
+    }
+    
+    return -1;
+}
+
+static int open_cgroup_file(const char *dir, const char *file) {
+    char path[640];
+    
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static int open_net_dev(const char *procs_path) {
+    char buffer[64];
+    char path[512];
+    int fd = open(procs_path, O_RDONLY | O_CLOEXEC);
+    long pid;
+    
+    if (fd == -1) {
+        return -1;
+    }
+    
+    pid = read_fd(fd, buffer, sizeof(buffer)) > 0 ? strtol(buffer, NULL, 10) : 0;
+    close(fd);
+    if (pid <= 0) {
+        return -1;
+    }
+    
+    snprintf(path, sizeof(path), "%s/%ld/net/dev", backend.proc_root, pid);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static ssize_t read_fd(int fd, char *buffer, size_t size) {
+    ssize_t n = pread(fd, buffer, size - 1, 0);
+    
+    buffer[n > 0 ? n : 0] = '\0';
+    return n;
+}
+
+static uint64_t read_u64_fd(int fd, int *ok) {
+    char buffer[64];
+    
+    if (read_fd(fd, buffer, sizeof(buffer)) <= 0) {
+        *ok = 0;
+        return 0;
+    }
+    
+    /* "max" in memory.max means no limit */
+    return strtoull(buffer, NULL, 10);
+}
+
+static uint64_t parse_key_value(const char *text, const char *key) {
+    size_t key_len = strlen(key);
+    const char *line = text;
+    
+    while (line && *line) {
+        if (strncmp(line, key, key_len) == 0 && (line[key_len] == ' ' || line[key_len] == '\t' || key[key_len - 1] == ':')) {
+            return strtoull(line + key_len, NULL, 10);
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    
+    return 0;
+}
+
+static void parse_io_stat(const char *text, uint64_t *read_bytes, uint64_t *write_bytes) {
+    const char *p;
+    
+    for (p = text; (p = strstr(p, "rbytes=")); p += 7) {
+        *read_bytes += strtoull(p + 7, NULL, 10);
+    }
+    for (p = text; (p = strstr(p, "wbytes=")); p += 7) {
+        *write_bytes += strtoull(p + 7, NULL, 10);
+    }
+}
+
+static void parse_blkio(const char *text, uint64_t *read_bytes, uint64_t *write_bytes) {
+    const char *line = text;
+    
+    while (line && *line) {
+        unsigned major, minor;
+        char op[16];
+        unsigned long long value;
+        
+        if (sscanf(line, "%u:%u %15s %llu", &major, &minor, op, &value) == 4) {
+            if (strcmp(op, "Read") == 0) {
+                *read_bytes += value;
+            } else if (strcmp(op, "Write") == 0) {
+                *write_bytes += value;
+            }
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+}
+
+static void parse_net_dev(const char *text, uint64_t *rx_bytes, uint64_t *tx_bytes) {
+    const char *line = text;
+    
+    while (line && *line) {
+        const char *colon = strchr(line, ':');
+        const char *eol = strchr(line, '\n');
+        
+        if (colon && (!eol || colon < eol)) {
+            const char *name = line;
+            unsigned long long fields[9];
+            
+            while (*name == ' ') name++;
+            if (strncmp(name, "lo:", 3) != 0 &&
+                sscanf(colon + 1, "%llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                       &fields[0], &fields[1], &fields[2], &fields[3], &fields[4],
+                       &fields[5], &fields[6], &fields[7], &fields[8]) == 9) {
+                *rx_bytes += fields[0];
+                *tx_bytes += fields[8];
+            }
+        }
+        
+        line = eol ? eol + 1 : NULL;
+    }
+}
+
+static uint64_t read_system_cpu_usage(uint32_t *online_cpus) {
+    char buffer[PROC_STAT_LINE_SIZE];
+    unsigned long long fields[8] = {0};
+    uint64_t total = 0;
+    
+    if (read_fd(backend.stat_fd, buffer, sizeof(buffer)) <= 0 || strncmp(buffer, "cpu ", 4) != 0) {
+        return 0;
+    }
+    
+    *online_cpus = backend.online_cpus;
+    
+    /* same accounting as dockerd: user..steal jiffies converted to nanoseconds */
+    sscanf(buffer + 4, "%llu %llu %llu %llu %llu %llu %llu %llu",
+           &fields[0], &fields[1], &fields[2], &fields[3],
+           &fields[4], &fields[5], &fields[6], &fields[7]);
+    for (int i = 0; i < 8; i++) {
+        total += fields[i];
+    }
+    
+    return total * (1000000000ULL / backend.clock_ticks);
+}
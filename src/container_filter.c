@@ -0,0 +1,307 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <fnmatch.h>
+#include "../include/container_filter.h"
+
+static int has_wildcard(const char *pattern);
+static int selector_matches(const container_selector_t *selector, const container_info_t *info);
+static int image_matches(const char *pattern, const char *image);
+static const char *image_tag(const char *image);
+static int pushable(const container_selector_t *selector, int events);
+static void push_value(const container_selector_t *selector, text_buffer_t *out);
+static void glob_to_regex(const char *glob, char *regex, size_t size);
+static const char *class_end(const char *bracket);
+static void append_json_string(text_buffer_t *out, const char *value);
+
+static const char *kind_names[] = { "name", "id", "label", "image" };
+
+/* the daemon's filter keys per kind; NULL where it has none that fits */
+static const char *list_keys[] = { "name", "id", "label", "ancestor" };
+static const char *event_keys[] = { NULL, NULL, "label", "image" };
+
+int container_filter_add(container_filter_t *filter, const char *spec) {
+    const char *equals = strchr(spec, '=');
+    container_selector_t selector;
+    size_t kind_len;
+    int kind = -1;
+    
+    if (!equals || filter->count >= MAX_SELECTORS) {
+        return -1;
+    }
+    
+    kind_len = equals - spec;
+    for (int i = 0; i < (int)(sizeof(kind_names) / sizeof(kind_names[0])); i++) {
+        if (strlen(kind_names[i]) == kind_len && strncmp(spec, kind_names[i], kind_len) == 0) {
+            kind = i;
+        }
+    }
+    if (kind < 0 || !equals[1] || strlen(equals + 1) >= sizeof(selector.pattern)) {
+        return -1;
+    }
+    
+    memset(&selector, 0, sizeof(selector));
+    selector.kind = kind;
+    strcpy(selector.pattern, equals + 1);
+    
+    if (kind == SELECT_LABEL) {
+        char *value = strchr(selector.pattern, '=');
+        if (value) {
+            *value = '\0';
+            strcpy(selector.value, value + 1);
+            selector.has_value = 1;
+        }
+        /* label keys reach container_filter_label through the scanner's
+           key buffer; a longer key could never be compared in full */
+        if (!selector.pattern[0] || strlen(selector.pattern) > CONTAINER_FILTER_MAX_LABEL_KEY) {
+            return -1;
+        }
+    }
+    
+    filter->selectors[filter->count++] = selector;
+    return 0;
+}
+
+int container_filter_append_json(const container_filter_t *filter, int events, text_buffer_t *out) {
+    const char **keys = events ? event_keys : list_keys;
+    int members = 0;
+    
+    for (selector_kind_t kind = SELECT_NAME; kind <= SELECT_IMAGE; kind++) {
+        int values = 0;
+        int all = 1;
+        
+        if (!keys[kind]) {
+            continue;
+        }
+        
+        /* selectors of one kind are alternatives, so one the daemon cannot
+           check means it must return every container for that kind. Labels
+           are all required and each can be pushed down on its own */
+        for (int i = 0; i < filter->count; i++) {
+            if (filter->selectors[i].kind == kind && !pushable(&filter->selectors[i], events)) {
+                all = 0;
+            }
+        }
+        if (!all && kind != SELECT_LABEL) {
+            continue;
+        }
+        
+        for (int i = 0; i < filter->count; i++) {
+            const container_selector_t *selector = &filter->selectors[i];
+            if (selector->kind != kind || !pushable(selector, events)) {
+                continue;
+            }
+            
+            if (values == 0) {
+                text_buffer_printf(out, "%s\"%s\":[", members > 0 ? "," : "", keys[kind]);
+            } else {
+                text_buffer_append_str(out, ",");
+            }
+            push_value(selector, out);
+            values++;
+        }
+        
+        if (values > 0) {
+            text_buffer_append_str(out, "]");
+            members++;
+        }
+    }
+    
+    return members;
+}
+
+uint32_t container_filter_label(const container_filter_t *filter, const char *key, const char *value) {
+    uint32_t matches = 0;
+    
+    for (int i = 0; i < filter->count; i++) {
+        const container_selector_t *selector = &filter->selectors[i];
+        
+        if (selector->kind == SELECT_LABEL && fnmatch(selector->pattern, key, 0) == 0 &&
+            (!selector->has_value || fnmatch(selector->value, value, 0) == 0)) {
+            matches |= 1u << i;
+        }
+    }
+    
+    return matches;
+}
+
+int container_filter_match(const container_filter_t *filter, const container_info_t *info, uint32_t labels) {
+    unsigned present = 0;
+    unsigned matched = 0;
+    
+    for (int i = 0; i < filter->count; i++) {
+        const container_selector_t *selector = &filter->selectors[i];
+        unsigned kind = 1u << selector->kind;
+        
+        if (selector->kind == SELECT_LABEL) {
+            if (!(labels & (1u << i))) {
+                return 0;
+            }
+            continue;
+        }
+        
+        present |= kind;
+        if (!(matched & kind) && selector_matches(selector, info)) {
+            matched |= kind;
+        }
+    }
+    
+    return matched == present;
+}
+
+static int has_wildcard(const char *pattern) {
+    return strpbrk(pattern, "*?[\\") != NULL;
+}
+
+static int selector_matches(const container_selector_t *selector, const container_info_t *info) {
+    switch (selector->kind) {
+    case SELECT_NAME:
+        return fnmatch(selector->pattern, info->name, 0) == 0;
+    case SELECT_ID:
+        if (!has_wildcard(selector->pattern)) {
+            return strncmp(info->id, selector->pattern, strlen(selector->pattern)) == 0;
+        }
+        return fnmatch(selector->pattern, info->id, 0) == 0;
+    case SELECT_IMAGE:
+        return image_matches(selector->pattern, info->image);
+    default:
+        return 0;
+    }
+}
+
+static int image_matches(const char *pattern, const char *image) {
+    char repository[MAX_CONTAINER_NAME];
+    
+    if (fnmatch(pattern, image, 0) == 0) {
+        return 1;
+    }
+    const char *tag = image_tag(image);
+    if (image_tag(pattern) || !tag) {
+        return 0;
+    }
+    
+    snprintf(repository, sizeof(repository), "%.*s", (int)(tag - image), image);
+    return fnmatch(pattern, repository, 0) == 0;
+}
+
+/* a colon after the last slash starts the tag, before it is a registry port */
+static const char *image_tag(const char *image) {
+    const char *slash = strrchr(image, '/');
+    const char *colon = strrchr(image, ':');
+    const char *digest = strchr(image, '@');
+    
+    if (digest) {
+        return digest;
+    }
+    return colon && (!slash || colon > slash) ? colon : NULL;
+}
+
+/* names become an anchored regular expression, an id glob its literal
+   prefix; labels and images are compared exactly by the daemon, and an
+   image without a tag would mean :latest there */
+static int pushable(const container_selector_t *selector, int events) {
+    switch (selector->kind) {
+    case SELECT_NAME:
+        return !events;
+    case SELECT_ID:
+        return !events && strcspn(selector->pattern, "*?[\\") > 0;
+    case SELECT_LABEL:
+        return !has_wildcard(selector->pattern);
+    case SELECT_IMAGE:
+        return !has_wildcard(selector->pattern) && image_tag(selector->pattern);
+    default:
+        return 0;
+    }
+}
+
+static void push_value(const container_selector_t *selector, text_buffer_t *out) {
+    char value[2 * MAX_CONTAINER_NAME + 8];
+    
+    switch (selector->kind) {
+    case SELECT_NAME:
+        glob_to_regex(selector->pattern, value, sizeof(value));
+        break;
+    case SELECT_ID:
+        snprintf(value, sizeof(value), "%.*s", (int)strcspn(selector->pattern, "*?[\\"), selector->pattern);
+        break;
+    case SELECT_LABEL:
+        /* a value glob still narrows the list down to containers with the key */
+        if (selector->has_value && !has_wildcard(selector->value)) {
+            snprintf(value, sizeof(value), "%s=%s", selector->pattern, selector->value);
+        } else {
+            snprintf(value, sizeof(value), "%s", selector->pattern);
+        }
+        break;
+    default:
+        snprintf(value, sizeof(value), "%s", selector->pattern);
+        break;
+    }
+    
+    append_json_string(out, value);
+}
+
+/* the daemon matches name filters against "/<name>" */
+static void glob_to_regex(const char *glob, char *regex, size_t size) {
+    size_t len = 0;
+    
+    len += snprintf(regex, size, "^/");
+    for (const char *p = glob; *p && len + 4 < size; p++) {
+        if (*p == '*') {
+            regex[len++] = '.';
+            regex[len++] = '*';
+        } else if (*p == '?') {
+            regex[len++] = '.';
+        } else if (*p == '[' && class_end(p)) {
+            const char *end = class_end(p);
+            regex[len++] = '[';
+            if (*++p == '!') {
+                regex[len++] = '^';
+                p++;
+            }
+            for (; p < end && len + 4 < size; p++) {
+                if (*p == '\\' || *p == ']') {
+                    regex[len++] = '\\';
+                }
+                regex[len++] = *p;
+            }
+            regex[len++] = ']';
+            p = end;
+        } else {
+            if (*p == '\\' && p[1]) {
+                p++;
+            }
+            if (strchr(".^$+(){}|[]\\", *p)) {
+                regex[len++] = '\\';
+            }
+            regex[len++] = *p;
+        }
+    }
+    regex[len++] = '$';
+    regex[len] = '\0';
+}
+
+/* a ] right after [ or [! belongs to the set */
+static const char *class_end(const char *bracket) {
+    const char *p = bracket + 1;
+    
+    if (*p == '!') {
+        p++;
+    }
+    if (*p == ']') {
+        p++;
+    }
+    return strchr(p, ']');
+}
+
+static void append_json_string(text_buffer_t *out, const char *value) {
+    text_buffer_append_str(out, "\"");
+    for (const char *p = value; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            text_buffer_append(out, "\\", 1);
+        }
+        if ((unsigned char)*p >= 0x20) {
+            text_buffer_append(out, p, 1);
+        }
+    }
+    text_buffer_append_str(out, "\"");
+}
@@ -1,33 +1,129 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include "../include/docker_monitor.h"
 #include "../include/docker_api.h"
+#include "../include/docker_events.h"
+#include "../include/timeseries.h"
+#include "../include/poll_scheduler.h"
+#include "../include/top_k.h"
 
-void init_monitor_state(monitor_state_t *state, int interval) {
+#define HISTORY_WINDOW (15 * 60)
+
+/* with fewer pooled connections than workers the extra workers would only
+   wait for a free connection */
+_Static_assert(HTTP_POOL_SIZE >= MAX_CONCURRENCY, "HTTP_POOL_SIZE must cover MAX_CONCURRENCY workers");
+
+typedef void (*worker_task_fn)(monitor_state_t *state, int index);
+
+/* one pool serves every host: a batch is a task run for indexes 0..total-1,
+   container slots when collecting stats and hosts when fetching lists */
+struct stats_worker_pool {
+    pthread_t threads[MAX_CONCURRENCY];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    monitor_state_t *state;
+    worker_task_fn task;
+    int next_index;
+    int total;
+    int active;
+    unsigned generation;
+    int shutdown;
+};
+
+static void run_tasks(monitor_state_t *state, worker_task_fn task, int total);
+static void fetch_host_list(monitor_state_t *state, int host);
+static void apply_host_list(monitor_state_t *state, int host, const container_list_t *list);
+static void collect_container_stats(monitor_state_t *state, int slot);
+static void collect_scheduled_stats(monitor_state_t *state, int index);
+static double counter_rate(uint64_t current, uint64_t previous, double seconds);
+static void record_history(container_monitor_t *container);
+static void *stats_worker(void *arg);
+static struct stats_worker_pool *start_workers(int count);
+static void stop_workers(struct stats_worker_pool *pool);
+static void print_top(const monitor_state_t *state, top_k_t *top);
+
+void init_monitor_state(monitor_state_t *state, int interval, int concurrency) {
     state->interval = interval;
     state->running = 1;
     state->last_update = time(NULL);
+    
+    if (concurrency < 1) concurrency = 1;
+    if (concurrency > MAX_CONCURRENCY) concurrency = MAX_CONCURRENCY;
+    state->concurrency = concurrency;
+    state->workers = concurrency > 1 ? start_workers(concurrency) : NULL;
+    arena_init(&state->scratch);
 }
 
 void cleanup_monitor_state(monitor_state_t *state) {
     state->running = 0;
+    
+    if (state->workers) {
+        stop_workers(state->workers);
+        state->workers = NULL;
+    }
+    
+    monitor_table_free(state);
+    poll_scheduler_destroy(state->scheduler);
+    state->scheduler = NULL;
+    
+    for (int i = 0; i < state->host_count; i++) {
+        docker_events_destroy(state->hosts[i].events);
+        docker_client_destroy(state->hosts[i].client);
+        container_list_free(&state->hosts[i].pending);
+    }
+    free(state->hosts);
+    state->hosts = NULL;
+    state->host_count = 0;
+    arena_free(&state->scratch);
 }
 
-int get_container_list(monitor_state_t *state) {
-    container_info_t temp_containers[MAX_CONTAINERS];
-    int count = docker_get_containers(temp_containers, MAX_CONTAINERS);
+int refresh_container_list(monitor_state_t *state) {
+    int resync = 0;
+    int reachable = 0;
     
-    if (count < 0) {
-        return -1;
+    for (int i = 0; i < state->host_count; i++) {
+        monitor_host_t *host = &state->hosts[i];
+        
+        host->resync = !host->events || docker_events_poll(host->events, state) < 0;
+        /* subscribe before the full resync so no change between the two is lost */
+        if (host->resync && host->events) {
+            docker_events_connect(host->events);
+        } else if (host->events && docker_events_want_resync(host->events)) {
+            host->resync = 1;
+        }
+        resync += host->resync;
     }
     
-    state->container_count = count;
-    memcpy(state->containers, temp_containers, count * sizeof(container_info_t));
-    state->last_update = time(NULL);
+    /* lists of all hosts are fetched concurrently, the table is only changed here */
+    if (resync > 0) {
+        run_tasks(state, fetch_host_list, state->host_count);
+    }
     
-    return 0;
+    for (int i = 0; i < state->host_count; i++) {
+        monitor_host_t *host = &state->hosts[i];
+        
+        if (host->resync) {
+            host->reachable = host->list_result >= 0;
+            if (host->reachable) {
+                apply_host_list(state, i, &host->pending);
+            }
+        } else {
+            host->reachable = 1;
+        }
+        reachable += host->reachable;
+    }
+    
+    if (resync > 0 && reachable > 0) {
+        state->last_update = time(NULL);
+    }
+    
+    return reachable > 0 ? 0 : -1;
 }
 
 int get_container_stats(monitor_state_t *state) {
@@ -35,55 +131,327 @@ int get_container_stats(monitor_state_t *state) {
         return -1;
     }
     
-    for (int i = 0; i < state->container_count; i++) {
-        container_stats_t stats;
-        if (docker_get_container_stats(state->containers[i].info.id, &stats) == 0) {
-            state->containers[i].stats = stats;
-            
-            if (stats.memory_limit > 0) {
-                state->containers[i].memory_percent = (double)stats.memory_usage / stats.memory_limit * 100.0;
-            } else {
-                state->containers[i].memory_percent = 0.0;
+    /* without a scheduler every container is polled on every tick */
+    if (!state->scheduler) {
+        run_tasks(state, collect_container_stats, state->container_slots);
+        return 0;
+    }
+    
+    run_tasks(state, collect_scheduled_stats, poll_scheduler_begin(state->scheduler, state));
+    poll_scheduler_end(state->scheduler, state);
+    return 0;
+}
+
+void monitor_summarize(const monitor_state_t *state, int host, monitor_summary_t *summary, top_k_t *top) {
+    memset(summary, 0, sizeof(monitor_summary_t));
+    
+    for (int i = 0; i < state->container_slots; i++) {
+        const container_monitor_t *container = &state->containers[i];
+        if (!container->in_use || (host >= 0 && container->info.host != host)) continue;
+        
+        summary->containers++;
+        if (container->is_running) {
+            summary->running++;
+            summary->cpu_percent += container->cpu_percent;
+            summary->memory += container->memory_working_set;
+            summary->memory_limit += container->stats.memory_limit;
+            if (top) {
+                top_k_add(top, container, i);
             }
+        }
+    }
+}
+
+void update_container_stats(container_monitor_t *container, const container_stats_t *stats) {
+    const container_stats_t *prev = &container->stats;
+    uint64_t cpu_prev = stats->precpu_usage;
+    uint64_t system_prev = stats->precpu_system_usage;
+    double seconds = 0.0;
+    
+    /* prefer our own previous sample: precpu_stats is only meaningful on a
+       stream, a one-shot request reports it as zero or as its own sample */
+    if (prev->sample_ns > 0 && stats->sample_ns > prev->sample_ns) {
+        cpu_prev = prev->cpu_usage;
+        system_prev = prev->cpu_system_usage;
+        seconds = (stats->sample_ns - prev->sample_ns) / 1e9;
+    }
+    
+    uint32_t online_cpus = stats->online_cpus > 0 ? stats->online_cpus : 1;
+    if (stats->cpu_usage > cpu_prev && stats->cpu_system_usage > system_prev && cpu_prev > 0) {
+        container->cpu_percent = (double)(stats->cpu_usage - cpu_prev) /
+                                 (stats->cpu_system_usage - system_prev) * online_cpus * 100.0;
+    } else {
+        container->cpu_percent = 0.0;
+    }
+    
+    if (seconds > 0.0) {
+        container->network_rx_rate = counter_rate(stats->network_rx_bytes, prev->network_rx_bytes, seconds);
+        container->network_tx_rate = counter_rate(stats->network_tx_bytes, prev->network_tx_bytes, seconds);
+        container->block_read_rate = counter_rate(stats->block_read_bytes, prev->block_read_bytes, seconds);
+        container->block_write_rate = counter_rate(stats->block_write_bytes, prev->block_write_bytes, seconds);
+    } else {
+        container->network_rx_rate = 0.0;
+        container->network_tx_rate = 0.0;
+        container->block_read_rate = 0.0;
+        container->block_write_rate = 0.0;
+    }
+    
+    /* working set as docker stats shows it: page cache that can be reclaimed is not counted */
+    container->memory_working_set = stats->memory_usage;
+    if (stats->memory_inactive_file < stats->memory_usage) {
+        container->memory_working_set -= stats->memory_inactive_file;
+    }
+    
+    if (stats->memory_limit > 0) {
+        container->memory_percent = (double)container->memory_working_set / stats->memory_limit * 100.0;
+    } else {
+        container->memory_percent = 0.0;
+    }
+    
+    container->stats = *stats;
+    container->is_running = 1;
+    
+    record_history(container);
+}
+
+static void record_history(container_monitor_t *container) {
+    float values[TS_METRIC_COUNT];
+    
+    if (!container->history) {
+        container->history = timeseries_create();
+        if (!container->history) {
+            return;
+        }
+    }
+    
+    values[TS_CPU_PERCENT] = container->cpu_percent;
+    values[TS_MEMORY_WORKING_SET] = container->memory_working_set;
+    values[TS_MEMORY_PERCENT] = container->memory_percent;
+    values[TS_NETWORK_RX_RATE] = container->network_rx_rate;
+    values[TS_NETWORK_TX_RATE] = container->network_tx_rate;
+    values[TS_BLOCK_READ_RATE] = container->block_read_rate;
+    values[TS_BLOCK_WRITE_RATE] = container->block_write_rate;
+    timeseries_append(container->history, container->stats.timestamp, values);
+}
+
+static double counter_rate(uint64_t current, uint64_t previous, double seconds) {
+    /* a counter going backwards means the container was restarted */
+    if (current < previous) {
+        return 0.0;
+    }
+    return (current - previous) / seconds;
+}
+
+static void run_tasks(monitor_state_t *state, worker_task_fn task, int total) {
+    struct stats_worker_pool *pool = state->workers;
+    
+    if (!pool) {
+        for (int i = 0; i < total; i++) {
+            task(state, i);
+        }
+        return;
+    }
+    
+    /* each worker claims distinct indexes, so results need no further merging */
+    pthread_mutex_lock(&pool->lock);
+    pool->state = state;
+    pool->task = task;
+    pool->next_index = 0;
+    pool->total = total;
+    pool->active = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    
+    while (pool->active > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pool->state = NULL;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void fetch_host_list(monitor_state_t *state, int host) {
+    monitor_host_t *entry = &state->hosts[host];
+    
+    if (!entry->resync) {
+        return;
+    }
+    
+    entry->pending.count = 0;
+    entry->list_result = entry->client ? docker_get_containers(entry->client, &entry->pending) : -1;
+}
+
+static void apply_host_list(monitor_state_t *state, int host, const container_list_t *list) {
+    /* slots of containers that are still present keep their previous sample */
+    char *seen = arena_calloc(&state->scratch, state->container_slots + list->count + 1, 1);
+    if (!seen) {
+        return;
+    }
+    
+    for (int i = 0; i < list->count; i++) {
+        container_info_t info = list->items[i];
+        info.host = host;
+        
+        container_monitor_t *container = monitor_add_container(state, &info);
+        if (container) {
+            seen[container - state->containers] = 1;
+        }
+    }
+    
+    for (int slot = 0; slot < state->container_slots; slot++) {
+        container_monitor_t *container = &state->containers[slot];
+        if (container->in_use && container->info.host == host && !seen[slot]) {
+            monitor_remove_container(state, host, container->info.id);
+        }
+    }
+}
+
+static void collect_container_stats(monitor_state_t *state, int slot) {
+    container_monitor_t *container = &state->containers[slot];
+    
+    if (!container->in_use) {
+        return;
+    }
+    
+    docker_client_t *client = state->hosts[container->info.host].client;
+    container_stats_t stats;
+    
+    if (client && docker_get_container_stats(client, container->info.id, &stats) == 0) {
+        update_container_stats(container, &stats);
+    } else {
+        container->is_running = 0;
+    }
+}
+
+static void collect_scheduled_stats(monitor_state_t *state, int index) {
+    collect_container_stats(state, poll_scheduler_slot(state->scheduler, index));
+}
+
+static void *stats_worker(void *arg) {
+    struct stats_worker_pool *pool = arg;
+    unsigned seen = 0;
+    
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == seen) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        seen = pool->generation;
+        
+        while (pool->next_index < pool->total) {
+            int index = pool->next_index++;
             
-            state->containers[i].is_running = 1;
-        } else {
-            state->containers[i].is_running = 0;
+            pthread_mutex_unlock(&pool->lock);
+            pool->task(pool->state, index);
+            pthread_mutex_lock(&pool->lock);
+        }
+        
+        if (--pool->active == 0) {
+            pthread_cond_signal(&pool->work_done);
         }
     }
+    pthread_mutex_unlock(&pool->lock);
     
-    return 0;
+    return NULL;
+}
+
+static struct stats_worker_pool *start_workers(int count) {
+    struct stats_worker_pool *pool = calloc(1, sizeof(struct stats_worker_pool));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+    
+    for (int i = 0; i < count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, stats_worker, pool) != 0) {
+            break;
+        }
+        pool->thread_count++;
+    }
+    
+    if (pool->thread_count == 0) {
+        stop_workers(pool);
+        return NULL;
+    }
+    
+    return pool;
+}
+
+static void stop_workers(struct stats_worker_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
 }
 
 void print_container_stats(const monitor_state_t *state) {
-    time_t now = time(NULL);
+    time_t now = state->last_update;
     char time_str[64];
-    strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
     
     printf("\n[%s] Статистика контейнеров (%d контейнеров)\n", time_str, state->container_count);
     printf("----------------------------------------------------------------\n");
     
-    for (int i = 0; i < state->container_count; i++) {
+    for (int i = 0; i < state->container_slots; i++) {
         const container_monitor_t *container = &state->containers[i];
+        ts_summary_t cpu, memory;
+        if (!container->in_use) continue;
         
         printf("Контейнер: %s\n", container->info.name);
+        if (state->host_count > 1) {
+            printf("Хост: %s\n", monitor_host_name(state, container->info.host));
+        }
         printf("ID: %s\n", container->info.id);
         printf("Образ: %s\n", container->info.image);
         printf("Статус: %s\n", container->info.status);
         
         if (container->is_running) {
+            printf("CPU: %s (%u CPU)\n",
+                   format_percentage(container->cpu_percent),
+                   container->stats.online_cpus > 0 ? container->stats.online_cpus : 1);
+            
             printf("Память: %s / %s (%s)\n", 
-                   format_bytes(container->stats.memory_usage),
+                   format_bytes(container->memory_working_set),
                    format_bytes(container->stats.memory_limit),
                    format_percentage(container->memory_percent));
             
-            printf("Сеть RX: %s | TX: %s\n",
+            printf("Сеть RX: %s/с | TX: %s/с (всего %s / %s)\n",
+                   format_bytes((uint64_t)container->network_rx_rate),
+                   format_bytes((uint64_t)container->network_tx_rate),
                    format_bytes(container->stats.network_rx_bytes),
                    format_bytes(container->stats.network_tx_bytes));
             
-            printf("CPU Usage: %lu | System: %lu\n",
-                   container->stats.cpu_usage,
-                   container->stats.cpu_system_usage);
+            printf("Диск R: %s/с | W: %s/с\n",
+                   format_bytes((uint64_t)container->block_read_rate),
+                   format_bytes((uint64_t)container->block_write_rate));
+            
+            if (container->history &&
+                timeseries_query(container->history, TS_CPU_PERCENT, now, HISTORY_WINDOW, &cpu) == 0 &&
+                timeseries_query(container->history, TS_MEMORY_WORKING_SET, now, HISTORY_WINDOW, &memory) == 0 &&
+                cpu.samples > 1) {
+                printf("За %d мин: CPU мин %s / макс %s / p95 %s | Память макс %s\n",
+                       HISTORY_WINDOW / 60,
+                       format_percentage(cpu.min),
+                       format_percentage(cpu.max),
+                       format_percentage(cpu.p95),
+                       format_bytes((uint64_t)memory.max));
+            }
         } else {
             printf("Контейнер не запущен\n");
         }
@@ -92,31 +460,75 @@ void print_container_stats(const monitor_state_t *state) {
     }
 }
 
-void print_summary(const monitor_state_t *state) {
+/* the ranking comes out of the same pass that sums the totals */
+void print_summary(const monitor_state_t *state, top_k_t *top) {
     if (!state) {
         return;
     }
     
-    time_t now = time(NULL);
+    time_t now = state->last_update;
     char time_str[64];
-    strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
-    
-    int running_count = 0;
-    uint64_t total_memory = 0;
-    uint64_t total_memory_limit = 0;
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
     
-    for (int i = 0; i < state->container_count; i++) {
-        if (state->containers[i].is_running) {
-            running_count++;
-            total_memory += state->containers[i].stats.memory_usage;
-            total_memory_limit += state->containers[i].stats.memory_limit;
-        }
+    monitor_summary_t summary;
+    if (top) {
+        top_k_reset(top);
     }
+    monitor_summarize(state, -1, &summary, top);
     
-    printf("[%s] Сводка: %d/%d контейнеров запущено | Память: %s / %s\n",
+    printf("[%s] Сводка: %d/%d контейнеров запущено | CPU: %s | Память: %s / %s\n",
            time_str,
-           running_count,
-           state->container_count,
-           format_bytes(total_memory),
-           format_bytes(total_memory_limit));
-} 
\ No newline at end of file
+           summary.running,
+           summary.containers,
+           format_percentage(summary.cpu_percent),
+           format_bytes(summary.memory),
+           format_bytes(summary.memory_limit));
+    
+    for (int host = 0; host < state->host_count && state->host_count > 1; host++) {
+        monitor_summarize(state, host, &summary, NULL);
+        printf("  %s: %d/%d | CPU: %s | Память: %s / %s%s\n",
+               state->hosts[host].name,
+               summary.running,
+               summary.containers,
+               format_percentage(summary.cpu_percent),
+               format_bytes(summary.memory),
+               format_bytes(summary.memory_limit),
+               state->hosts[host].client && !state->hosts[host].reachable ? " (недоступен)" : "");
+    }
+    
+    if (top) {
+        print_top(state, top);
+    }
+}
+
+static void print_top(const monitor_state_t *state, top_k_t *top) {
+    static const char *titles[TOP_METRIC_COUNT] = {"CPU", "памяти", "сети", "диску"};
+    const int *slots;
+    int count = top_k_sorted(top, &slots);
+    
+    printf("  Топ %d по %s:\n", count, titles[top_k_metric(top)]);
+    for (int i = 0; i < count; i++) {
+        const container_monitor_t *container = &state->containers[slots[i]];
+        char label[MAX_CONTAINER_NAME + 256];
+        
+        if (state->host_count > 1) {
+            snprintf(label, sizeof(label), "%s (%s)", container->info.name,
+                     monitor_host_name(state, container->info.host));
+        } else {
+            snprintf(label, sizeof(label), "%s", container->info.name);
+        }
+        
+        printf("  %3d. %-24s CPU: %s | Память: %s (%s) | Сеть: %s/с / %s/с | Диск: %s/с / %s/с\n",
+               i + 1,
+               label,
+               format_percentage(container->cpu_percent),
+               format_bytes(container->memory_working_set),
+               format_percentage(container->memory_percent),
+               format_bytes((uint64_t)container->network_rx_rate),
+               format_bytes((uint64_t)container->network_tx_rate),
+               format_bytes((uint64_t)container->block_read_rate),
+               format_bytes((uint64_t)container->block_write_rate));
+    }
+}
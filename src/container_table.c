@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/docker_monitor.h"
+#include "../include/docker_api.h"
+#include "../include/timeseries.h"
+#include "../include/poll_scheduler.h"
+
+#define INDEX_EMPTY 0
+#define INDEX_TOMBSTONE -1
+#define INDEX_MIN_CAPACITY 64
+#define TABLE_MIN_CAPACITY 32
+
+static uint32_t hash_id(int host, const char *id);
+static int index_lookup(const monitor_state_t *state, int host, const char *id);
+static int index_rebuild(monitor_state_t *state, int capacity);
+static int allocate_slot(monitor_state_t *state);
+
+container_monitor_t *monitor_find_container(const monitor_state_t *state, int host, const char *id) {
+    int position = index_lookup(state, host, id);
+    
+    if (position < 0) {
+        return NULL;
+    }
+    
+    return &state->containers[state->index[position] - 1];
+}
+
+container_monitor_t *monitor_add_container(monitor_state_t *state, const container_info_t *info) {
+    container_monitor_t *container = monitor_find_container(state, info->host, info->id);
+    
+    if (container) {
+        container->info = *info;
+        return container;
+    }
+    
+    /* keep the load (live entries plus tombstones) under 3/4 */
+    if ((state->index_used + 1) * 4 >= state->index_capacity * 3) {
+        int capacity = INDEX_MIN_CAPACITY;
+        while (capacity * 3 <= (state->container_count + 1) * 8) {
+            capacity *= 2;
+        }
+        if (index_rebuild(state, capacity) != 0) {
+            return NULL;
+        }
+    }
+    
+    int slot = allocate_slot(state);
+    if (slot < 0) {
+        return NULL;
+    }
+    
+    container = &state->containers[slot];
+    memset(container, 0, sizeof(container_monitor_t));
+    container->info = *info;
+    container->in_use = 1;
+    
+    uint32_t mask = state->index_capacity - 1;
+    uint32_t position = hash_id(info->host, info->id) & mask;
+    while (state->index[position] > 0) {
+        position = (position + 1) & mask;
+    }
+    if (state->index[position] == INDEX_EMPTY) {
+        state->index_used++;
+    }
+    state->index[position] = slot + 1;
+    state->container_count++;
+    
+    if (state->scheduler) {
+        poll_scheduler_add(state->scheduler, container, slot);
+    }
+    
+    return container;
+}
+
+void monitor_remove_container(monitor_state_t *state, int host, const char *id) {
+    int position = index_lookup(state, host, id);
+    
+    if (position < 0) {
+        return;
+    }
+    
+    int slot = state->index[position] - 1;
+    state->index[position] = INDEX_TOMBSTONE;
+    state->containers[slot].in_use = 0;
+    timeseries_destroy(state->containers[slot].history);
+    state->containers[slot].history = NULL;
+    state->free_slots[state->free_count++] = slot;
+    state->container_count--;
+    
+    if (host >= 0 && host < state->host_count) {
+        docker_release_container(state->hosts[host].client, id);
+    }
+}
+
+void monitor_table_free(monitor_state_t *state) {
+    for (int i = 0; i < state->container_slots; i++) {
+        timeseries_destroy(state->containers[i].history);
+    }
+    free(state->containers);
+    free(state->free_slots);
+    free(state->index);
+    
+    state->containers = NULL;
+    state->free_slots = NULL;
+    state->index = NULL;
+    state->container_count = 0;
+    state->container_slots = 0;
+    state->container_capacity = 0;
+    state->free_count = 0;
+    state->index_capacity = 0;
+    state->index_used = 0;
+}
+
+int monitor_add_host(monitor_state_t *state, const char *name) {
+    for (int i = 0; i < state->host_count; i++) {
+        if (strcmp(state->hosts[i].name, name) == 0) {
+            return i;
+        }
+    }
+    
+    monitor_host_t *hosts = realloc(state->hosts, (state->host_count + 1) * sizeof(monitor_host_t));
+    if (!hosts) {
+        return -1;
+    }
+    
+    monitor_host_t *host = &hosts[state->host_count];
+    memset(host, 0, sizeof(monitor_host_t));
+    snprintf(host->name, sizeof(host->name), "%s", name);
+    
+    state->hosts = hosts;
+    return state->host_count++;
+}
+
+const char *monitor_host_name(const monitor_state_t *state, int host) {
+    if (host < 0 || host >= state->host_count) {
+        return "";
+    }
+    return state->hosts[host].name;
+}
+
+int container_list_append(container_list_t *list, const container_info_t *info) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : TABLE_MIN_CAPACITY;
+        container_info_t *items = realloc(list->items, capacity * sizeof(container_info_t));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    
+    list->items[list->count++] = *info;
+    return 0;
+}
+
+void container_list_free(container_list_t *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+/* the same id may in principle show up on two daemons, so the key is (host, id) */
+static uint32_t hash_id(int host, const char *id) {
+    uint32_t hash = 2166136261u ^ (uint32_t)host * 16777619u;
+    
+    while (*id) {
+        hash ^= (unsigned char)*id++;
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+static int index_lookup(const monitor_state_t *state, int host, const char *id) {
+    if (state->index_capacity == 0) {
+        return -1;
+    }
+    
+    uint32_t mask = state->index_capacity - 1;
+    uint32_t position = hash_id(host, id) & mask;
+    
+    while (state->index[position] != INDEX_EMPTY) {
+        int32_t entry = state->index[position];
+        if (entry > 0 && state->containers[entry - 1].info.host == host &&
+            strcmp(state->containers[entry - 1].info.id, id) == 0) {
+            return position;
+        }
+        position = (position + 1) & mask;
+    }
+    
+    return -1;
+}
+
+static int index_rebuild(monitor_state_t *state, int capacity) {
+    int32_t *index = calloc(capacity, sizeof(int32_t));
+    uint32_t mask = capacity - 1;
+    
+    if (!index) {
+        return -1;
+    }
+    
+    for (int slot = 0; slot < state->container_slots; slot++) {
+        if (!state->containers[slot].in_use) continue;
+        
+        uint32_t position = hash_id(state->containers[slot].info.host, state->containers[slot].info.id) & mask;
+        while (index[position] != INDEX_EMPTY) {
+            position = (position + 1) & mask;
+        }
+        index[position] = slot + 1;
+    }
+    
+    free(state->index);
+    state->index = index;
+    state->index_capacity = capacity;
+    state->index_used = state->container_count;
+    return 0;
+}
+
+static int allocate_slot(monitor_state_t *state) {
+    if (state->free_count > 0) {
+        return state->free_slots[--state->free_count];
+    }
+    
+    if (state->container_slots == state->container_capacity) {
+        int capacity = state->container_capacity ? state->container_capacity * 2 : TABLE_MIN_CAPACITY;
+        container_monitor_t *containers = realloc(state->containers, capacity * sizeof(container_monitor_t));
+        if (!containers) {
+            return -1;
+        }
+        state->containers = containers;
+        
+        int *free_slots = realloc(state->free_slots, capacity * sizeof(int));
+        if (!free_slots) {
+            return -1;
+        }
+        state->free_slots = free_slots;
+        state->container_capacity = capacity;
+    }
+    
+    return state->container_slots++;
+}
@@ -2,424 +2,621 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <sys/stat.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netdb.h>
 #include <errno.h>
-#include <json-c/json.h>
 #include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
 #include "../include/docker_api.h"
+#include "../include/cgroup_stats.h"
+#include "../include/json_scan.h"
+#include "../include/stage_timer.h"
+#include "../include/text_buffer.h"
 
-static int docker_socket = -1;
-static docker_config_t current_config;
+struct docker_client {
+    char host[256];
+    int local;
+    int cgroup_backend;
+    const container_filter_t *filter;
+    char *list_path;
+    char *events_path;
+    http_pool_t pool;
+};
 
-static int init_local_socket(void);
-static int init_remote_socket(const docker_config_t *config);
-static int send_http_request_unix(const char *method, const char *path, char **response);
-static int send_http_request_tcp(const char *method, const char *path, char **response);
+/* the cgroup backend reads this machine's hierarchy, so one client at most owns it */
+static pthread_mutex_t cgroup_lock = PTHREAD_MUTEX_INITIALIZER;
+static int cgroup_owned = 0;
 
-int docker_api_init(const docker_config_t *config) {
+static int is_local_host(const docker_config_t *config);
+static char *filtered_path(const char *base, const char *members, const container_filter_t *filter, int events);
+
+docker_client_t *docker_client_create(const docker_config_t *config) {
     if (!config) {
         print_error("Некорректная конфигурация");
-        return -1;
+        return NULL;
     }
     
-    memcpy(&current_config, config, sizeof(docker_config_t));
-    
-    if (strcmp(config->host, "localhost") == 0 || strcmp(config->host, "127.0.0.1") == 0) {
-        return init_local_socket();
-    } else {
-        return init_remote_socket(config);
+    docker_client_t *client = calloc(1, sizeof(docker_client_t));
+    if (!client) {
+        return NULL;
     }
-}
-
-static int init_local_socket(void) {
-    struct sockaddr_un addr;
     
-    if (access(DOCKER_SOCKET, F_OK) == -1) {
-        print_error("Docker socket не найден. Убедитесь, что Docker запущен.");
-        return -1;
+    snprintf(client->host, sizeof(client->host), "%s", config->host);
+    client->local = is_local_host(config);
+    client->filter = config->filter && config->filter->count > 0 ? config->filter : NULL;
+    
+    client->list_path = filtered_path("/containers/json", NULL, client->filter, 0);
+    client->events_path = filtered_path("/events", "\"type\":[\"container\"],\"event\":[\"start\",\"die\","
+                                        "\"destroy\",\"rename\",\"pause\",\"unpause\"]", client->filter, 1);
+    if (!client->list_path || !client->events_path) {
+        free(client->list_path);
+        free(client->events_path);
+        free(client);
+        return NULL;
     }
     
-    docker_socket = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (docker_socket == -1) {
-        print_error("Ошибка создания сокета");
-        return -1;
+    if (client->local) {
+        /* unix://<path> names a socket other than the default one */
+        const char *socket_path = strncmp(config->host, UNIX_HOST_PREFIX, strlen(UNIX_HOST_PREFIX)) == 0
+                                  ? config->host + strlen(UNIX_HOST_PREFIX) : DOCKER_SOCKET;
+        
+        if (access(socket_path, F_OK) == -1) {
+            print_error("Docker socket не найден. Убедитесь, что Docker запущен.");
+            free(client->list_path);
+            free(client->events_path);
+            free(client);
+            return NULL;
+        }
+        http_pool_init(&client->pool, config->host, config->port, socket_path);
+    } else {
+        if (http_pool_init(&client->pool, config->host, config->port, NULL) != 0) {
+            free(client->list_path);
+            free(client->events_path);
+            free(client);
+            return NULL;
+        }
+        if (config->use_tls &&
+            http_pool_enable_tls(&client->pool, config->ca_path, config->cert_path, config->key_path) != 0) {
+            docker_client_destroy(client);
+            return NULL;
+        }
     }
     
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, DOCKER_SOCKET, sizeof(addr.sun_path) - 1);
+    http_pool_set_timeouts(&client->pool, config->connect_timeout_ms, config->read_timeout_ms);
     
-    if (connect(docker_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        print_error("Ошибка подключения к Docker socket");
-        close(docker_socket);
-        docker_socket = -1;
-        return -1;
+    if (config->use_cgroup && client->local) {
+        pthread_mutex_lock(&cgroup_lock);
+        if (!cgroup_owned) {
+            if (cgroup_stats_init(config->cgroup_root[0] ? config->cgroup_root : NULL,
+                                  config->proc_root[0] ? config->proc_root : NULL) != 0) {
+                pthread_mutex_unlock(&cgroup_lock);
+                print_error("Файловая система cgroup недоступна");
+                docker_client_destroy(client);
+                return NULL;
+            }
+            cgroup_owned = 1;
+            client->cgroup_backend = 1;
+        }
+        pthread_mutex_unlock(&cgroup_lock);
     }
     
-    return 0;
+    return client;
 }
 
-static int init_remote_socket(const docker_config_t *config) {
-    struct sockaddr_in addr;
-    struct hostent *host;
-    
-    docker_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (docker_socket == -1) {
-        print_error("Ошибка создания TCP сокета");
-        return -1;
+void docker_client_destroy(docker_client_t *client) {
+    if (!client) {
+        return;
     }
     
-    host = gethostbyname(config->host);
-    if (!host) {
-        print_error("Не удалось разрешить имя хоста");
-        close(docker_socket);
-        docker_socket = -1;
-        return -1;
+    if (client->cgroup_backend) {
+        pthread_mutex_lock(&cgroup_lock);
+        cgroup_stats_cleanup();
+        cgroup_owned = 0;
+        pthread_mutex_unlock(&cgroup_lock);
     }
+    http_pool_cleanup(&client->pool);
+    free(client->list_path);
+    free(client->events_path);
+    free(client);
+}
+
+int docker_client_connect(docker_client_t *client) {
+    char message[384];
     
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(config->port);
-    memcpy(&addr.sin_addr, host->h_addr_list[0], host->h_length);
-    
-    if (connect(docker_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        print_error("Ошибка подключения к удаленному Docker daemon");
-        close(docker_socket);
-        docker_socket = -1;
-        return -1;
+    if (http_pool_prime(&client->pool) == 0) {
+        return 0;
     }
     
-    return 0;
-}
-
-void docker_api_cleanup(void) {
-    if (docker_socket != -1) {
-        close(docker_socket);
-        docker_socket = -1;
+    if (client->local) {
+        print_error("Ошибка подключения к Docker socket");
+    } else {
+        snprintf(message, sizeof(message), "Ошибка подключения к удаленному Docker daemon %s", client->host);
+        print_error(message);
     }
+    return -1;
 }
 
-static int send_http_request(const char *method, const char *path, char **response) {
-    if (strcmp(current_config.host, "localhost") == 0 || strcmp(current_config.host, "127.0.0.1") == 0) {
-        return send_http_request_unix(method, path, response);
-    } else {
-        return send_http_request_tcp(method, path, response);
+/* with --tls even localhost means the daemon's TCP port */
+static int is_local_host(const docker_config_t *config) {
+    if (strncmp(config->host, UNIX_HOST_PREFIX, strlen(UNIX_HOST_PREFIX)) == 0) {
+        return 1;
     }
+    return !config->use_tls && (strcmp(config->host, "localhost") == 0 || strcmp(config->host, "127.0.0.1") == 0);
 }
 
-static int send_http_request_unix(const char *method, const char *path, char **response) {
-    char request[1024];
-    char buffer[4096];
-    ssize_t bytes_read;
-    size_t total_size = 0;
-    char *temp_response = NULL;
-    int temp_socket;
-    struct sockaddr_un addr;
-    
-    temp_socket = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (temp_socket == -1) {
-        return -1;
-    }
+/* filters= narrows down what the daemon sends; whatever it cannot evaluate
+   is checked again on each container the list and event parsers see */
+static char *filtered_path(const char *base, const char *members, const container_filter_t *filter, int events) {
+    text_buffer_t selectors, path;
     
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, DOCKER_SOCKET, sizeof(addr.sun_path) - 1);
-    
-    if (connect(temp_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        close(temp_socket);
-        return -1;
+    if (text_buffer_init(&selectors, 256) != 0) {
+        return NULL;
     }
-    
-    snprintf(request, sizeof(request),
-             "%s %s HTTP/1.1\r\n"
-             "Host: localhost\r\n"
-             "Connection: close\r\n"
-             "\r\n",
-             method, path);
-    
-    if (send(temp_socket, request, strlen(request), 0) == -1) {
-        close(temp_socket);
-        return -1;
+    if (text_buffer_init(&path, 256) != 0) {
+        text_buffer_free(&selectors);
+        return NULL;
     }
     
-    while ((bytes_read = recv(temp_socket, buffer, sizeof(buffer) - 1, 0)) > 0) {
-        buffer[bytes_read] = '\0';
-        
-        char *new_response = realloc(temp_response, total_size + bytes_read + 1);
-        if (!new_response) {
-            free(temp_response);
-            close(temp_socket);
-            return -1;
+    if (members) {
+        text_buffer_append_str(&selectors, members);
+    }
+    if (filter) {
+        size_t before = selectors.len;
+        if (members) {
+            text_buffer_append_str(&selectors, ",");
+        }
+        if (container_filter_append_json(filter, events, &selectors) == 0) {
+            selectors.len = before;
         }
-        
-        temp_response = new_response;
-        strcpy(temp_response + total_size, buffer);
-        total_size += bytes_read;
     }
     
-    close(temp_socket);
-    
-    if (temp_response) {
-        char *body_start = strstr(temp_response, "\r\n\r\n");
-        if (body_start) {
-            body_start += 4;
-            *response = malloc(strlen(body_start) + 1);
-            if (*response) {
-                strcpy(*response, body_start);
+    text_buffer_append_str(&path, base);
+    if (selectors.len > 0) {
+        static const char hex[] = "0123456789ABCDEF";
+        
+        text_buffer_append_str(&path, "?filters=%7B");
+        for (size_t i = 0; i < selectors.len; i++) {
+            unsigned char c = selectors.data[i];
+            if (isalnum(c) || strchr("-._~", c)) {
+                text_buffer_append(&path, (const char *)&c, 1);
+            } else {
+                char escaped[3] = { '%', hex[c >> 4], hex[c & 15] };
+                text_buffer_append(&path, escaped, 3);
             }
-            free(temp_response);
-        } else {
-            *response = temp_response;
         }
+        text_buffer_append_str(&path, "%7D");
     }
     
-    return 0;
+    /* the buffer stays NUL-terminated, so its data becomes the path */
+    int failed = selectors.failed || path.failed;
+    text_buffer_free(&selectors);
+    if (failed) {
+        text_buffer_free(&path);
+        return NULL;
+    }
+    return path.data;
 }
 
-static int send_http_request_tcp(const char *method, const char *path, char **response) {
-    char request[1024];
-    char buffer[4096];
-    ssize_t bytes_read;
-    size_t total_size = 0;
-    char *temp_response = NULL;
-    int temp_socket;
-    struct sockaddr_in addr;
-    struct hostent *host;
-    
-    temp_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (temp_socket == -1) {
-        return -1;
-    }
+const container_filter_t *docker_client_filter(docker_client_t *client) {
+    return client->filter;
+}
+
+void docker_client_get_pool_stats(docker_client_t *client, http_pool_stats_t *stats) {
+    http_pool_get_stats(&client->pool, stats);
+}
+
+int docker_get_containers(docker_client_t *client, container_list_t *list) {
+    http_response_t response;
+    int result = -1;
     
-    host = gethostbyname(current_config.host);
-    if (!host) {
-        close(temp_socket);
-        return -1;
+    if (http_pool_request(&client->pool, "GET", client->list_path, &response) == 0) {
+        result = docker_parse_container_list(response.body, response.len, client->filter, list);
+        http_response_release(&client->pool, &response);
     }
     
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(current_config.port);
-    memcpy(&addr.sin_addr, host->h_addr_list[0], host->h_length);
-    
-    if (connect(temp_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
-        close(temp_socket);
-        return -1;
+    if (client->cgroup_backend && result >= 0) {
+        cgroup_stats_retain(list->items, list->count);
     }
     
-    snprintf(request, sizeof(request),
-             "%s %s HTTP/1.1\r\n"
-             "Host: %s:%d\r\n"
-             "Connection: close\r\n"
-             "\r\n",
-             method, path, current_config.host, current_config.port);
-    
-    if (send(temp_socket, request, strlen(request), 0) == -1) {
-        close(temp_socket);
-        return -1;
-    }
+    return result;
+}
+
+int docker_get_container_stats(docker_client_t *client, const char *container_id, container_stats_t *stats) {
+    char path[256];
+    http_response_t response;
+    int result = -1;
     
-    while ((bytes_read = recv(temp_socket, buffer, sizeof(buffer) - 1, 0)) > 0) {
-        buffer[bytes_read] = '\0';
-        
-        char *new_response = realloc(temp_response, total_size + bytes_read + 1);
-        if (!new_response) {
-            free(temp_response);
-            close(temp_socket);
-            return -1;
+    /* containers whose cgroup cannot be resolved still go through the daemon */
+    if (client->cgroup_backend) {
+        uint64_t start = stage_now();
+        if (cgroup_get_container_stats(container_id, stats) == 0) {
+            stage_record(STAGE_CGROUP, start);
+            return 0;
         }
-        
-        temp_response = new_response;
-        strcpy(temp_response + total_size, buffer);
-        total_size += bytes_read;
     }
     
-    close(temp_socket);
+    snprintf(path, sizeof(path), "/containers/%s/stats?stream=false", container_id);
     
-    if (temp_response) {
-        char *body_start = strstr(temp_response, "\r\n\r\n");
-        if (body_start) {
-            body_start += 4;
-            *response = malloc(strlen(body_start) + 1);
-            if (*response) {
-                strcpy(*response, body_start);
-            }
-            free(temp_response);
-        } else {
-            *response = temp_response;
-        }
+    if (http_pool_request(&client->pool, "GET", path, &response) == 0) {
+        result = docker_parse_container_stats(response.body, response.len, stats);
+        http_response_release(&client->pool, &response);
     }
     
-    return 0;
+    return result;
 }
 
-int docker_get_containers(container_info_t *containers, int max_count) {
-    char *response = NULL;
-    int result = -1;
+int docker_open_stats_stream(docker_client_t *client, http_stream_t *stream, const char *container_id) {
+    char path[256];
     
-    if (send_http_request("GET", "/containers/json", &response) == 0) {
-        result = docker_parse_container_list(response, containers, max_count);
-        free(response);
+    snprintf(path, sizeof(path), "/containers/%s/stats?stream=true", container_id);
+    return http_stream_open(stream, &client->pool, path);
+}
+
+int docker_open_event_stream(docker_client_t *client, http_stream_t *stream) {
+    return http_stream_open(stream, &client->pool, client->events_path);
+}
+
+void docker_release_container(docker_client_t *client, const char *container_id) {
+    if (client && client->cgroup_backend) {
+        cgroup_stats_forget(container_id);
     }
-    
-    return result;
 }
 
-int docker_get_container_stats(const char *container_id, container_stats_t *stats) {
-    char path[256];
-    char *response = NULL;
-    int result = -1;
-    
-    snprintf(path, sizeof(path), "/containers/%s/stats?stream=false", container_id);
-    
-    if (send_http_request("GET", path, &response) == 0) {
-        result = docker_parse_container_stats(response, stats);
-        free(response);
+typedef struct {
+    container_list_t *list;
+    const container_filter_t *filter;
+    container_info_t info;
+    uint32_t labels;
+    unsigned fields;
+    int not_array;
+    int failed;
+} list_scan_t;
+
+/* the legacy top-level id/from/status are kept apart because they only
+   count when the Actor fields are missing, whatever the key order */
+typedef struct {
+    docker_event_t *event;
+    const container_filter_t *filter;
+    uint32_t labels;
+    int other_type;
+    int has_action;
+    char action[32];
+    char status[32];
+    char id[MAX_CONTAINER_ID];
+    char from[MAX_CONTAINER_NAME];
+} event_scan_t;
+
+typedef struct {
+    container_stats_t *stats;
+    uint32_t percpu_count;
+    uint64_t inactive_file;
+    uint64_t total_inactive_file;
+    char blkio_op[16];
+    uint64_t blkio_value;
+} stats_scan_t;
+
+enum {
+    LIST_FIELD_ID = 1,
+    LIST_FIELD_NAMES = 2,
+    LIST_FIELD_IMAGE = 4,
+    LIST_FIELD_STATUS = 8,
+    LIST_FIELD_CREATED = 16,
+    LIST_FIELDS_ALL = 31
+};
+
+static void scan_container_list(void *ctx, const json_scan_t *scan, json_scan_event_t event,
+                                const char *value, size_t len) {
+    list_scan_t *parse = ctx;
+    int depth = json_scan_depth(scan);
+    
+    if (depth == 0) {
+        if (event != JSON_SCAN_ARRAY_START && event != JSON_SCAN_ARRAY_END) {
+            parse->not_array = 1;
+        }
+        return;
+    }
+    
+    if (depth == 1) {
+        if (event == JSON_SCAN_OBJECT_START) {
+            memset(&parse->info, 0, sizeof(parse->info));
+            strcpy(parse->info.name, "unknown");
+            parse->labels = 0;
+            parse->fields = 0;
+        } else if (event == JSON_SCAN_OBJECT_END && parse->fields == LIST_FIELDS_ALL && !parse->failed) {
+            if (parse->filter && !container_filter_match(parse->filter, &parse->info, parse->labels)) {
+                return;
+            }
+            parse->info.last_seen = time(NULL);
+            if (container_list_append(parse->list, &parse->info) != 0) {
+                parse->failed = 1;
+            }
+        }
+        return;
+    }
+    
+    const char *key = json_scan_key(scan, 1);
+    
+    if (depth == 2) {
+        if (event == JSON_SCAN_STRING) {
+            if (strcmp(key, "Id") == 0) {
+                snprintf(parse->info.id, sizeof(parse->info.id), "%s", value);
+                parse->fields |= LIST_FIELD_ID;
+            } else if (strcmp(key, "Image") == 0) {
+                snprintf(parse->info.image, sizeof(parse->info.image), "%s", value);
+                parse->fields |= LIST_FIELD_IMAGE;
+            } else if (strcmp(key, "Status") == 0) {
+                snprintf(parse->info.status, sizeof(parse->info.status), "%s", value);
+                parse->fields |= LIST_FIELD_STATUS;
+            }
+        } else if (event == JSON_SCAN_NUMBER && strcmp(key, "Created") == 0) {
+            parse->info.created = json_scan_i64(value, len);
+            parse->fields |= LIST_FIELD_CREATED;
+        } else if (event == JSON_SCAN_ARRAY_START && strcmp(key, "Names") == 0) {
+            parse->fields |= LIST_FIELD_NAMES;
+        }
+    } else if (depth == 3 && event == JSON_SCAN_STRING && json_scan_index(scan, 2) == 0 &&
+               strcmp(key, "Names") == 0) {
+        snprintf(parse->info.name, sizeof(parse->info.name), "%s", value[0] == '/' ? value + 1 : value);
+    } else if (depth == 3 && event == JSON_SCAN_STRING && parse->filter && strcmp(key, "Labels") == 0) {
+        parse->labels |= container_filter_label(parse->filter, json_scan_key(scan, 2), value);
     }
-    
-    return result;
 }
 
-int docker_parse_container_list(const char *json_data, container_info_t *containers, int max_count) {
-    json_object *root, *container, *names, *name;
-    int count = 0;
+int docker_parse_container_list(const char *json_data, size_t len, const container_filter_t *filter,
+                                container_list_t *list) {
+    json_scan_t scan;
+    list_scan_t parse;
     
-    if (!json_data || !containers) {
+    if (!json_data || !list) {
         print_error("Некорректные параметры для парсинга");
         return -1;
     }
     
-    root = json_tokener_parse(json_data);
-    if (!root) {
+    uint64_t start = stage_now();
+    memset(&parse, 0, sizeof(parse));
+    parse.list = list;
+    parse.filter = filter;
+    
+    json_scan_init(&scan, scan_container_list, &parse);
+    if (json_scan_feed(&scan, json_data, len) != 0 || json_scan_finish(&scan) != 0) {
         print_error("Ошибка парсинга JSON");
         return -1;
     }
     
-    if (!json_object_is_type(root, json_type_array)) {
+    if (parse.not_array) {
         print_error("Ожидался JSON массив");
-        json_object_put(root);
         return -1;
     }
     
-    for (int i = 0; i < json_object_array_length(root) && count < max_count; i++) {
-        container = json_object_array_get_idx(root, i);
-        if (!container) continue;
-        
-        json_object *id_obj, *names_obj, *image_obj, *status_obj, *created_obj;
+    stage_record(STAGE_PARSE_LIST, start);
+    return parse.failed ? -1 : list->count;
+}
+
+static void scan_cpu_stats(stats_scan_t *parse, const json_scan_t *scan, uint64_t number, int previous) {
+    container_stats_t *stats = parse->stats;
+    int depth = json_scan_depth(scan);
+    const char *key = json_scan_key(scan, 1);
+    
+    if (depth == 2) {
+        if (strcmp(key, "system_cpu_usage") == 0) {
+            *(previous ? &stats->precpu_system_usage : &stats->cpu_system_usage) = number;
+        } else if (!previous && strcmp(key, "online_cpus") == 0) {
+            stats->online_cpus = number;
+        }
+    } else if (strcmp(key, "cpu_usage") != 0) {
+        return;
+    } else if (depth == 3 && strcmp(json_scan_key(scan, 2), "total_usage") == 0) {
+        *(previous ? &stats->precpu_usage : &stats->cpu_usage) = number;
+    } else if (depth == 4 && !previous && strcmp(json_scan_key(scan, 2), "percpu_usage") == 0) {
+        parse->percpu_count = json_scan_index(scan, 3) + 1;
+    }
+}
+
+/* only a dozen fields of the several KB stats document are needed, so they
+   are picked out by path while scanning instead of building a DOM */
+static void scan_container_stats(void *ctx, const json_scan_t *scan, json_scan_event_t event,
+                                 const char *value, size_t len) {
+    stats_scan_t *parse = ctx;
+    container_stats_t *stats = parse->stats;
+    int depth = json_scan_depth(scan);
+    
+    if (depth < 2) {
+        return;
+    }
+    
+    const char *section = json_scan_key(scan, 0);
+    const char *leaf = json_scan_key(scan, depth - 1);
+    
+    if (event == JSON_SCAN_NUMBER) {
+        uint64_t number = json_scan_u64(value, len);
         
-        if (json_object_object_get_ex(container, "Id", &id_obj) &&
-            json_object_object_get_ex(container, "Names", &names_obj) &&
-            json_object_object_get_ex(container, "Image", &image_obj) &&
-            json_object_object_get_ex(container, "Status", &status_obj) &&
-            json_object_object_get_ex(container, "Created", &created_obj)) {
-            
-            const char *id_str = json_object_get_string(id_obj);
-            const char *image_str = json_object_get_string(image_obj);
-            const char *status_str = json_object_get_string(status_obj);
-            
-            if (id_str && image_str && status_str) {
-                strncpy(containers[count].id, id_str, sizeof(containers[count].id) - 1);
-                containers[count].id[sizeof(containers[count].id) - 1] = '\0';
-                
-                if (json_object_array_length(names_obj) > 0) {
-                    name = json_object_array_get_idx(names_obj, 0);
-                    if (name) {
-                        const char *name_str = json_object_get_string(name);
-                        if (name_str) {
-                            if (name_str[0] == '/') name_str++;
-                            strncpy(containers[count].name, name_str, sizeof(containers[count].name) - 1);
-                            containers[count].name[sizeof(containers[count].name) - 1] = '\0';
-                        } else {
-                            strcpy(containers[count].name, "unknown");
-                        }
-                    } else {
-                        strcpy(containers[count].name, "unknown");
-                    }
-                } else {
-                    strcpy(containers[count].name, "unknown");
-                }
-                
-                strncpy(containers[count].image, image_str, sizeof(containers[count].image) - 1);
-                containers[count].image[sizeof(containers[count].image) - 1] = '\0';
-                
-                strncpy(containers[count].status, status_str, sizeof(containers[count].status) - 1);
-                containers[count].status[sizeof(containers[count].status) - 1] = '\0';
-                
-                containers[count].created = json_object_get_int64(created_obj);
-                containers[count].last_seen = time(NULL);
-                
-                count++;
+        if (strcmp(section, "cpu_stats") == 0) {
+            scan_cpu_stats(parse, scan, number, 0);
+        } else if (strcmp(section, "precpu_stats") == 0) {
+            scan_cpu_stats(parse, scan, number, 1);
+        } else if (strcmp(section, "memory_stats") == 0) {
+            if (depth == 2 && strcmp(leaf, "usage") == 0) {
+                stats->memory_usage = number;
+            } else if (depth == 2 && strcmp(leaf, "limit") == 0) {
+                stats->memory_limit = number;
+            } else if (depth == 3 && strcmp(leaf, "inactive_file") == 0) {
+                parse->inactive_file = number;
+            } else if (depth == 3 && strcmp(leaf, "total_inactive_file") == 0) {
+                parse->total_inactive_file = number;
+            }
+        } else if (strcmp(section, "networks") == 0) {
+            if (depth == 3 && strcmp(leaf, "rx_bytes") == 0) {
+                stats->network_rx_bytes += number;
+            } else if (depth == 3 && strcmp(leaf, "tx_bytes") == 0) {
+                stats->network_tx_bytes += number;
             }
+        } else if (depth == 4 && strcmp(leaf, "value") == 0 &&
+                   json_scan_match(scan, "blkio_stats.io_service_bytes_recursive.*.value")) {
+            parse->blkio_value = number;
+        }
+    } else if (event == JSON_SCAN_STRING) {
+        if (depth == 4 && strcmp(leaf, "op") == 0 &&
+            json_scan_match(scan, "blkio_stats.io_service_bytes_recursive.*.op")) {
+            snprintf(parse->blkio_op, sizeof(parse->blkio_op), "%s", value);
+        }
+    } else if (event == JSON_SCAN_OBJECT_END && depth == 3) {
+        if (json_scan_match(scan, "blkio_stats.io_service_bytes_recursive.*")) {
+            if (strcasecmp(parse->blkio_op, "read") == 0) {
+                stats->block_read_bytes += parse->blkio_value;
+            } else if (strcasecmp(parse->blkio_op, "write") == 0) {
+                stats->block_write_bytes += parse->blkio_value;
+            }
+            parse->blkio_op[0] = '\0';
+            parse->blkio_value = 0;
         }
     }
-    
-    json_object_put(root);
-    return count;
 }
 
-int docker_parse_container_stats(const char *json_data, container_stats_t *stats) {
-    json_object *root, *cpu_stats, *memory_stats, *networks, *blkio_stats;
-    json_object *cpu_usage, *memory_usage, *memory_limit;
+/* one event is small, but a busy daemon sends a stream of them; scanning
+   keeps event handling free of allocations like the other parsers */
+static void scan_event(void *ctx, const json_scan_t *scan, json_scan_event_t event,
+                       const char *value, size_t len) {
+    event_scan_t *parse = ctx;
+    docker_event_t *out = parse->event;
+    int depth = json_scan_depth(scan);
+    
+    if (depth == 1) {
+        const char *key = json_scan_key(scan, 0);
+        
+        if (event == JSON_SCAN_NUMBER && strcmp(key, "time") == 0) {
+            out->time = json_scan_i64(value, len);
+        } else if (event != JSON_SCAN_STRING) {
+            return;
+        } else if (strcmp(key, "Type") == 0) {
+            parse->other_type = strcmp(value, "container") != 0;
+        } else if (strcmp(key, "Action") == 0) {
+            snprintf(parse->action, sizeof(parse->action), "%s", value);
+            parse->has_action = 1;
+        } else if (strcmp(key, "status") == 0) {
+            snprintf(parse->status, sizeof(parse->status), "%s", value);
+        } else if (strcmp(key, "id") == 0) {
+            snprintf(parse->id, sizeof(parse->id), "%s", value);
+        } else if (strcmp(key, "from") == 0) {
+            snprintf(parse->from, sizeof(parse->from), "%s", value);
+        }
+    } else if (event != JSON_SCAN_STRING || strcmp(json_scan_key(scan, 0), "Actor") != 0) {
+        return;
+    } else if (depth == 2 && strcmp(json_scan_key(scan, 1), "ID") == 0) {
+        snprintf(out->id, sizeof(out->id), "%s", value);
+    } else if (depth == 3 && strcmp(json_scan_key(scan, 1), "Attributes") == 0) {
+        /* the actor attributes carry the container labels next to name and image */
+        const char *key = json_scan_key(scan, 2);
+        
+        if (strcmp(key, "name") == 0) {
+            snprintf(out->name, sizeof(out->name), "%s", value[0] == '/' ? value + 1 : value);
+        } else if (strcmp(key, "image") == 0) {
+            snprintf(out->image, sizeof(out->image), "%s", value);
+        }
+        if (parse->filter) {
+            parse->labels |= container_filter_label(parse->filter, key, value);
+        }
+    }
+}
+
+int docker_parse_container_stats(const char *json_data, size_t len, container_stats_t *stats) {
+    json_scan_t scan;
+    stats_scan_t parse;
     
     if (!json_data || !stats) {
         print_error("Некорректные параметры для парсинга статистики");
         return -1;
     }
     
-    root = json_tokener_parse(json_data);
-    if (!root) {
+    uint64_t start = stage_now();
+    memset(stats, 0, sizeof(container_stats_t));
+    memset(&parse, 0, sizeof(parse));
+    parse.stats = stats;
+    
+    json_scan_init(&scan, scan_container_stats, &parse);
+    if (json_scan_feed(&scan, json_data, len) != 0 || json_scan_finish(&scan) != 0) {
         print_error("Ошибка парсинга JSON статистики");
         return -1;
     }
     
-    memset(stats, 0, sizeof(container_stats_t));
     stats->timestamp = time(NULL);
+    stats->sample_ns = monotonic_ns();
     
-    if (json_object_object_get_ex(root, "cpu_stats", &cpu_stats) && cpu_stats &&
-        json_object_object_get_ex(cpu_stats, "cpu_usage", &cpu_usage) && cpu_usage) {
-        
-        json_object *total_usage, *system_cpu_usage;
-        if (json_object_object_get_ex(cpu_usage, "total_usage", &total_usage) && total_usage) {
-            stats->cpu_usage = json_object_get_uint64(total_usage);
-        }
-        if (json_object_object_get_ex(cpu_stats, "system_cpu_usage", &system_cpu_usage) && system_cpu_usage) {
-            stats->cpu_system_usage = json_object_get_uint64(system_cpu_usage);
-        }
+    /* cgroup v2 reports inactive_file, v1 total_inactive_file */
+    stats->memory_inactive_file = parse.inactive_file ? parse.inactive_file : parse.total_inactive_file;
+    if (stats->online_cpus == 0) {
+        stats->online_cpus = parse.percpu_count;
     }
     
-    if (json_object_object_get_ex(root, "memory_stats", &memory_stats) && memory_stats) {
-        if (json_object_object_get_ex(memory_stats, "usage", &memory_usage) && memory_usage) {
-            stats->memory_usage = json_object_get_uint64(memory_usage);
-        }
-        if (json_object_object_get_ex(memory_stats, "limit", &memory_limit) && memory_limit) {
-            stats->memory_limit = json_object_get_uint64(memory_limit);
-        }
+    stage_record(STAGE_PARSE_STATS, start);
+    return 0;
+}
+
+int docker_parse_event(const char *json_data, const container_filter_t *filter, docker_event_t *event) {
+    json_scan_t scan;
+    event_scan_t parse;
+    
+    if (!json_data || !event) {
+        return -1;
     }
     
-    if (json_object_object_get_ex(root, "networks", &networks) && networks) {
-        json_object *eth0;
-        if (json_object_object_get_ex(networks, "eth0", &eth0) && eth0) {
-            json_object *rx_bytes, *tx_bytes;
-            if (json_object_object_get_ex(eth0, "rx_bytes", &rx_bytes) && rx_bytes) {
-                stats->network_rx_bytes = json_object_get_uint64(rx_bytes);
-            }
-            if (json_object_object_get_ex(eth0, "tx_bytes", &tx_bytes) && tx_bytes) {
-                stats->network_tx_bytes = json_object_get_uint64(tx_bytes);
-            }
-        }
+    memset(event, 0, sizeof(docker_event_t));
+    memset(&parse, 0, sizeof(parse));
+    parse.event = event;
+    parse.filter = filter;
+    
+    json_scan_init(&scan, scan_event, &parse);
+    if (json_scan_feed(&scan, json_data, strlen(json_data)) != 0 || json_scan_finish(&scan) != 0) {
+        print_error("Ошибка парсинга JSON события");
+        return -1;
     }
     
-    json_object_put(root);
+    if (parse.other_type) {
+        memset(event, 0, sizeof(docker_event_t));
+        event->type = DOCKER_EVENT_OTHER;
+        return 0;
+    }
+    
+    const char *action = parse.has_action ? parse.action : parse.status;
+    
+    event->type = DOCKER_EVENT_OTHER;
+    if (strcmp(action, "start") == 0) event->type = DOCKER_EVENT_START;
+    else if (strcmp(action, "die") == 0) event->type = DOCKER_EVENT_DIE;
+    else if (strcmp(action, "destroy") == 0) event->type = DOCKER_EVENT_DESTROY;
+    else if (strcmp(action, "rename") == 0) event->type = DOCKER_EVENT_RENAME;
+    else if (strcmp(action, "pause") == 0) event->type = DOCKER_EVENT_PAUSE;
+    else if (strcmp(action, "unpause") == 0) event->type = DOCKER_EVENT_UNPAUSE;
+    
+    if (!event->id[0]) {
+        snprintf(event->id, sizeof(event->id), "%s", parse.id);
+    }
+    if (!event->image[0]) {
+        snprintf(event->image, sizeof(event->image), "%s", parse.from);
+    }
+    if (!event->time) {
+        event->time = time(NULL);
+    }
+    
+    event->selected = 1;
+    if (filter) {
+        container_info_t info;
+        
+        memset(&info, 0, sizeof(info));
+        snprintf(info.id, sizeof(info.id), "%s", event->id);
+        snprintf(info.name, sizeof(info.name), "%s", event->name);
+        snprintf(info.image, sizeof(info.image), "%s", event->image);
+        event->selected = container_filter_match(filter, &info, parse.labels);
+    }
+    
+    if (!event->id[0]) {
+        event->type = DOCKER_EVENT_OTHER;
+    }
     return 0;
 }
 
 char *format_bytes(uint64_t bytes) {
-    static char buffer[32];
+    /* a few rotating buffers so several values can be formatted in one printf */
+    static char buffers[8][32];
+    static int next_buffer = 0;
+    char *buffer = buffers[next_buffer++ % 8];
     const char *units[] = {"B", "KB", "MB", "GB", "TB"};
     int unit_index = 0;
     double size = bytes;
@@ -430,17 +627,19 @@ char *format_bytes(uint64_t bytes) {
     }
     
     if (unit_index == 0) {
-        snprintf(buffer, sizeof(buffer), "%lu %s", bytes, units[unit_index]);
+        snprintf(buffer, sizeof(buffers[0]), "%lu %s", bytes, units[unit_index]);
     } else {
-        snprintf(buffer, sizeof(buffer), "%.2f %s", size, units[unit_index]);
+        snprintf(buffer, sizeof(buffers[0]), "%.2f %s", size, units[unit_index]);
     }
     
     return buffer;
 }
 
 char *format_percentage(double value) {
-    static char buffer[16];
-    snprintf(buffer, sizeof(buffer), "%.2f%%", value);
+    static char buffers[4][16];
+    static int next_buffer = 0;
+    char *buffer = buffers[next_buffer++ % 4];
+    snprintf(buffer, sizeof(buffers[0]), "%.2f%%", value);
     return buffer;
 }
 
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/docker_events.h"
+#include "../include/docker_api.h"
+
+struct docker_events {
+    docker_client_t *client;
+    int host;
+    http_stream_t http;
+    int connected;
+    monitor_state_t *state;
+    int changes;
+    int want_resync;
+};
+
+static void handle_event_line(void *ctx, char *line, size_t len);
+static void disconnect(docker_events_t *events);
+
+docker_events_t *docker_events_create(struct docker_client *client, int host) {
+    docker_events_t *events = calloc(1, sizeof(docker_events_t));
+    if (events) {
+        events->client = client;
+        events->host = host;
+        events->http.fd = -1;
+    }
+    return events;
+}
+
+void docker_events_destroy(docker_events_t *events) {
+    if (!events) {
+        return;
+    }
+    
+    disconnect(events);
+    free(events);
+}
+
+int docker_events_connect(docker_events_t *events) {
+    disconnect(events);
+    
+    if (docker_open_event_stream(events->client, &events->http) != 0) {
+        return -1;
+    }
+    
+    events->connected = 1;
+    return 0;
+}
+
+int docker_events_poll(docker_events_t *events, monitor_state_t *state) {
+    if (!events->connected) {
+        return -1;
+    }
+    
+    events->state = state;
+    events->changes = 0;
+    
+    if (http_stream_read(&events->http, handle_event_line, events) != 0) {
+        disconnect(events);
+        return -1;
+    }
+    
+    if (events->changes > 0) {
+        state->last_update = time(NULL);
+    }
+    
+    return events->changes;
+}
+
+int docker_events_want_resync(docker_events_t *events) {
+    int want = events->want_resync;
+    
+    events->want_resync = 0;
+    return want;
+}
+
+static void handle_event_line(void *ctx, char *line, size_t len) {
+    docker_events_t *events = ctx;
+    monitor_state_t *state = events->state;
+    container_monitor_t *container;
+    docker_event_t event;
+    
+    (void)len;
+    if (docker_parse_event(line, docker_client_filter(events->client), &event) != 0) {
+        return;
+    }
+    
+    switch (event.type) {
+    case DOCKER_EVENT_START:
+        container = monitor_find_container(state, events->host, event.id);
+        if (!container && !event.selected) {
+            return;
+        }
+        if (!container) {
+            container_info_t info;
+            
+            memset(&info, 0, sizeof(info));
+            snprintf(info.id, sizeof(info.id), "%s", event.id);
+            snprintf(info.name, sizeof(info.name), "%s", event.name[0] ? event.name : "unknown");
+            snprintf(info.image, sizeof(info.image), "%s", event.image);
+            info.created = event.time;
+            info.host = events->host;
+            container = monitor_add_container(state, &info);
+        }
+        if (container) {
+            snprintf(container->info.status, sizeof(container->info.status), "Up");
+            container->info.last_seen = event.time;
+        }
+        break;
+    case DOCKER_EVENT_DIE:
+    case DOCKER_EVENT_DESTROY:
+        monitor_remove_container(state, events->host, event.id);
+        break;
+    case DOCKER_EVENT_RENAME:
+        if (!event.selected) {
+            monitor_remove_container(state, events->host, event.id);
+            break;
+        }
+        container = monitor_find_container(state, events->host, event.id);
+        /* the event does not say whether a container renamed into the
+           selection is running, so the list is fetched again */
+        if (!container && docker_client_filter(events->client)) {
+            events->want_resync = 1;
+            return;
+        }
+        if (container && event.name[0]) {
+            snprintf(container->info.name, sizeof(container->info.name), "%s", event.name);
+        }
+        break;
+    case DOCKER_EVENT_PAUSE:
+    case DOCKER_EVENT_UNPAUSE:
+        container = monitor_find_container(state, events->host, event.id);
+        if (container) {
+            snprintf(container->info.status, sizeof(container->info.status), "%s",
+                     event.type == DOCKER_EVENT_PAUSE ? "Up (Paused)" : "Up");
+        }
+        break;
+    default:
+        return;
+    }
+    
+    events->changes++;
+}
+
+static void disconnect(docker_events_t *events) {
+    if (events->connected) {
+        http_stream_close(&events->http);
+        events->connected = 0;
+    }
+}
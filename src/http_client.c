@@ -0,0 +1,961 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include "../include/http_client.h"
+#include "../include/docker_api.h"
+#include "../include/resolver.h"
+#include "../include/tls_client.h"
+#include "../include/stage_timer.h"
+
+#define HTTP_READ_CHUNK 4096
+#define HTTP_MAX_CHUNK_LINE 64
+
+enum {
+    HTTP_OK = 0,
+    HTTP_ERR_IO = -1,
+    HTTP_ERR_STATUS = -2
+};
+
+static int connect_unix(const char *path, char *error, size_t error_size);
+static int connect_tcp(http_pool_t *pool, char *error, size_t error_size);
+static int connect_addr(const resolver_addr_t *addr, int timeout_ms);
+static void set_timeout(int fd, int timeout_ms);
+static int open_transport(http_pool_t *pool, struct ssl_st **ssl, char *error, size_t error_size);
+static int backoff_admit(http_pool_t *pool);
+static void backoff_result(http_pool_t *pool, int ok, int probe, const char *error);
+static http_conn_t *pool_acquire(http_pool_t *pool, int *reused, char *error, size_t error_size);
+static void pool_release(http_pool_t *pool, http_conn_t *conn, int keep_alive);
+static void close_transport(int *fd, struct ssl_st **ssl);
+static int conn_is_alive(const http_conn_t *conn);
+static int send_all(int fd, struct ssl_st *ssl, const char *data, size_t len);
+static int read_response(http_conn_t *conn, http_response_t *response, int *got_data, uint64_t sent);
+static int ensure_capacity(char **buffer, size_t *capacity, size_t needed);
+
+int http_pool_init(http_pool_t *pool, const char *host, int port, const char *unix_path) {
+    memset(pool, 0, sizeof(http_pool_t));
+    
+    strncpy(pool->host, host, sizeof(pool->host) - 1);
+    pool->port = port;
+    pool->connect_timeout_ms = HTTP_CONNECT_TIMEOUT_MS;
+    pool->io_timeout_ms = HTTP_IO_TIMEOUT_MS;
+    if (unix_path) {
+        strncpy(pool->unix_path, unix_path, sizeof(pool->unix_path) - 1);
+    }
+    
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        pool->conns[i].fd = -1;
+    }
+    
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->available, NULL);
+    
+    if (!unix_path) {
+        pool->resolver = resolver_create(host, port);
+        if (!pool->resolver) {
+            http_pool_cleanup(pool);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void http_pool_cleanup(http_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        close_transport(&pool->conns[i].fd, &pool->conns[i].ssl);
+        free(pool->conns[i].buffer);
+        pool->conns[i].buffer = NULL;
+        pool->conns[i].capacity = 0;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    tls_client_destroy(pool->tls);
+    pool->tls = NULL;
+    resolver_destroy(pool->resolver);
+    pool->resolver = NULL;
+    pthread_cond_destroy(&pool->available);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+void http_pool_set_timeouts(http_pool_t *pool, int connect_ms, int io_ms) {
+    if (connect_ms > 0) {
+        pool->connect_timeout_ms = connect_ms;
+    }
+    if (io_ms > 0) {
+        pool->io_timeout_ms = io_ms;
+    }
+}
+
+int http_pool_enable_tls(http_pool_t *pool, const char *ca_path, const char *cert_path, const char *key_path) {
+    pool->tls = tls_client_create(pool->host, ca_path, cert_path, key_path);
+    return pool->tls ? 0 : -1;
+}
+
+int http_pool_connect(http_pool_t *pool, struct ssl_st **ssl) {
+    char error[256];
+    int probe = backoff_admit(pool);
+    int fd;
+    
+    *ssl = NULL;
+    if (probe < 0) {
+        return -1;
+    }
+    
+    fd = open_transport(pool, ssl, error, sizeof(error));
+    backoff_result(pool, fd != -1, probe, error);
+    return fd;
+}
+
+int http_pool_prime(http_pool_t *pool) {
+    struct ssl_st *ssl;
+    int fd = http_pool_connect(pool, &ssl);
+    if (fd == -1) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->conns[0].fd = fd;
+    pool->conns[0].ssl = ssl;
+    pool->stats.connects++;
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void http_pool_get_stats(http_pool_t *pool, http_pool_stats_t *stats) {
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int http_format_request(const http_pool_t *pool, const char *method, const char *path,
+                        char *buffer, size_t size) {
+    int len;
+    
+    if (pool->unix_path[0]) {
+        len = snprintf(buffer, size,
+                       "%s %s HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "\r\n",
+                       method, path);
+    } else {
+        /* an IPv6 address goes in brackets, as in a URL */
+        const char *format = strchr(pool->host, ':') ? "%s %s HTTP/1.1\r\n"
+                                                       "Host: [%s]:%d\r\n"
+                                                       "\r\n"
+                                                     : "%s %s HTTP/1.1\r\n"
+                                                       "Host: %s:%d\r\n"
+                                                       "\r\n";
+        len = snprintf(buffer, size, format, method, path, pool->host, pool->port);
+    }
+    
+    if (len < 0 || (size_t)len >= size) {
+        return -1;
+    }
+    return len;
+}
+
+int http_pool_request(http_pool_t *pool, const char *method, const char *path, http_response_t *response) {
+    char request[HTTP_REQUEST_SIZE];
+    int request_len = http_format_request(pool, method, path, request, sizeof(request));
+    
+    memset(response, 0, sizeof(http_response_t));
+    if (request_len < 0) {
+        return -1;
+    }
+    
+    int probe = backoff_admit(pool);
+    if (probe < 0) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.requests++;
+    pthread_mutex_unlock(&pool->lock);
+    
+    char error[256];
+    int result = HTTP_ERR_IO;
+    int unreachable = 0;
+    
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int reused = 0;
+        int got_data = 0;
+        int timed_out;
+        http_conn_t *conn = pool_acquire(pool, &reused, error, sizeof(error));
+        
+        if (!conn) {
+            unreachable = 1;
+            break;
+        }
+        
+        conn->keep_alive = 0;
+        uint64_t sent = stage_now();
+        /* the liveness probe leaves EAGAIN behind; only a timeout may set it now */
+        errno = 0;
+        if (send_all(conn->fd, conn->ssl, request, request_len) == 0) {
+            result = read_response(conn, response, &got_data, sent);
+        } else {
+            result = HTTP_ERR_IO;
+        }
+        timed_out = result == HTTP_ERR_IO && (errno == EAGAIN || errno == EWOULDBLOCK);
+        
+        /* on success the connection stays checked out until the caller is done with the body */
+        if (result == HTTP_OK) {
+            backoff_result(pool, 1, probe, NULL);
+            response->conn = conn;
+            return 0;
+        }
+        
+        pool_release(pool, conn, result != HTTP_ERR_IO && conn->keep_alive);
+        
+        /* a daemon that stopped answering is not asked twice */
+        if (timed_out) {
+            pthread_mutex_lock(&pool->lock);
+            pool->stats.timeouts++;
+            pthread_mutex_unlock(&pool->lock);
+            snprintf(error, sizeof(error), "нет ответа за %.1f с", pool->io_timeout_ms / 1000.0);
+            unreachable = 1;
+            break;
+        }
+        
+        /* an idle keep-alive connection may have been closed by the daemon */
+        if (result == HTTP_ERR_IO && reused && !got_data) {
+            pthread_mutex_lock(&pool->lock);
+            pool->stats.retries++;
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+        break;
+    }
+    
+    /* an error status or a broken response still means the daemon is there */
+    backoff_result(pool, !unreachable, probe, error);
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.failures++;
+    pthread_mutex_unlock(&pool->lock);
+    return -1;
+}
+
+void http_response_release(http_pool_t *pool, http_response_t *response) {
+    http_conn_t *conn = response->conn;
+    
+    if (!conn) {
+        return;
+    }
+    
+    /* a large buffer is kept while large responses (a big container list
+       every tick) keep arriving, so they are not reallocated each time, but
+       one huge response does not pin it for the lifetime of the pool */
+    if (conn->capacity > HTTP_MAX_IDLE_BUFFER) {
+        time_t now = time(NULL);
+        
+        if (response->len >= HTTP_MAX_IDLE_BUFFER / 2) {
+            conn->large_used = now;
+        } else if (now - conn->large_used > HTTP_IDLE_BUFFER_SECONDS) {
+            free(conn->buffer);
+            conn->buffer = NULL;
+            conn->capacity = 0;
+        }
+    }
+    
+    pool_release(pool, conn, conn->keep_alive);
+    memset(response, 0, sizeof(http_response_t));
+}
+
+static int connect_unix(const char *path, char *error, size_t error_size) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    
+    if (fd == -1) {
+        snprintf(error, error_size, "%s", strerror(errno));
+        return -1;
+    }
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        snprintf(error, error_size, "%s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* addresses are tried in turn, each with an equal share of what is left of
+   the timeout, so a blackholed IPv6 route still leaves time for IPv4 */
+static int connect_tcp(http_pool_t *pool, char *error, size_t error_size) {
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    uint64_t deadline = stage_now() + (uint64_t)pool->connect_timeout_ms * 1000000ULL;
+    int count = resolver_lookup(pool->resolver, pool->connect_timeout_ms, addrs, RESOLVER_MAX_ADDRS,
+                                error, error_size);
+    
+    for (int i = 0; i < count; i++) {
+        char address[INET6_ADDRSTRLEN] = "?";
+        uint64_t now = stage_now();
+        int slice_ms = now < deadline ? (int)((deadline - now) / 1000000ULL / (count - i)) : 0;
+        int fd = connect_addr(&addrs[i], slice_ms);
+        
+        if (fd != -1) {
+            resolver_prefer(pool->resolver, &addrs[i]);
+            return fd;
+        }
+        
+        int saved = errno;
+        getnameinfo((const struct sockaddr *)&addrs[i].addr, addrs[i].len, address, sizeof(address),
+                    NULL, 0, NI_NUMERICHOST);
+        if (saved == ETIMEDOUT) {
+            snprintf(error, error_size, "%s: нет соединения за %.1f с", address, pool->connect_timeout_ms / 1000.0);
+        } else {
+            snprintf(error, error_size, "%s: %s", address, strerror(saved));
+        }
+    }
+    
+    return -1;
+}
+
+static int connect_addr(const resolver_addr_t *addr, int timeout_ms) {
+    int fd = socket(addr->addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    int err = 0;
+    
+    if (fd == -1) {
+        return -1;
+    }
+    
+    if (connect(fd, (const struct sockaddr *)&addr->addr, addr->len) == -1) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        socklen_t len = sizeof(err);
+        int ready;
+        
+        err = errno;
+        if (err == EINPROGRESS) {
+            do {
+                ready = poll(&pfd, 1, timeout_ms);
+            } while (ready < 0 && errno == EINTR);
+            
+            if (ready == 0) {
+                err = ETIMEDOUT;
+            } else if (ready < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1) {
+                err = errno;
+            }
+        }
+    }
+    
+    /* blocking from here on; SO_RCVTIMEO/SO_SNDTIMEO bound every wait */
+    if (!err && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) == -1) {
+        err = errno;
+    }
+    if (err) {
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    
+    return fd;
+}
+
+static void set_timeout(int fd, int timeout_ms) {
+    struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/* the TLS handshake counts against the connect timeout, everything after
+   it against the I/O timeout; the connect stage covers both */
+static int open_transport(http_pool_t *pool, struct ssl_st **ssl, char *error, size_t error_size) {
+    uint64_t start = stage_now();
+    int fd = pool->unix_path[0] ? connect_unix(pool->unix_path, error, error_size)
+                                : connect_tcp(pool, error, error_size);
+    int resumed = 0;
+    
+    *ssl = NULL;
+    if (fd == -1) {
+        return -1;
+    }
+    
+    if (pool->tls) {
+        set_timeout(fd, pool->connect_timeout_ms);
+        *ssl = tls_client_connect(pool->tls, fd, &resumed);
+        if (!*ssl) {
+            snprintf(error, error_size, "ошибка рукопожатия TLS");
+            close(fd);
+            return -1;
+        }
+        
+        pthread_mutex_lock(&pool->lock);
+        pool->stats.tls_handshakes++;
+        if (resumed) {
+            pool->stats.tls_resumed++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    set_timeout(fd, pool->io_timeout_ms);
+    
+    stage_record(STAGE_CONNECT, start);
+    return fd;
+}
+
+/* 0 to go ahead, 1 when the caller is the single probe after a rest, -1
+   while the host rests */
+static int backoff_admit(http_pool_t *pool) {
+    int admit = 0;
+    
+    pthread_mutex_lock(&pool->lock);
+    if (pool->failures_in_row > 0) {
+        if (pool->probing || stage_now() < pool->retry_at) {
+            pool->stats.skipped++;
+            admit = -1;
+        } else {
+            pool->probing = 1;
+            admit = 1;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return admit;
+}
+
+/* only the first failure and failed probes lengthen the rest; requests that
+   were already under way when the host went down do not */
+static void backoff_result(http_pool_t *pool, int ok, int probe, const char *error) {
+    char name[384];
+    char message[768];
+    int report = 0;
+    int rest_ms = 0;
+    
+    pthread_mutex_lock(&pool->lock);
+    if (probe) {
+        pool->probing = 0;
+    }
+    if (ok) {
+        report = probe && pool->failures_in_row > 0;
+        pool->failures_in_row = 0;
+    } else if (probe || pool->failures_in_row == 0) {
+        int shift = pool->failures_in_row < 5 ? pool->failures_in_row : 5;
+        
+        rest_ms = HTTP_BACKOFF_MIN_MS << shift;
+        if (rest_ms > HTTP_BACKOFF_MAX_MS) {
+            rest_ms = HTTP_BACKOFF_MAX_MS;
+        }
+        pool->failures_in_row++;
+        pool->retry_at = stage_now() + (uint64_t)rest_ms * 1000000ULL;
+        report = pool->failures_in_row == 1;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    if (!report) {
+        return;
+    }
+    
+    /* one line when a host goes away and one when it is back */
+    if (pool->unix_path[0]) {
+        snprintf(name, sizeof(name), "%s", pool->unix_path);
+    } else {
+        snprintf(name, sizeof(name), strchr(pool->host, ':') ? "[%s]:%d" : "%s:%d", pool->host, pool->port);
+    }
+    if (ok) {
+        snprintf(message, sizeof(message), "Хост %s снова доступен", name);
+    } else {
+        snprintf(message, sizeof(message), "Хост %s недоступен (%s), повторные попытки с паузой до %d с",
+                 name, error, HTTP_BACKOFF_MAX_MS / 1000);
+    }
+    print_error(message);
+}
+
+static http_conn_t *pool_acquire(http_pool_t *pool, int *reused, char *error, size_t error_size) {
+    http_conn_t *conn = NULL;
+    
+    pthread_mutex_lock(&pool->lock);
+    while (!conn) {
+        http_conn_t *empty = NULL;
+        
+        for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+            if (pool->conns[i].in_use) continue;
+            if (pool->conns[i].fd != -1) {
+                conn = &pool->conns[i];
+                break;
+            }
+            if (!empty) empty = &pool->conns[i];
+        }
+        
+        if (!conn) conn = empty;
+        if (!conn) pthread_cond_wait(&pool->available, &pool->lock);
+    }
+    conn->in_use = 1;
+    pthread_mutex_unlock(&pool->lock);
+    
+    if (conn->fd != -1 && !conn_is_alive(conn)) {
+        close_transport(&conn->fd, &conn->ssl);
+    }
+    
+    *reused = conn->fd != -1;
+    if (conn->fd == -1) {
+        conn->fd = open_transport(pool, &conn->ssl, error, error_size);
+        if (conn->fd == -1) {
+            pool_release(pool, conn, 0);
+            return NULL;
+        }
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    if (*reused) {
+        pool->stats.reused++;
+    } else {
+        pool->stats.connects++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    
+    return conn;
+}
+
+static void pool_release(http_pool_t *pool, http_conn_t *conn, int keep_alive) {
+    if (!keep_alive) {
+        close_transport(&conn->fd, &conn->ssl);
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    conn->in_use = 0;
+    pthread_cond_signal(&pool->available);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void close_transport(int *fd, struct ssl_st **ssl) {
+    tls_close(*ssl);
+    *ssl = NULL;
+    if (*fd != -1) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static int conn_is_alive(const http_conn_t *conn) {
+    if (conn->ssl) {
+        return tls_idle_ok(conn->ssl, conn->fd);
+    }
+    
+    char probe;
+    ssize_t n = recv(conn->fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    
+    if (n == 0) {
+        return 0;
+    }
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    /* unsolicited bytes on an idle connection mean the framing is lost */
+    return 0;
+}
+
+static int send_all(int fd, struct ssl_st *ssl, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ssl ? tls_send(ssl, data, len) : send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int ensure_capacity(char **buffer, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+    
+    size_t new_capacity = *capacity ? *capacity : HTTP_READ_CHUNK;
+    while (new_capacity < needed) {
+        if (new_capacity > SIZE_MAX / 2) {
+            return -1;
+        }
+        new_capacity *= 2;
+    }
+    
+    char *new_buffer = realloc(*buffer, new_capacity);
+    if (!new_buffer) {
+        return -1;
+    }
+    
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static ssize_t recv_some(int fd, struct ssl_st *ssl, char *buffer, size_t len) {
+    ssize_t n;
+    
+    do {
+        n = ssl ? tls_recv(ssl, buffer, len) : recv(fd, buffer, len, 0);
+    } while (n < 0 && errno == EINTR);
+    
+    return n;
+}
+
+static ssize_t recv_more(int fd, struct ssl_st *ssl, char **buffer, size_t *capacity, size_t len) {
+    if (ensure_capacity(buffer, capacity, len + HTTP_READ_CHUNK + 1) != 0) {
+        return -1;
+    }
+    
+    return recv_some(fd, ssl, *buffer + len, *capacity - len - 1);
+}
+
+/* wait is the time from sending the request to the first byte back,
+   receive the rest of the response */
+static int read_response(http_conn_t *conn, http_response_t *response, int *got_data, uint64_t sent) {
+    size_t len = 0;
+    ssize_t n;
+    http_response_head_t head;
+    int head_state = 0;
+    
+    *got_data = 0;
+    
+    while (head_state == 0) {
+        n = recv_more(conn->fd, conn->ssl, &conn->buffer, &conn->capacity, len);
+        if (n <= 0) {
+            return HTTP_ERR_IO;
+        }
+        len += n;
+        if (!*got_data) {
+            sent = stage_record(STAGE_WAIT, sent);
+        }
+        *got_data = 1;
+        head_state = http_parse_response_head(conn->buffer, len, &head);
+    }
+    
+    if (head_state < 0) {
+        return HTTP_ERR_IO;
+    }
+    
+    /* the body is framed in place right after the head; nothing is copied out */
+    size_t body = head.header_size;
+    size_t end = len;
+    
+    if (head.chunked) {
+        http_chunk_decoder_t decoder;
+        size_t out = body;
+        int done = 0;
+        
+        http_chunk_decoder_init(&decoder);
+        while (!done) {
+            size_t produced, consumed;
+            done = http_chunk_decode(&decoder, conn->buffer + out, end - out, conn->buffer + out,
+                                     &produced, &consumed);
+            if (done < 0) {
+                return HTTP_ERR_IO;
+            }
+            
+            /* decoded data sits at out; close the gap left by the chunk framing */
+            memmove(conn->buffer + out + produced, conn->buffer + out + consumed, end - out - consumed);
+            end -= consumed - produced;
+            out += produced;
+            
+            if (!done) {
+                n = recv_more(conn->fd, conn->ssl, &conn->buffer, &conn->capacity, end);
+                if (n <= 0 || end + n - body > HTTP_MAX_BODY_SIZE) {
+                    return HTTP_ERR_IO;
+                }
+                end += n;
+            }
+        }
+        end = out;
+    } else if (head.content_length >= 0) {
+        /* the length comes from the daemon; never reserve more than a sane body */
+        if (head.content_length > HTTP_MAX_BODY_SIZE) {
+            return HTTP_ERR_IO;
+        }
+        size_t total = body + (size_t)head.content_length;
+        
+        if (ensure_capacity(&conn->buffer, &conn->capacity, total + 1) != 0) {
+            return HTTP_ERR_IO;
+        }
+        while (end < total) {
+            n = recv_some(conn->fd, conn->ssl, conn->buffer + end, total - end);
+            if (n <= 0) {
+                return HTTP_ERR_IO;
+            }
+            end += n;
+        }
+        end = total;
+    } else {
+        while ((n = recv_more(conn->fd, conn->ssl, &conn->buffer, &conn->capacity, end)) > 0) {
+            end += n;
+            if (end - body > HTTP_MAX_BODY_SIZE) {
+                return HTTP_ERR_IO;
+            }
+        }
+        head.keep_alive = 0;
+    }
+    
+    conn->buffer[end] = '\0';
+    conn->keep_alive = head.keep_alive;
+    stage_record(STAGE_RECEIVE, sent);
+    
+    if (head.status >= 400) {
+        return HTTP_ERR_STATUS;
+    }
+    
+    response->status = head.status;
+    response->body = conn->buffer + body;
+    response->len = end - body;
+    return HTTP_OK;
+}
+
+int http_stream_open(http_stream_t *stream, http_pool_t *pool, const char *path) {
+    char request[HTTP_REQUEST_SIZE];
+    int request_len = http_format_request(pool, "GET", path, request, sizeof(request));
+    
+    memset(stream, 0, sizeof(http_stream_t));
+    stream->fd = -1;
+    if (request_len < 0) {
+        return -1;
+    }
+    
+    stream->fd = http_pool_connect(pool, &stream->ssl);
+    if (stream->fd == -1) {
+        return -1;
+    }
+    
+    if (send_all(stream->fd, stream->ssl, request, request_len) != 0 ||
+        fcntl(stream->fd, F_SETFL, fcntl(stream->fd, F_GETFL) | O_NONBLOCK) == -1) {
+        http_stream_close(stream);
+        return -1;
+    }
+    
+    http_chunk_decoder_init(&stream->decoder);
+    return 0;
+}
+
+void http_stream_close(http_stream_t *stream) {
+    close_transport(&stream->fd, &stream->ssl);
+    free(stream->buffer);
+    stream->buffer = NULL;
+    stream->capacity = stream->len = stream->decoded = stream->raw = 0;
+}
+
+static void stream_emit_lines(http_stream_t *stream, http_line_cb cb, void *ctx) {
+    size_t start = 0;
+    char *nl;
+    
+    while ((nl = memchr(stream->buffer + start, '\n', stream->decoded - start))) {
+        size_t line_len = nl - (stream->buffer + start);
+        
+        *nl = '\0';
+        if (line_len > 0) {
+            cb(ctx, stream->buffer + start, line_len);
+        }
+        start += line_len + 1;
+    }
+    
+    if (start > 0) {
+        memmove(stream->buffer, stream->buffer + start, stream->len - start);
+        stream->len -= start;
+        stream->decoded -= start;
+        stream->raw -= start;
+    }
+}
+
+int http_stream_read(http_stream_t *stream, http_line_cb cb, void *ctx) {
+    for (;;) {
+        ssize_t n = recv_more(stream->fd, stream->ssl, &stream->buffer, &stream->capacity, stream->len);
+        
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        if (n == 0) {
+            return -1;
+        }
+        stream->len += n;
+        
+        if (!stream->head_done) {
+            int state = http_parse_response_head(stream->buffer, stream->len, &stream->head);
+            if (state < 0) return -1;
+            if (state == 0) continue;
+            if (stream->head.status >= 400) return -1;
+            
+            stream->len -= stream->head.header_size;
+            memmove(stream->buffer, stream->buffer + stream->head.header_size, stream->len);
+            stream->head_done = 1;
+        }
+        
+        if (stream->head.chunked) {
+            size_t produced, consumed;
+            int done = http_chunk_decode(&stream->decoder, stream->buffer + stream->raw, stream->len - stream->raw,
+                                         stream->buffer + stream->decoded, &produced, &consumed);
+            if (done < 0) {
+                return -1;
+            }
+            
+            stream->decoded += produced;
+            stream->raw += consumed;
+            memmove(stream->buffer + stream->decoded, stream->buffer + stream->raw, stream->len - stream->raw);
+            stream->len = stream->decoded + (stream->len - stream->raw);
+            stream->raw = stream->decoded;
+            
+            stream_emit_lines(stream, cb, ctx);
+            if (done) {
+                return -1;
+            }
+        } else {
+            stream->decoded = stream->raw = stream->len;
+            stream_emit_lines(stream, cb, ctx);
+        }
+        
+        if (stream->decoded > HTTP_MAX_STREAM_LINE) {
+            return -1;
+        }
+    }
+}
+
+int http_parse_response_head(const char *data, size_t len, http_response_head_t *head) {
+    const char *end = memmem(data, len, "\r\n\r\n", 4);
+    const char *line;
+    
+    if (!end) {
+        return len > HTTP_MAX_HEADER_SIZE ? -1 : 0;
+    }
+    
+    memset(head, 0, sizeof(http_response_head_t));
+    head->content_length = -1;
+    head->keep_alive = 1;
+    head->header_size = end - data + 4;
+    
+    if (end - data < 12 || strncmp(data, "HTTP/1.", 7) != 0) {
+        return -1;
+    }
+    if (data[7] == '0') {
+        head->keep_alive = 0;
+    }
+    head->status = atoi(data + 9);
+    
+    line = memchr(data, '\n', end - data);
+    while (line && line < end) {
+        const char *start = line + 1;
+        const char *next = memchr(start, '\n', end + 2 - start);
+        size_t line_len = (next ? next : end + 2) - start;
+        
+        if (line_len > 15 && strncasecmp(start, "Content-Length:", 15) == 0) {
+            head->content_length = strtoll(start + 15, NULL, 10);
+        } else if (line_len > 18 && strncasecmp(start, "Transfer-Encoding:", 18) == 0) {
+            if (memmem(start + 18, line_len - 18, "chunked", 7)) {
+                head->chunked = 1;
+            }
+        } else if (line_len > 11 && strncasecmp(start, "Connection:", 11) == 0) {
+            if (memmem(start + 11, line_len - 11, "close", 5)) {
+                head->keep_alive = 0;
+            } else if (memmem(start + 11, line_len - 11, "keep-alive", 10)) {
+                head->keep_alive = 1;
+            }
+        }
+        
+        line = next;
+    }
+    
+    if (head->status == 204 || head->status == 304) {
+        head->content_length = 0;
+    }
+    
+    return 1;
+}
+
+void http_chunk_decoder_init(http_chunk_decoder_t *dec) {
+    dec->state = HTTP_CHUNK_SIZE;
+    dec->remaining = 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int http_chunk_decode(http_chunk_decoder_t *dec, const char *in, size_t in_len,
+                      char *out, size_t *produced, size_t *consumed) {
+    size_t ip = 0;
+    size_t op = 0;
+    
+    while (ip < in_len && dec->state != HTTP_CHUNK_DONE) {
+        const char *nl;
+        
+        switch (dec->state) {
+        case HTTP_CHUNK_SIZE: {
+            uint64_t size = 0;
+            int digits = 0;
+            
+            nl = memchr(in + ip, '\n', in_len - ip);
+            if (!nl) {
+                if (in_len - ip > HTTP_MAX_CHUNK_LINE) return -1;
+                goto out;
+            }
+            
+            for (const char *p = in + ip; p < nl && hex_value(*p) >= 0; p++) {
+                if (++digits > 15) return -1;
+                size = size * 16 + hex_value(*p);
+            }
+            if (digits == 0) return -1;
+            
+            ip = nl - in + 1;
+            dec->remaining = size;
+            dec->state = size ? HTTP_CHUNK_DATA : HTTP_CHUNK_TRAILER;
+            break;
+        }
+        case HTTP_CHUNK_DATA: {
+            size_t n = in_len - ip;
+            if (n > dec->remaining) n = dec->remaining;
+            
+            memmove(out + op, in + ip, n);
+            op += n;
+            ip += n;
+            dec->remaining -= n;
+            if (dec->remaining == 0) {
+                dec->state = HTTP_CHUNK_DATA_END;
+            }
+            break;
+        }
+        case HTTP_CHUNK_DATA_END:
+            nl = memchr(in + ip, '\n', in_len - ip);
+            if (!nl) {
+                if (in_len - ip > 2) return -1;
+                goto out;
+            }
+            ip = nl - in + 1;
+            dec->state = HTTP_CHUNK_SIZE;
+            break;
+        case HTTP_CHUNK_TRAILER: {
+            size_t line_len;
+            
+            nl = memchr(in + ip, '\n', in_len - ip);
+            if (!nl) {
+                if (in_len - ip > HTTP_MAX_HEADER_SIZE) return -1;
+                goto out;
+            }
+            line_len = nl - (in + ip);
+            ip = nl - in + 1;
+            if (line_len == 0 || (line_len == 1 && in[ip - 2] == '\r')) {
+                dec->state = HTTP_CHUNK_DONE;
+            }
+            break;
+        }
+        }
+    }
+
+out:
+    *produced = op;
+    *consumed = ip;
+    return dec->state == HTTP_CHUNK_DONE ? 1 : 0;
+}
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "../include/json_output.h"
+#include "../include/stage_timer.h"
+#include "../include/top_k.h"
+#include "../include/alloc_stats.h"
+
+#define JSON_BYTES_PER_CONTAINER 640
+
+static void render_summary_record(text_buffer_t *buffer, const monitor_state_t *state, int host, top_k_t *top);
+static void render_container_record(text_buffer_t *buffer, const monitor_state_t *state,
+                                    const container_monitor_t *container, int rank);
+static void append_key(text_buffer_t *buffer, const char *key);
+static int write_all(int fd, const char *data, size_t len);
+
+int json_output_init(json_output_t *out, int fd) {
+    out->fd = fd;
+    return text_buffer_init(&out->buffer, 64 * 1024);
+}
+
+void json_output_free(json_output_t *out) {
+    text_buffer_free(&out->buffer);
+}
+
+int json_output_write_tick(json_output_t *out, const monitor_state_t *state, int summary_only, top_k_t *top) {
+    text_buffer_t *buffer = &out->buffer;
+    
+    text_buffer_reset(buffer);
+    if (top) {
+        const int *slots;
+        
+        top_k_reset(top);
+        json_output_render_summary(buffer, state, top);
+        int count = top_k_sorted(top, &slots);
+        for (int i = 0; i < count; i++) {
+            render_container_record(buffer, state, &state->containers[slots[i]], i + 1);
+        }
+    } else if (summary_only) {
+        json_output_render_summary(buffer, state, NULL);
+    } else {
+        text_buffer_reserve(buffer, (size_t)state->container_count * JSON_BYTES_PER_CONTAINER);
+        for (int i = 0; i < state->container_slots; i++) {
+            if (state->containers[i].in_use) {
+                json_output_render_container(buffer, state, &state->containers[i]);
+            }
+        }
+    }
+    
+    if (buffer->failed) {
+        return -1;
+    }
+    return write_all(out->fd, buffer->data, buffer->len);
+}
+
+int json_output_write_stages(json_output_t *out, time_t timestamp) {
+    text_buffer_t *buffer = &out->buffer;
+    
+    text_buffer_reset(buffer);
+    text_buffer_append(buffer, "{\"timestamp\":", 13);
+    text_buffer_append_i64(buffer, timestamp);
+    text_buffer_append_str(buffer, ",\"stages\":{");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        stage_summary_t summary;
+        
+        stage_summarize(stage, &summary);
+        if (stage > 0) {
+            text_buffer_append(buffer, ",", 1);
+        }
+        json_output_append_string(buffer, stage_name(stage));
+        text_buffer_append_str(buffer, ":{\"count\":");
+        text_buffer_append_u64(buffer, summary.count);
+        append_key(buffer, "mean_us");
+        text_buffer_append_fixed(buffer, summary.mean_ns / 1e3, 1);
+        append_key(buffer, "p50_us");
+        text_buffer_append_fixed(buffer, summary.p50_ns / 1e3, 1);
+        append_key(buffer, "p90_us");
+        text_buffer_append_fixed(buffer, summary.p90_ns / 1e3, 1);
+        append_key(buffer, "p99_us");
+        text_buffer_append_fixed(buffer, summary.p99_ns / 1e3, 1);
+        append_key(buffer, "max_us");
+        text_buffer_append_fixed(buffer, summary.max_ns / 1e3, 1);
+        text_buffer_append(buffer, "}", 1);
+    }
+    
+    alloc_stats_t allocs;
+    
+    alloc_stats_get(&allocs);
+    text_buffer_append_str(buffer, "},\"allocations\":{\"count\":");
+    text_buffer_append_u64(buffer, allocs.allocations);
+    append_key(buffer, "frees");
+    text_buffer_append_u64(buffer, allocs.frees);
+    append_key(buffer, "bytes");
+    text_buffer_append_u64(buffer, allocs.bytes);
+    append_key(buffer, "ticks");
+    text_buffer_append_u64(buffer, allocs.ticks);
+    append_key(buffer, "quiet_ticks");
+    text_buffer_append_u64(buffer, allocs.quiet_ticks);
+    append_key(buffer, "last_tick");
+    text_buffer_append_u64(buffer, allocs.last_tick);
+    append_key(buffer, "max_tick");
+    text_buffer_append_u64(buffer, allocs.max_tick);
+    text_buffer_append(buffer, "}}\n", 3);
+    
+    if (buffer->failed) {
+        return -1;
+    }
+    return write_all(out->fd, buffer->data, buffer->len);
+}
+
+void json_output_render_container(text_buffer_t *buffer, const monitor_state_t *state,
+                                  const container_monitor_t *container) {
+    render_container_record(buffer, state, container, 0);
+}
+
+void json_output_render_summary(text_buffer_t *buffer, const monitor_state_t *state, top_k_t *top) {
+    if (state->host_count == 0) {
+        render_summary_record(buffer, state, -1, top);
+        return;
+    }
+    
+    for (int host = 0; host < state->host_count; host++) {
+        render_summary_record(buffer, state, host, top);
+    }
+}
+
+void json_output_append_string(text_buffer_t *buffer, const char *value) {
+    static const char hex[] = "0123456789abcdef";
+    const char *run = value;
+    
+    text_buffer_append(buffer, "\"", 1);
+    for (const char *p = value; *p; p++) {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        
+        text_buffer_append(buffer, run, p - run);
+        if (c == '"' || c == '\\') {
+            char escaped[2] = { '\\', (char)c };
+            text_buffer_append(buffer, escaped, 2);
+        } else {
+            char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+            text_buffer_append(buffer, escaped, 6);
+        }
+        run = p + 1;
+    }
+    text_buffer_append_str(buffer, run);
+    text_buffer_append(buffer, "\"", 1);
+}
+
+static void render_summary_record(text_buffer_t *buffer, const monitor_state_t *state, int host, top_k_t *top) {
+    monitor_summary_t summary;
+    
+    monitor_summarize(state, host, &summary, top);
+    
+    text_buffer_append(buffer, "{\"timestamp\":", 13);
+    text_buffer_append_i64(buffer, state->last_update);
+    append_key(buffer, "host");
+    json_output_append_string(buffer, monitor_host_name(state, host));
+    append_key(buffer, "containers");
+    text_buffer_append_u64(buffer, summary.containers);
+    append_key(buffer, "running");
+    text_buffer_append_u64(buffer, summary.running);
+    append_key(buffer, "cpu_percent");
+    text_buffer_append_fixed(buffer, summary.cpu_percent, 2);
+    append_key(buffer, "memory_working_set");
+    text_buffer_append_u64(buffer, summary.memory);
+    append_key(buffer, "memory_limit");
+    text_buffer_append_u64(buffer, summary.memory_limit);
+    text_buffer_append(buffer, "}\n", 2);
+}
+
+static void render_container_record(text_buffer_t *buffer, const monitor_state_t *state,
+                                    const container_monitor_t *container, int rank) {
+    const container_stats_t *stats = &container->stats;
+    
+    text_buffer_append(buffer, "{\"timestamp\":", 13);
+    text_buffer_append_i64(buffer, state->last_update);
+    append_key(buffer, "host");
+    json_output_append_string(buffer, monitor_host_name(state, container->info.host));
+    append_key(buffer, "id");
+    json_output_append_string(buffer, container->info.id);
+    append_key(buffer, "name");
+    json_output_append_string(buffer, container->info.name);
+    append_key(buffer, "image");
+    json_output_append_string(buffer, container->info.image);
+    append_key(buffer, "status");
+    json_output_append_string(buffer, container->info.status);
+    append_key(buffer, "running");
+    text_buffer_append_str(buffer, container->is_running ? "true" : "false");
+    
+    if (container->is_running) {
+        append_key(buffer, "cpu_percent");
+        text_buffer_append_fixed(buffer, container->cpu_percent, 2);
+        append_key(buffer, "online_cpus");
+        text_buffer_append_u64(buffer, stats->online_cpus);
+        append_key(buffer, "memory_usage");
+        text_buffer_append_u64(buffer, stats->memory_usage);
+        append_key(buffer, "memory_working_set");
+        text_buffer_append_u64(buffer, container->memory_working_set);
+        append_key(buffer, "memory_limit");
+        text_buffer_append_u64(buffer, stats->memory_limit);
+        append_key(buffer, "memory_percent");
+        text_buffer_append_fixed(buffer, container->memory_percent, 2);
+        append_key(buffer, "network_rx_bytes");
+        text_buffer_append_u64(buffer, stats->network_rx_bytes);
+        append_key(buffer, "network_tx_bytes");
+        text_buffer_append_u64(buffer, stats->network_tx_bytes);
+        append_key(buffer, "network_rx_rate");
+        text_buffer_append_fixed(buffer, container->network_rx_rate, 1);
+        append_key(buffer, "network_tx_rate");
+        text_buffer_append_fixed(buffer, container->network_tx_rate, 1);
+        append_key(buffer, "block_read_bytes");
+        text_buffer_append_u64(buffer, stats->block_read_bytes);
+        append_key(buffer, "block_write_bytes");
+        text_buffer_append_u64(buffer, stats->block_write_bytes);
+        append_key(buffer, "block_read_rate");
+        text_buffer_append_fixed(buffer, container->block_read_rate, 1);
+        append_key(buffer, "block_write_rate");
+        text_buffer_append_fixed(buffer, container->block_write_rate, 1);
+    }
+    
+    if (rank > 0) {
+        append_key(buffer, "rank");
+        text_buffer_append_u64(buffer, rank);
+    }
+    
+    text_buffer_append(buffer, "}\n", 2);
+}
+
+static void append_key(text_buffer_t *buffer, const char *key) {
+    text_buffer_append(buffer, ",\"", 2);
+    text_buffer_append_str(buffer, key);
+    text_buffer_append(buffer, "\":", 2);
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
@@ -0,0 +1,454 @@
+#include <string.h>
+#include "../include/json_scan.h"
+
+enum {
+    SCAN_VALUE,
+    SCAN_ARRAY_FIRST,
+    SCAN_OBJECT_FIRST,
+    SCAN_KEY,
+    SCAN_COLON,
+    SCAN_AFTER_VALUE,
+    SCAN_STRING,
+    SCAN_ESCAPE,
+    SCAN_UNICODE,
+    SCAN_NUMBER,
+    SCAN_LITERAL,
+    SCAN_ERROR
+};
+
+static int is_space(char c);
+static int begin_value(json_scan_t *scan, char c);
+static int push_level(json_scan_t *scan, char type);
+static int pop_level(json_scan_t *scan, char type);
+static void end_value(json_scan_t *scan);
+static void emit(json_scan_t *scan, json_scan_event_t event);
+static void append_char(json_scan_t *scan, char c);
+static void append_utf8(json_scan_t *scan, uint32_t code);
+static int hex_value(char c);
+
+void json_scan_init(json_scan_t *scan, json_scan_cb cb, void *ctx) {
+    scan->state = SCAN_VALUE;
+    scan->depth = 0;
+    scan->done = 0;
+    scan->token_len = 0;
+    scan->in_key = 0;
+    scan->high_surrogate = 0;
+    scan->cb = cb;
+    scan->ctx = ctx;
+}
+
+int json_scan_feed(json_scan_t *scan, const char *data, size_t len) {
+    size_t i = 0;
+    
+    while (i < len) {
+        char c = data[i];
+        
+        switch (scan->state) {
+        case SCAN_STRING: {
+            /* copy the run up to the next quote or escape in one go */
+            size_t start = i;
+            while (i < len && data[i] != '"' && data[i] != '\\') {
+                i++;
+            }
+            
+            char *target = scan->in_key ? scan->levels[scan->depth - 1].key : scan->token;
+            size_t capacity = (scan->in_key ? JSON_SCAN_MAX_KEY : JSON_SCAN_MAX_TOKEN) - 1;
+            size_t run = i - start;
+            if (scan->token_len < capacity) {
+                size_t n = run < capacity - scan->token_len ? run : capacity - scan->token_len;
+                memcpy(target + scan->token_len, data + start, n);
+                scan->token_len += n;
+            }
+            if (i == len) {
+                break;
+            }
+            
+            if (data[i] == '\\') {
+                scan->state = SCAN_ESCAPE;
+            } else {
+                target[scan->token_len] = '\0';
+                if (scan->in_key) {
+                    scan->state = SCAN_COLON;
+                } else {
+                    emit(scan, JSON_SCAN_STRING);
+                    end_value(scan);
+                }
+            }
+            i++;
+            break;
+        }
+        
+        case SCAN_ESCAPE:
+            switch (c) {
+            case '"': case '\\': case '/': append_char(scan, c); break;
+            case 'b': append_char(scan, '\b'); break;
+            case 'f': append_char(scan, '\f'); break;
+            case 'n': append_char(scan, '\n'); break;
+            case 'r': append_char(scan, '\r'); break;
+            case 't': append_char(scan, '\t'); break;
+            case 'u':
+                scan->unicode = 0;
+                scan->unicode_digits = 0;
+                scan->state = SCAN_UNICODE;
+                i++;
+                continue;
+            default:
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            scan->state = SCAN_STRING;
+            i++;
+            break;
+        
+        case SCAN_UNICODE: {
+            int digit = hex_value(c);
+            if (digit < 0) {
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            scan->unicode = (scan->unicode << 4) | digit;
+            if (++scan->unicode_digits == 4) {
+                append_utf8(scan, scan->unicode);
+                scan->state = SCAN_STRING;
+            }
+            i++;
+            break;
+        }
+        
+        case SCAN_NUMBER: {
+            size_t start = i;
+            while (i < len && ((data[i] >= '0' && data[i] <= '9') || data[i] == '.' || data[i] == 'e' ||
+                               data[i] == 'E' || data[i] == '+' || data[i] == '-')) {
+                i++;
+            }
+            
+            size_t n = i - start;
+            if (n > JSON_SCAN_MAX_TOKEN - 1 - scan->token_len) {
+                n = JSON_SCAN_MAX_TOKEN - 1 - scan->token_len;
+            }
+            memcpy(scan->token + scan->token_len, data + start, n);
+            scan->token_len += n;
+            
+            if (i < len) {
+                scan->token[scan->token_len] = '\0';
+                emit(scan, JSON_SCAN_NUMBER);
+                end_value(scan);
+            }
+            break;
+        }
+        
+        case SCAN_LITERAL:
+            if (c != scan->literal[scan->literal_pos]) {
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            i++;
+            if (scan->literal[++scan->literal_pos] == '\0') {
+                emit(scan, scan->literal[0] == 't' ? JSON_SCAN_TRUE :
+                           scan->literal[0] == 'f' ? JSON_SCAN_FALSE : JSON_SCAN_NULL);
+                end_value(scan);
+            }
+            break;
+        
+        case SCAN_VALUE:
+        case SCAN_ARRAY_FIRST:
+            i++;
+            if (is_space(c)) {
+                break;
+            }
+            if (c == ']' && scan->state == SCAN_ARRAY_FIRST) {
+                if (pop_level(scan, '[') != 0) {
+                    return -1;
+                }
+                break;
+            }
+            if (begin_value(scan, c) != 0) {
+                return -1;
+            }
+            break;
+        
+        case SCAN_OBJECT_FIRST:
+        case SCAN_KEY:
+            i++;
+            if (is_space(c)) {
+                break;
+            }
+            if (c == '}' && scan->state == SCAN_OBJECT_FIRST) {
+                if (pop_level(scan, '{') != 0) {
+                    return -1;
+                }
+                break;
+            }
+            if (c != '"') {
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            scan->in_key = 1;
+            scan->token_len = 0;
+            scan->state = SCAN_STRING;
+            break;
+        
+        case SCAN_COLON:
+            i++;
+            if (is_space(c)) {
+                break;
+            }
+            if (c != ':') {
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            scan->in_key = 0;
+            scan->state = SCAN_VALUE;
+            break;
+        
+        case SCAN_AFTER_VALUE:
+            i++;
+            if (is_space(c)) {
+                break;
+            }
+            if (scan->depth == 0) {
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            
+            json_scan_level_t *level = &scan->levels[scan->depth - 1];
+            if (c == ',') {
+                if (level->type == '{') {
+                    scan->state = SCAN_KEY;
+                } else {
+                    level->index++;
+                    scan->state = SCAN_VALUE;
+                }
+            } else if (c == '}' || c == ']') {
+                if (pop_level(scan, c == '}' ? '{' : '[') != 0) {
+                    return -1;
+                }
+            } else {
+                scan->state = SCAN_ERROR;
+                return -1;
+            }
+            break;
+        
+        default:
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+int json_scan_finish(json_scan_t *scan) {
+    /* a bare top-level number has no terminator */
+    if (scan->state == SCAN_NUMBER && scan->depth == 0) {
+        scan->token[scan->token_len] = '\0';
+        emit(scan, JSON_SCAN_NUMBER);
+        end_value(scan);
+    }
+    
+    return scan->done && scan->state == SCAN_AFTER_VALUE ? 0 : -1;
+}
+
+int json_scan_match(const json_scan_t *scan, const char *path) {
+    const char *segment = path;
+    
+    for (int level = 0; level < scan->depth; level++) {
+        const char *end = strchr(segment, '.');
+        size_t segment_len = end ? (size_t)(end - segment) : strlen(segment);
+        
+        if (segment_len == 0) {
+            return 0;
+        }
+        if (!(segment_len == 1 && segment[0] == '*')) {
+            const json_scan_level_t *current = &scan->levels[level];
+            if (current->type != '{' || strncmp(current->key, segment, segment_len) != 0 ||
+                current->key[segment_len] != '\0') {
+                return 0;
+            }
+        }
+        
+        if (!end) {
+            return level == scan->depth - 1;
+        }
+        segment = end + 1;
+    }
+    
+    return 0;
+}
+
+const char *json_scan_key(const json_scan_t *scan, int level) {
+    if (level < 0 || level >= scan->depth || scan->levels[level].type != '{') {
+        return "";
+    }
+    return scan->levels[level].key;
+}
+
+int json_scan_index(const json_scan_t *scan, int level) {
+    if (level < 0 || level >= scan->depth || scan->levels[level].type != '[') {
+        return -1;
+    }
+    return scan->levels[level].index;
+}
+
+int json_scan_depth(const json_scan_t *scan) {
+    return scan->depth;
+}
+
+uint64_t json_scan_u64(const char *value, size_t len) {
+    uint64_t result = 0;
+    
+    for (size_t i = 0; i < len && value[i] >= '0' && value[i] <= '9'; i++) {
+        result = result * 10 + (value[i] - '0');
+    }
+    
+    return result;
+}
+
+int64_t json_scan_i64(const char *value, size_t len) {
+    if (len > 0 && value[0] == '-') {
+        return -(int64_t)json_scan_u64(value + 1, len - 1);
+    }
+    return (int64_t)json_scan_u64(value, len);
+}
+
+static int is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static int begin_value(json_scan_t *scan, char c) {
+    switch (c) {
+    case '{':
+        emit(scan, JSON_SCAN_OBJECT_START);
+        if (push_level(scan, '{') != 0) {
+            return -1;
+        }
+        scan->state = SCAN_OBJECT_FIRST;
+        return 0;
+    case '[':
+        emit(scan, JSON_SCAN_ARRAY_START);
+        if (push_level(scan, '[') != 0) {
+            return -1;
+        }
+        scan->state = SCAN_ARRAY_FIRST;
+        return 0;
+    case '"':
+        scan->in_key = 0;
+        scan->token_len = 0;
+        scan->state = SCAN_STRING;
+        return 0;
+    case 't':
+        scan->literal = "true";
+        break;
+    case 'f':
+        scan->literal = "false";
+        break;
+    case 'n':
+        scan->literal = "null";
+        break;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            scan->token[0] = c;
+            scan->token_len = 1;
+            scan->state = SCAN_NUMBER;
+            return 0;
+        }
+        scan->state = SCAN_ERROR;
+        return -1;
+    }
+    
+    scan->token_len = 0;
+    scan->token[0] = '\0';
+    scan->literal_pos = 1;
+    scan->state = SCAN_LITERAL;
+    return 0;
+}
+
+static int push_level(json_scan_t *scan, char type) {
+    if (scan->depth == JSON_SCAN_MAX_DEPTH) {
+        scan->state = SCAN_ERROR;
+        return -1;
+    }
+    
+    json_scan_level_t *level = &scan->levels[scan->depth++];
+    level->type = type;
+    level->index = 0;
+    level->key[0] = '\0';
+    return 0;
+}
+
+static int pop_level(json_scan_t *scan, char type) {
+    if (scan->depth == 0 || scan->levels[scan->depth - 1].type != type) {
+        scan->state = SCAN_ERROR;
+        return -1;
+    }
+    
+    scan->depth--;
+    scan->token_len = 0;
+    scan->token[0] = '\0';
+    emit(scan, type == '{' ? JSON_SCAN_OBJECT_END : JSON_SCAN_ARRAY_END);
+    end_value(scan);
+    return 0;
+}
+
+static void end_value(json_scan_t *scan) {
+    if (scan->depth == 0) {
+        scan->done = 1;
+    }
+    scan->state = SCAN_AFTER_VALUE;
+}
+
+static void emit(json_scan_t *scan, json_scan_event_t event) {
+    if (event == JSON_SCAN_OBJECT_START || event == JSON_SCAN_ARRAY_START) {
+        scan->token_len = 0;
+        scan->token[0] = '\0';
+    }
+    if (scan->cb) {
+        scan->cb(scan->ctx, scan, event, scan->token, scan->token_len);
+    }
+}
+
+static void append_char(json_scan_t *scan, char c) {
+    char *target = scan->in_key ? scan->levels[scan->depth - 1].key : scan->token;
+    size_t capacity = (scan->in_key ? JSON_SCAN_MAX_KEY : JSON_SCAN_MAX_TOKEN) - 1;
+    
+    if (scan->token_len < capacity) {
+        target[scan->token_len++] = c;
+    }
+}
+
+static void append_utf8(json_scan_t *scan, uint32_t code) {
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        scan->high_surrogate = code;
+        return;
+    }
+    if (code >= 0xDC00 && code <= 0xDFFF) {
+        if (!scan->high_surrogate) {
+            code = 0xFFFD;
+        } else {
+            code = 0x10000 + ((scan->high_surrogate - 0xD800) << 10) + (code - 0xDC00);
+        }
+    }
+    scan->high_surrogate = 0;
+    
+    if (code < 0x80) {
+        append_char(scan, (char)code);
+    } else if (code < 0x800) {
+        append_char(scan, (char)(0xC0 | (code >> 6)));
+        append_char(scan, (char)(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        append_char(scan, (char)(0xE0 | (code >> 12)));
+        append_char(scan, (char)(0x80 | ((code >> 6) & 0x3F)));
+        append_char(scan, (char)(0x80 | (code & 0x3F)));
+    } else {
+        append_char(scan, (char)(0xF0 | (code >> 18)));
+        append_char(scan, (char)(0x80 | ((code >> 12) & 0x3F)));
+        append_char(scan, (char)(0x80 | ((code >> 6) & 0x3F)));
+        append_char(scan, (char)(0x80 | (code & 0x3F)));
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
@@ -1,40 +1,113 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <signal.h>
 #include <time.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <errno.h>
+#include <poll.h>
 #include "../include/docker_monitor.h"
 #include "../include/docker_api.h"
+#include "../include/stats_stream.h"
+#include "../include/docker_events.h"
+#include "../include/metrics_exporter.h"
+#include "../include/json_output.h"
+#include "../include/recording.h"
+#include "../include/stage_timer.h"
+#include "../include/poll_scheduler.h"
+#include "../include/container_filter.h"
+#include "../include/alert_engine.h"
+#include "../include/tui.h"
+#include "../include/top_k.h"
+#include "../include/alloc_stats.h"
+
+#define TUI_KEY_SLICE_MS 50
 
 volatile int running = 1;
+volatile int dump_stages = 0;
 
 void signal_handler(int sig) {
-    printf("\nПолучен сигнал %d, завершение работы...\n", sig);
+    fprintf(stderr, "\nПолучен сигнал %d, завершение работы...\n", sig);
     running = 0;
 }
 
+/* SIGUSR1: the stage latencies are printed after the current tick */
+void dump_handler(int sig) {
+    (void)sig;
+    dump_stages = 1;
+}
+
+void print_stages(const monitor_state_t *state, json_output_t *json) {
+    if (json) {
+        json_output_write_stages(json, state->last_update);
+    } else {
+        stage_print(stderr);
+        alloc_stats_print(stderr);
+    }
+}
+
 void print_usage(const char *program_name) {
     printf("Использование: %s [опции]\n", program_name);
     printf("Опции:\n");
     printf("  -h, --help           Показать эту справку\n");
     printf("  -v, --version        Показать версию\n");
     printf("  -i <секунды>         Интервал обновления (по умолчанию: 5)\n");
-    printf("  -c <контейнер>       Мониторинг только указанного контейнера\n");
+    printf("  -w <потоки>          Параллельные запросы статистики (по умолчанию: %d)\n", DEFAULT_CONCURRENCY);
+    printf("  -c <имя>             Мониторинг только указанного контейнера (= --filter name=<имя>)\n");
+    printf("  --filter <вид>=<шаблон>\n");
+    printf("                       Отбор контейнеров по name, id, image или label=<ключ>[=<значение>];\n");
+    printf("                       шаблоны как в shell (*, ?, [...]), можно повторять\n");
     printf("  -j                   Вывод в JSON формате\n");
     printf("  -s                   Показать только сводку\n");
-    printf("  -H <хост>            Docker хост (по умолчанию: localhost)\n");
-    printf("  -p <порт>            Docker порт (по умолчанию: 2375)\n");
+    printf("  --tui                Полноэкранная таблица в стиле top с сортировкой и выбором строки\n");
+    printf("  --top <n>            Сводка и n контейнеров с наибольшим значением --sort\n");
+    printf("  --sort <метрика>     cpu, memory, network или io (по умолчанию: cpu)\n");
+    printf("  --stream             Потоковая статистика (stats?stream=true) вместо опроса\n");
+    printf("  --no-events          Запрашивать полный список контейнеров в каждом такте\n");
+    printf("  --idle-interval <с>  Опрашивать неактивные контейнеры реже, вплоть до раза\n");
+    printf("                       в указанное число секунд (по умолчанию: как -i)\n");
+    printf("  --max-rps <n>        Не больше n запросов статистики в секунду к одному хосту\n");
+    printf("  --listen <адрес>     Метрики Prometheus на /metrics ([адрес:]порт)\n");
+    printf("  --record <файл>      Дописывать замеры каждого такта в бинарный файл\n");
+    printf("  --replay <файл>      Воспроизвести записанный файл вместо опроса Docker\n");
+    printf("  --replay-speed <x>   Ускорение воспроизведения (по умолчанию: 1, 0 - без пауз)\n");
+    printf("  --alert <правило>    Правило тревоги, можно повторять (см. README)\n");
+    printf("  --alerts <файл>      Правила тревог из файла, по одному в строке\n");
+    printf("  --alert-log <файл>   Дописывать тревоги в файл в виде NDJSON\n");
+    printf("  --alert-exec <cmd>   Запускать команду на каждую тревогу (переменные ALERT_*)\n");
+    printf("  -H <хост[:порт]>     Docker хост или unix://<путь>, можно указать несколько раз\n");
+    printf("                       (по умолчанию: localhost); IPv6: [адрес] или [адрес]:порт\n");
+    printf("  --hosts-file <файл>  Список хостов, по одному в строке\n");
+    printf("  -p <порт>            Docker порт для хостов без порта (по умолчанию: 2375, с --tls 2376)\n");
     printf("  --tls                Использовать TLS соединение\n");
-    printf("  --cert <путь>        Путь к сертификату клиента\n");
+    printf("  --cert <путь>        Путь к сертификату клиента (вместе с --key)\n");
     printf("  --key <путь>         Путь к ключу клиента\n");
-    printf("  --ca <путь>          Путь к CA сертификату\n");
+    printf("  --ca <путь>          CA для проверки сертификата демона (по умолчанию: системные)\n");
+    printf("  --connect-timeout <с>\n");
+    printf("                       Предел на разрешение имени, подключение и рукопожатие TLS\n");
+    printf("                       (по умолчанию: %d)\n", HTTP_CONNECT_TIMEOUT_MS / 1000);
+    printf("  --read-timeout <с>   Предел ожидания ответа демона (по умолчанию: %d)\n", HTTP_IO_TIMEOUT_MS / 1000);
+    printf("  --cgroup             Читать статистику напрямую из cgroup (локальный хост)\n");
+    printf("  --cgroup-root <путь> Корень файловой системы cgroup (по умолчанию: /sys/fs/cgroup)\n");
+    printf("  --proc-root <путь>   Корень procfs (по умолчанию: /proc)\n");
     printf("\nПримеры:\n");
     printf("  %s                    # Мониторинг локальных контейнеров\n", program_name);
     printf("  %s -H 192.168.1.100  # Удаленный хост\n", program_name);
-    printf("  %s -H docker.example.com -p 2376 --tls  # TLS соединение\n", program_name);
+    printf("  %s -H docker.example.com --tls --ca ca.pem --cert cert.pem --key key.pem  # TLS соединение\n",
+           program_name);
+    printf("  %s -H node1 -H node2:2376 -s  # Несколько хостов в одном процессе\n", program_name);
+    printf("  %s -H unix:///run/user/1000/docker.sock  # Другой Unix socket\n", program_name);
     printf("  %s -i 10              # Обновление каждые 10 секунд\n", program_name);
+    printf("  %s -i 1 --idle-interval 30 --max-rps 200  # Частый опрос активных контейнеров\n", program_name);
     printf("  %s -c my_container    # Только контейнер my_container\n", program_name);
+    printf("  %s --filter 'name=web-*' --filter label=env=prod  # Контейнеры web-* с меткой env=prod\n", program_name);
+    printf("  %s -s --listen 9323   # Сводка в консоли и метрики на :9323/metrics\n", program_name);
+    printf("  %s --top 10 --sort memory  # Десять контейнеров, занимающих больше всего памяти\n", program_name);
+    printf("  %s --replay node.rec --replay-speed 60  # Просмотр записи в 60 раз быстрее\n", program_name);
+    printf("  %s --alert 'mem: memory_percent > 90 for 30s' --alert restart  # Тревоги в stderr\n", program_name);
 }
 
 void print_version(void) {
@@ -42,6 +115,297 @@ void print_version(void) {
     printf("Мониторинг CPU/RAM контейнеров Docker\n");
 }
 
+void print_state(const monitor_state_t *state, int summary_only, json_output_t *json, tui_t *tui, top_k_t *top) {
+    if (tui) {
+        tui_render(tui, state);
+    } else if (json) {
+        json_output_write_tick(json, state, summary_only, top);
+    } else if (summary_only || top) {
+        print_summary(state, top);
+    } else {
+        print_container_stats(state);
+    }
+}
+
+void finish_tick(monitor_state_t *state, int summary_only, json_output_t *json,
+                 metrics_exporter_t *exporter, recording_writer_t *recorder, alert_engine_t *alerts, tui_t *tui,
+                 top_k_t *top) {
+    uint64_t start = stage_now();
+    
+    if (alerts) {
+        alert_engine_evaluate(alerts, state);
+        start = stage_record(STAGE_ALERTS, start);
+    }
+    print_state(state, summary_only, json, tui, top);
+    start = stage_record(STAGE_RENDER, start);
+    if (exporter) {
+        metrics_exporter_publish(exporter, state);
+        stage_record(STAGE_METRICS, start);
+    }
+    if (recorder) {
+        recording_write_tick(recorder, state);
+    }
+    if (dump_stages) {
+        dump_stages = 0;
+        print_stages(state, json);
+    }
+}
+
+/* keys are answered at once, the screen is redrawn from the last tick's data */
+void handle_keys(const monitor_state_t *state, tui_t *tui) {
+    switch (tui_handle_input(tui)) {
+    case TUI_QUIT:
+        running = 0;
+        break;
+    case TUI_REDRAW:
+        tui_render(tui, state);
+        break;
+    default:
+        break;
+    }
+}
+
+/* sleeps until deadline (monotonic ns) or until a key arrives */
+void wait_keys(const monitor_state_t *state, tui_t *tui, uint64_t deadline) {
+    uint64_t now = monotonic_ns();
+    struct pollfd input = { tui_input_fd(tui), POLLIN, 0 };
+    
+    if (now < deadline) {
+        poll(&input, 1, (int)((deadline - now + 999999) / 1000000));
+    }
+    handle_keys(state, tui);
+}
+
+/* waits for the next point of a fixed grid of ticks, so the time a tick
+   takes does not push the later ones back; a tick that overran skips the
+   grid points it missed. Streams are polled in the meantime in stream mode,
+   SIGUSR1 cuts the wait short, is answered and the wait resumes; so do keys
+   in TUI mode */
+void wait_next_tick(monitor_state_t *state, uint64_t *next_tick, stats_stream_t *streams, json_output_t *json,
+                    tui_t *tui) {
+    uint64_t period = (uint64_t)state->interval * 1000000000ULL;
+    uint64_t now = monotonic_ns();
+    
+    *next_tick += period;
+    if (*next_tick <= now) {
+        *next_tick += (now - *next_tick) / period * period + period;
+    }
+    
+    while (running) {
+        now = monotonic_ns();
+        if (now >= *next_tick) {
+            break;
+        }
+        
+        if (streams) {
+            int timeout = (int)((*next_tick - now + 999999) / 1000000);
+            
+            /* the streams own the poll set, keys are checked between slices */
+            if (tui && timeout > TUI_KEY_SLICE_MS) {
+                timeout = TUI_KEY_SLICE_MS;
+            }
+            stats_stream_poll(streams, timeout);
+            if (tui) {
+                handle_keys(state, tui);
+            }
+        } else if (tui) {
+            wait_keys(state, tui, *next_tick);
+        } else {
+            struct timespec deadline = { (time_t)(*next_tick / 1000000000ULL), (long)(*next_tick % 1000000000ULL) };
+            int result = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+            if (result != 0 && result != EINTR) {
+                break;
+            }
+        }
+        
+        if (dump_stages) {
+            dump_stages = 0;
+            print_stages(state, json);
+        }
+    }
+}
+
+/* waits out the recorded gap between ticks; longer gaps than the interval
+   are capture outages and are not reproduced */
+void replay_wait(const monitor_state_t *state, int64_t gap, double speed, tui_t *tui) {
+    if (speed <= 0.0 || gap <= 0) {
+        return;
+    }
+    if (gap > state->interval) {
+        gap = state->interval;
+    }
+    
+    double seconds = gap / speed;
+    if (tui) {
+        uint64_t deadline = monotonic_ns() + (uint64_t)(seconds * 1e9);
+        while (running && monotonic_ns() < deadline) {
+            wait_keys(state, tui, deadline);
+        }
+        return;
+    }
+    
+    struct timespec delay = { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) };
+    nanosleep(&delay, NULL);
+}
+
+int run_replay(monitor_state_t *state, const char *path, double speed, int summary_only,
+               json_output_t *json, metrics_exporter_t *exporter, alert_engine_t *alerts, tui_t *tui,
+               top_k_t *top) {
+    recording_reader_t *reader = recording_reader_open(path);
+    int ticks = 0;
+    
+    if (!reader) {
+        return -1;
+    }
+    
+    while (running) {
+        time_t previous = state->last_update;
+        int result = recording_reader_next(reader, state);
+        
+        if (result < 0) {
+            print_error("Файл записи поврежден, воспроизведение остановлено");
+        }
+        if (result <= 0) {
+            break;
+        }
+        
+        if (ticks > 0) {
+            replay_wait(state, state->last_update - previous, speed, tui);
+        }
+        if (running) {
+            finish_tick(state, summary_only, json, exporter, NULL, alerts, tui, top);
+            ticks++;
+        }
+        arena_reset(&state->scratch);
+        alloc_stats_tick();
+    }
+    
+    recording_reader_close(reader);
+    return ticks;
+}
+
+void print_screen_stats(uint64_t frames, uint64_t bytes, FILE *out) {
+    fprintf(out, "Экран: кадров %llu, выведено %llu байт (%llu на кадр)\n",
+            (unsigned long long)frames, (unsigned long long)bytes,
+            (unsigned long long)(frames > 0 ? bytes / frames : 0));
+}
+
+void print_connection_stats(const monitor_state_t *state, FILE *out) {
+    http_pool_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    
+    for (int i = 0; i < state->host_count; i++) {
+        http_pool_stats_t host_stats;
+        if (!state->hosts[i].client) continue;
+        
+        docker_client_get_pool_stats(state->hosts[i].client, &host_stats);
+        stats.requests += host_stats.requests;
+        stats.connects += host_stats.connects;
+        stats.reused += host_stats.reused;
+        stats.failures += host_stats.failures;
+        stats.tls_handshakes += host_stats.tls_handshakes;
+        stats.tls_resumed += host_stats.tls_resumed;
+        stats.timeouts += host_stats.timeouts;
+        stats.skipped += host_stats.skipped;
+    }
+    
+    uint64_t acquired = stats.connects + stats.reused;
+    fprintf(out, "Соединения: запросов %llu, новых %llu, повторных %llu (%.1f%%), ошибок %llu\n",
+           (unsigned long long)stats.requests,
+           (unsigned long long)stats.connects,
+           (unsigned long long)stats.reused,
+           acquired > 0 ? (double)stats.reused / acquired * 100.0 : 0.0,
+           (unsigned long long)stats.failures);
+    if (stats.tls_handshakes > 0) {
+        fprintf(out, "TLS: рукопожатий %llu, из них с возобновлением сессии %llu (%.1f%%)\n",
+                (unsigned long long)stats.tls_handshakes,
+                (unsigned long long)stats.tls_resumed,
+                (double)stats.tls_resumed / stats.tls_handshakes * 100.0);
+    }
+    if (stats.timeouts > 0 || stats.skipped > 0) {
+        fprintf(out, "Недоступные хосты: таймаутов %llu, пропущено запросов во время паузы %llu\n",
+                (unsigned long long)stats.timeouts,
+                (unsigned long long)stats.skipped);
+    }
+}
+
+/* one host per line; blank lines and # comments are skipped */
+int read_hosts_file(monitor_state_t *state, const char *path) {
+    char line[512];
+    FILE *file = fopen(path, "r");
+    
+    if (!file) {
+        return -1;
+    }
+    
+    while (fgets(line, sizeof(line), file)) {
+        char *start = line;
+        while (isspace((unsigned char)*start)) start++;
+        start[strcspn(start, " \t\r\n#")] = '\0';
+        
+        if (*start && monitor_add_host(state, start) < 0) {
+            fclose(file);
+            return -1;
+        }
+    }
+    
+    fclose(file);
+    return 0;
+}
+
+/* "host" uses the default port, "host:port" its own. An IPv6 address is
+   written "[addr]" or "[addr]:port"; without brackets a name with several
+   colons is taken as an address with no port */
+void host_config(const docker_config_t *defaults, const char *name, docker_config_t *config) {
+    const char *colon = strrchr(name, ':');
+    const char *close;
+    
+    *config = *defaults;
+    snprintf(config->host, sizeof(config->host), "%s", name);
+    
+    if (strncmp(name, UNIX_HOST_PREFIX, strlen(UNIX_HOST_PREFIX)) == 0) {
+        return;
+    }
+    
+    if (name[0] == '[' && (close = strchr(name, ']')) != NULL) {
+        snprintf(config->host, sizeof(config->host), "%.*s", (int)(close - name - 1), name + 1);
+        colon = close[1] == ':' ? close + 1 : NULL;
+    } else if (colon && strchr(name, ':') != colon) {
+        return;
+    }
+    
+    if (colon && colon[1] && strspn(colon + 1, "0123456789") == strlen(colon + 1)) {
+        if (name[0] != '[') {
+            config->host[colon - name] = '\0';
+        }
+        config->port = atoi(colon + 1);
+    }
+}
+
+int connect_hosts(monitor_state_t *state, int use_events) {
+    for (int i = 0; i < state->host_count; i++) {
+        monitor_host_t *host = &state->hosts[i];
+        docker_config_t config;
+        
+        host_config(&state->config, host->name, &config);
+        host->client = docker_client_create(&config);
+        if (!host->client) {
+            return -1;
+        }
+        
+        /* with several hosts one that is down is reported and retried every tick */
+        if (docker_client_connect(host->client) != 0 && state->host_count == 1) {
+            return -1;
+        }
+        
+        if (use_events) {
+            host->events = docker_events_create(host->client, i);
+        }
+    }
+    
+    return 0;
+}
+
 void print_banner(void) {
     printf("================================================================\n");
     printf("                    DOCKER CONTAINER MONITOR                   \n");
@@ -50,18 +414,52 @@ void print_banner(void) {
 
 int main(int argc, char *argv[]) {
     int interval = 5;
+    int idle_interval = 0;
+    int max_rps = 0;
     char *target_container = NULL;
+    container_filter_t filter;
     int json_output = 0;
+    json_output_t json;
     int summary_only = 0;
+    int tui_mode = 0;
+    int top_count = 0;
+    int top_metric = TOP_CPU;
+    const char *top_sort = NULL;
+    int concurrency = DEFAULT_CONCURRENCY;
+    int stream_mode = 0;
+    int use_events = 1;
+    int port_given = 0;
+    const char *listen_address = NULL;
+    const char *record_path = NULL;
+    const char *replay_path = NULL;
+    double replay_speed = 1.0;
+    recording_writer_t *recorder = NULL;
+    stats_stream_t *streams = NULL;
+    metrics_exporter_t *exporter = NULL;
+    alert_engine_t *alerts = NULL;
+    tui_t *tui = NULL;
+    top_k_t *top = NULL;
+    uint64_t screen_frames = 0;
+    uint64_t screen_bytes = 0;
     monitor_state_t monitor_state;
     
     memset(&monitor_state, 0, sizeof(monitor_state_t));
+    memset(&filter, 0, sizeof(filter));
     strcpy(monitor_state.config.host, "localhost");
     monitor_state.config.port = 2375;
     monitor_state.config.use_tls = 0;
     
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGUSR1, dump_handler);
+    
+    /* worker and exporter threads inherit the mask, so only the main loop
+       sees SIGUSR1 and SIGWINCH and its waits are cut short by them */
+    sigset_t dump_signal;
+    sigemptyset(&dump_signal);
+    sigaddset(&dump_signal, SIGUSR1);
+    sigaddset(&dump_signal, SIGWINCH);
+    pthread_sigmask(SIG_BLOCK, &dump_signal, NULL);
     
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
@@ -81,23 +479,67 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Ошибка: не указан интервал для -i\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "-w") == 0) {
+            if (i + 1 < argc) {
+                concurrency = atoi(argv[++i]);
+                if (concurrency <= 0 || concurrency > MAX_CONCURRENCY) {
+                    fprintf(stderr, "Ошибка: число потоков должно быть от 1 до %d\n", MAX_CONCURRENCY);
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указано число потоков для -w\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "-c") == 0) {
             if (i + 1 < argc) {
+                char spec[MAX_CONTAINER_NAME + 8];
+                
                 target_container = argv[++i];
+                snprintf(spec, sizeof(spec), "name=%s", target_container);
+                if (container_filter_add(&filter, spec) != 0) {
+                    fprintf(stderr, "Ошибка: некорректное имя контейнера %s\n", target_container);
+                    return 1;
+                }
             } else {
                 fprintf(stderr, "Ошибка: не указан контейнер для -c\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "--filter") == 0) {
+            if (i + 1 < argc) {
+                if (container_filter_add(&filter, argv[++i]) != 0) {
+                    fprintf(stderr, "Ошибка: некорректный фильтр %s (name=, id=, image= или label= с ключом "
+                            "до %d символов, не больше %d фильтров)\n",
+                            argv[i], CONTAINER_FILTER_MAX_LABEL_KEY, MAX_SELECTORS);
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указан фильтр для --filter\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "-H") == 0) {
             if (i + 1 < argc) {
-                strncpy(monitor_state.config.host, argv[++i], sizeof(monitor_state.config.host) - 1);
+                if (monitor_add_host(&monitor_state, argv[++i]) < 0) {
+                    fprintf(stderr, "Ошибка: не удалось добавить хост %s\n", argv[i]);
+                    return 1;
+                }
             } else {
                 fprintf(stderr, "Ошибка: не указан хост для -H\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "--hosts-file") == 0) {
+            if (i + 1 < argc) {
+                if (read_hosts_file(&monitor_state, argv[++i]) != 0) {
+                    fprintf(stderr, "Ошибка: не удалось прочитать список хостов %s\n", argv[i]);
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указан файл для --hosts-file\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "-p") == 0) {
             if (i + 1 < argc) {
                 monitor_state.config.port = atoi(argv[++i]);
+                port_given = 1;
                 if (monitor_state.config.port <= 0) {
                     fprintf(stderr, "Ошибка: порт должен быть положительным числом\n");
                     return 1;
@@ -129,10 +571,153 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "Ошибка: не указан путь к CA для --ca\n");
                 return 1;
             }
+        } else if (strcmp(argv[i], "--connect-timeout") == 0 || strcmp(argv[i], "--read-timeout") == 0) {
+            const char *option = argv[i];
+            
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Ошибка: не указано время для %s\n", option);
+                return 1;
+            }
+            
+            /* fractions of a second are allowed */
+            int timeout_ms = (int)(atof(argv[++i]) * 1000.0);
+            if (timeout_ms <= 0) {
+                fprintf(stderr, "Ошибка: %s должен быть положительным числом секунд\n", option);
+                return 1;
+            }
+            if (strcmp(option, "--connect-timeout") == 0) {
+                monitor_state.config.connect_timeout_ms = timeout_ms;
+            } else {
+                monitor_state.config.read_timeout_ms = timeout_ms;
+            }
+        } else if (strcmp(argv[i], "--cgroup") == 0) {
+            monitor_state.config.use_cgroup = 1;
+        } else if (strcmp(argv[i], "--cgroup-root") == 0) {
+            if (i + 1 < argc) {
+                strncpy(monitor_state.config.cgroup_root, argv[++i], sizeof(monitor_state.config.cgroup_root) - 1);
+                monitor_state.config.use_cgroup = 1;
+            } else {
+                fprintf(stderr, "Ошибка: не указан путь для --cgroup-root\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--proc-root") == 0) {
+            if (i + 1 < argc) {
+                strncpy(monitor_state.config.proc_root, argv[++i], sizeof(monitor_state.config.proc_root) - 1);
+            } else {
+                fprintf(stderr, "Ошибка: не указан путь для --proc-root\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "-j") == 0) {
             json_output = 1;
         } else if (strcmp(argv[i], "-s") == 0) {
             summary_only = 1;
+        } else if (strcmp(argv[i], "--tui") == 0) {
+            tui_mode = 1;
+        } else if (strcmp(argv[i], "--top") == 0) {
+            if (i + 1 < argc) {
+                top_count = atoi(argv[++i]);
+                if (top_count <= 0 || top_count > MAX_TOP_K) {
+                    fprintf(stderr, "Ошибка: --top должен быть от 1 до %d\n", MAX_TOP_K);
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указано число контейнеров для --top\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sort") == 0) {
+            if (i + 1 < argc) {
+                top_sort = argv[++i];
+                top_metric = top_k_parse_metric(top_sort);
+                if (top_metric < 0) {
+                    fprintf(stderr, "Ошибка: неизвестная метрика %s (cpu, memory, network, io)\n", top_sort);
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указана метрика для --sort\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream_mode = 1;
+        } else if (strcmp(argv[i], "--no-events") == 0) {
+            use_events = 0;
+        } else if (strcmp(argv[i], "--idle-interval") == 0) {
+            if (i + 1 < argc) {
+                idle_interval = atoi(argv[++i]);
+                if (idle_interval <= 0) {
+                    fprintf(stderr, "Ошибка: --idle-interval должен быть положительным числом\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указан интервал для --idle-interval\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-rps") == 0) {
+            if (i + 1 < argc) {
+                max_rps = atoi(argv[++i]);
+                if (max_rps <= 0) {
+                    fprintf(stderr, "Ошибка: --max-rps должен быть положительным числом\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указано число запросов для --max-rps\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--listen") == 0) {
+            if (i + 1 < argc) {
+                listen_address = argv[++i];
+            } else {
+                fprintf(stderr, "Ошибка: не указан адрес для --listen\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0) {
+            if (i + 1 < argc) {
+                record_path = argv[++i];
+            } else {
+                fprintf(stderr, "Ошибка: не указан файл для --record\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            if (i + 1 < argc) {
+                replay_path = argv[++i];
+            } else {
+                fprintf(stderr, "Ошибка: не указан файл для --replay\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--replay-speed") == 0) {
+            if (i + 1 < argc) {
+                replay_speed = atof(argv[++i]);
+                if (replay_speed < 0.0) {
+                    fprintf(stderr, "Ошибка: ускорение не может быть отрицательным\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Ошибка: не указано ускорение для --replay-speed\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--alert") == 0 || strcmp(argv[i], "--alerts") == 0 ||
+                   strcmp(argv[i], "--alert-log") == 0 || strcmp(argv[i], "--alert-exec") == 0) {
+            const char *option = argv[i];
+            
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Ошибка: не указано значение для %s\n", option);
+                return 1;
+            }
+            if (!alerts && !(alerts = alert_engine_create())) {
+                fprintf(stderr, "Ошибка инициализации тревог\n");
+                return 1;
+            }
+            
+            const char *value = argv[++i];
+            if (strcmp(option, "--alert") == 0 && alert_engine_add_rule(alerts, value) != 0) {
+                fprintf(stderr, "Ошибка: некорректное правило тревоги: %s\n", value);
+                return 1;
+            } else if (strcmp(option, "--alerts") == 0 && alert_engine_load_rules(alerts, value) != 0) {
+                return 1;
+            } else if (strcmp(option, "--alert-log") == 0 && alert_engine_set_log(alerts, value) != 0) {
+                return 1;
+            } else if (strcmp(option, "--alert-exec") == 0) {
+                alert_engine_set_exec(alerts, value);
+            }
         } else {
             fprintf(stderr, "Неизвестная опция: %s\n", argv[i]);
             print_usage(argv[0]);
@@ -140,43 +725,277 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    print_banner();
-    printf("Интервал обновления: %d секунд\n", interval);
-    printf("Docker хост: %s:%d%s\n", 
-           monitor_state.config.host, 
-           monitor_state.config.port,
-           monitor_state.config.use_tls ? " (TLS)" : "");
-    if (target_container) {
-        printf("Мониторинг контейнера: %s\n", target_container);
+    if (record_path && replay_path) {
+        fprintf(stderr, "Ошибка: --record и --replay нельзя использовать вместе\n");
+        return 1;
+    }
+    if (replay_path && monitor_state.host_count > 0) {
+        fprintf(stderr, "Ошибка: при --replay хосты берутся из файла записи\n");
+        return 1;
+    }
+    if (alerts && alert_engine_rule_count(alerts) == 0) {
+        fprintf(stderr, "Ошибка: не задано ни одного правила тревоги\n");
+        return 1;
+    }
+    if (tui_mode && (json_output || summary_only)) {
+        fprintf(stderr, "Ошибка: --tui нельзя использовать вместе с -j и -s\n");
+        return 1;
+    }
+    if (top_sort && top_count == 0) {
+        fprintf(stderr, "Ошибка: --sort задает порядок для --top\n");
+        return 1;
+    }
+    if (tui_mode && top_count > 0) {
+        fprintf(stderr, "Ошибка: --top нельзя использовать вместе с --tui, там сортировка своя\n");
+        return 1;
+    }
+    if (top_count > 0 && !(top = top_k_create(top_metric, top_count))) {
+        fprintf(stderr, "Ошибка инициализации --top\n");
+        return 1;
+    }
+    if (tui_mode && (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))) {
+        fprintf(stderr, "Ошибка: для --tui нужен терминал\n");
+        return 1;
+    }
+    if (!monitor_state.config.cert_path[0] != !monitor_state.config.key_path[0]) {
+        fprintf(stderr, "Ошибка: --cert и --key указываются вместе\n");
+        return 1;
+    }
+    if (!monitor_state.config.use_tls &&
+        (monitor_state.config.cert_path[0] || monitor_state.config.ca_path[0])) {
+        fprintf(stderr, "Ошибка: --cert, --key и --ca действуют только вместе с --tls\n");
+        return 1;
+    }
+    if (monitor_state.config.use_tls) {
+        for (int i = 0; i < monitor_state.host_count; i++) {
+            if (strncmp(monitor_state.hosts[i].name, UNIX_HOST_PREFIX, strlen(UNIX_HOST_PREFIX)) == 0) {
+                fprintf(stderr, "Ошибка: --tls не применяется к Unix socket %s\n", monitor_state.hosts[i].name);
+                return 1;
+            }
+        }
+        if (!port_given) {
+            monitor_state.config.port = 2376;
+        }
+    }
+    if (replay_path && filter.count > 0) {
+        fprintf(stderr, "Ошибка: при --replay фильтры контейнеров не применяются\n");
+        return 1;
+    }
+    if (!replay_path && monitor_state.host_count == 0) {
+        monitor_add_host(&monitor_state, monitor_state.config.host);
+    }
+    if (filter.count > 0) {
+        monitor_state.config.filter = &filter;
+    }
+    
+    /* stdout carries only NDJSON records in JSON mode and the screen in TUI mode */
+    if (!json_output && !tui_mode) {
+        print_banner();
+        if (replay_path) {
+            printf("Воспроизведение: %s\n", replay_path);
+        } else {
+            printf("Интервал обновления: %d секунд\n", interval);
+            if (monitor_state.host_count == 1) {
+                docker_config_t config;
+                host_config(&monitor_state.config, monitor_state.hosts[0].name, &config);
+                if (strncmp(config.host, UNIX_HOST_PREFIX, strlen(UNIX_HOST_PREFIX)) == 0) {
+                    printf("Docker хост: %s\n", config.host);
+                } else {
+                    printf(strchr(config.host, ':') ? "Docker хост: [%s]:%d%s\n" : "Docker хост: %s:%d%s\n",
+                           config.host, 
+                           config.port,
+                           config.use_tls ? " (TLS)" : "");
+                }
+            } else {
+                printf("Docker хосты (%d)%s:", monitor_state.host_count,
+                       monitor_state.config.use_tls ? " (TLS)" : "");
+                for (int i = 0; i < monitor_state.host_count; i++) {
+                    printf("%s %s", i > 0 ? "," : "", monitor_state.hosts[i].name);
+                }
+                printf("\n");
+            }
+        }
+        if (target_container) {
+            printf("Мониторинг контейнера: %s\n", target_container);
+        }
+        if (filter.count > (target_container ? 1 : 0)) {
+            printf("Фильтров контейнеров: %d\n", filter.count);
+        }
+        if (listen_address) {
+            printf("Метрики Prometheus: %s/metrics\n", listen_address);
+        }
+        if (record_path) {
+            printf("Запись в файл: %s\n", record_path);
+        }
+        if (alerts) {
+            printf("Правил тревог: %d\n", alert_engine_rule_count(alerts));
+        }
+        if (top) {
+            printf("Топ %d по %s\n", top_count, top_k_metric_name(top_metric));
+        }
+        printf("Нажмите Ctrl+C для остановки\n\n");
+    } else if (json_output && json_output_init(&json, STDOUT_FILENO) != 0) {
+        fprintf(stderr, "Ошибка инициализации JSON вывода\n");
+        return 1;
+    }
+    
+    if (listen_address) {
+        exporter = metrics_exporter_start(listen_address);
+        if (!exporter) {
+            fprintf(stderr, "Ошибка запуска экспортера метрик на %s\n", listen_address);
+            return 1;
+        }
+    }
+    
+    if (replay_path) {
+        /* replay feeds the same update, output and export path as a live run */
+        init_monitor_state(&monitor_state, interval, 1);
+        pthread_sigmask(SIG_UNBLOCK, &dump_signal, NULL);
+        if (tui_mode && !(tui = tui_open())) {
+            fprintf(stderr, "Ошибка инициализации терминала\n");
+            metrics_exporter_stop(exporter);
+            alert_engine_destroy(alerts);
+            top_k_destroy(top);
+            cleanup_monitor_state(&monitor_state);
+            return 1;
+        }
+        int ticks = run_replay(&monitor_state, replay_path, replay_speed, summary_only,
+                               json_output ? &json : NULL, exporter, alerts, tui, top);
+        /* the last frame stays up until the user leaves */
+        while (tui && ticks > 0 && running) {
+            wait_keys(&monitor_state, tui, monotonic_ns() + 1000000000ULL);
+        }
+        if (tui) {
+            tui_get_stats(tui, &screen_frames, &screen_bytes);
+            tui_close(tui);
+        }
+        if (ticks >= 0) {
+            fprintf(json_output ? stderr : stdout, "\nВоспроизведено тактов: %d\n", ticks);
+        }
+        if (tui_mode) {
+            print_screen_stats(screen_frames, screen_bytes, stdout);
+        }
+        if (json_output) {
+            json_output_free(&json);
+        }
+        metrics_exporter_stop(exporter);
+        alert_engine_destroy(alerts);
+        top_k_destroy(top);
+        cleanup_monitor_state(&monitor_state);
+        return ticks >= 0 ? 0 : 1;
     }
-    printf("Нажмите Ctrl+C для остановки\n\n");
     
-    if (docker_api_init(&monitor_state.config) != 0) {
+    if (connect_hosts(&monitor_state, use_events) != 0) {
         fprintf(stderr, "Ошибка инициализации Docker API\n");
+        metrics_exporter_stop(exporter);
+        cleanup_monitor_state(&monitor_state);
         return 1;
     }
     
-    init_monitor_state(&monitor_state, interval);
+    init_monitor_state(&monitor_state, interval, concurrency);
+    
+    /* streams deliver samples on their own, there is nothing to schedule */
+    if (!stream_mode && (idle_interval > interval || max_rps > 0)) {
+        int max_every = idle_interval > interval ? idle_interval / interval : 1;
+        monitor_state.scheduler = poll_scheduler_create(max_every, max_rps > 0 ? max_rps * interval : 0);
+        if (!monitor_state.scheduler) {
+            fprintf(stderr, "Ошибка инициализации планировщика опроса\n");
+            metrics_exporter_stop(exporter);
+            cleanup_monitor_state(&monitor_state);
+            return 1;
+        }
+    }
+    
+    if (record_path) {
+        recorder = recording_writer_open(record_path);
+        if (!recorder) {
+            fprintf(stderr, "Ошибка открытия файла записи %s\n", record_path);
+            metrics_exporter_stop(exporter);
+            cleanup_monitor_state(&monitor_state);
+            return 1;
+        }
+    }
+    
+    if (stream_mode) {
+        streams = stats_stream_create();
+        if (!streams) {
+            fprintf(stderr, "Ошибка инициализации потоковой статистики\n");
+            recording_writer_close(recorder);
+            metrics_exporter_stop(exporter);
+            cleanup_monitor_state(&monitor_state);
+            return 1;
+        }
+    }
+    
+    pthread_sigmask(SIG_UNBLOCK, &dump_signal, NULL);
     
+    if (tui_mode && !(tui = tui_open())) {
+        fprintf(stderr, "Ошибка инициализации терминала\n");
+        stats_stream_destroy(streams);
+        recording_writer_close(recorder);
+        metrics_exporter_stop(exporter);
+        cleanup_monitor_state(&monitor_state);
+        return 1;
+    }
+    
+    uint64_t next_tick = monotonic_ns();
     while (running) {
-        if (get_container_list(&monitor_state) == 0) {
-            if (get_container_stats(&monitor_state) == 0) {
-                if (summary_only) {
-                    print_summary(&monitor_state);
-                } else {
-                    print_container_stats(&monitor_state);
+        uint64_t start = stage_now();
+        
+        if (stream_mode) {
+            /* the streams update monitor_state while we wait for the next tick */
+            if (refresh_container_list(&monitor_state) == 0) {
+                stats_stream_sync(streams, &monitor_state);
+                stage_record(STAGE_COLLECT, start);
+            }
+            wait_next_tick(&monitor_state, &next_tick, streams, json_output ? &json : NULL, tui);
+            if (running) {
+                monitor_state.last_update = time(NULL);
+                finish_tick(&monitor_state, summary_only, json_output ? &json : NULL, exporter, recorder, alerts, tui, top);
+            }
+        } else {
+            if (refresh_container_list(&monitor_state) == 0) {
+                if (get_container_stats(&monitor_state) == 0) {
+                    stage_record(STAGE_COLLECT, start);
+                    monitor_state.last_update = time(NULL);
+                    finish_tick(&monitor_state, summary_only, json_output ? &json : NULL, exporter, recorder, alerts,
+                                tui, top);
                 }
             }
+            
+            wait_next_tick(&monitor_state, &next_tick, NULL, json_output ? &json : NULL, tui);
         }
         
-        if (running) {
-            sleep(interval);
-        }
+        /* nothing handed out during the tick outlives it */
+        arena_reset(&monitor_state.scratch);
+        alloc_stats_tick();
     }
     
-    printf("\nЗавершение работы...\n");
+    /* the rest of the shutdown output goes to the normal screen */
+    if (tui) {
+        tui_get_stats(tui, &screen_frames, &screen_bytes);
+        tui_close(tui);
+    }
+    
+    if (json_output) {
+        print_connection_stats(&monitor_state, stderr);
+        print_stages(&monitor_state, &json);
+        json_output_free(&json);
+    } else {
+        printf("\nЗавершение работы...\n");
+        print_connection_stats(&monitor_state, stdout);
+        if (tui_mode) {
+            print_screen_stats(screen_frames, screen_bytes, stdout);
+        }
+        fflush(stdout);
+        print_stages(&monitor_state, NULL);
+    }
+    stats_stream_destroy(streams);
+    metrics_exporter_stop(exporter);
+    recording_writer_close(recorder);
+    alert_engine_destroy(alerts);
+    top_k_destroy(top);
     cleanup_monitor_state(&monitor_state);
-    docker_api_cleanup();
     
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "../include/metrics_exporter.h"
+
+#define METRICS_REQUEST_SIZE 4096
+#define METRICS_IO_TIMEOUT 2
+#define METRICS_POLL_MS 500
+
+/* three buffers: the collector renders into one, the newest finished render
+   waits in another and the server sends from the third, so neither side ever
+   waits for the other beyond a pointer swap */
+struct metrics_exporter {
+    int listen_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    volatile int stop;
+    text_buffer_t buffers[3];
+    int render_index;
+    int ready_index;
+    int serve_index;
+    int fresh;
+    int published;
+};
+
+typedef double (*metric_value_fn)(const container_monitor_t *container);
+
+typedef struct {
+    const char *name;
+    const char *type;
+    const char *help;
+    metric_value_fn value;
+    int running_only;
+} metric_family_t;
+
+static double metric_running(const container_monitor_t *c) { return c->is_running; }
+static double metric_cpu_percent(const container_monitor_t *c) { return c->cpu_percent; }
+static double metric_cpu_seconds(const container_monitor_t *c) { return c->stats.cpu_usage / 1e9; }
+static double metric_online_cpus(const container_monitor_t *c) { return c->stats.online_cpus; }
+static double metric_memory_usage(const container_monitor_t *c) { return c->stats.memory_usage; }
+static double metric_memory_working_set(const container_monitor_t *c) { return c->memory_working_set; }
+static double metric_memory_limit(const container_monitor_t *c) { return c->stats.memory_limit; }
+static double metric_memory_percent(const container_monitor_t *c) { return c->memory_percent; }
+static double metric_network_rx(const container_monitor_t *c) { return c->stats.network_rx_bytes; }
+static double metric_network_tx(const container_monitor_t *c) { return c->stats.network_tx_bytes; }
+static double metric_block_read(const container_monitor_t *c) { return c->stats.block_read_bytes; }
+static double metric_block_write(const container_monitor_t *c) { return c->stats.block_write_bytes; }
+
+static const metric_family_t metric_families[] = {
+    { "docker_container_running", "gauge", "Whether the container is running (1) or not (0).", metric_running, 0 },
+    { "docker_container_cpu_percent", "gauge", "CPU usage in percent of one CPU, as docker stats shows it.", metric_cpu_percent, 1 },
+    { "docker_container_cpu_usage_seconds_total", "counter", "Cumulative CPU time consumed.", metric_cpu_seconds, 1 },
+    { "docker_container_online_cpus", "gauge", "CPUs available to the container.", metric_online_cpus, 1 },
+    { "docker_container_memory_usage_bytes", "gauge", "Memory usage including page cache.", metric_memory_usage, 1 },
+    { "docker_container_memory_working_set_bytes", "gauge", "Memory usage without inactive page cache.", metric_memory_working_set, 1 },
+    { "docker_container_memory_limit_bytes", "gauge", "Memory limit.", metric_memory_limit, 1 },
+    { "docker_container_memory_percent", "gauge", "Working set in percent of the memory limit.", metric_memory_percent, 1 },
+    { "docker_container_network_receive_bytes_total", "counter", "Bytes received on all interfaces.", metric_network_rx, 1 },
+    { "docker_container_network_transmit_bytes_total", "counter", "Bytes transmitted on all interfaces.", metric_network_tx, 1 },
+    { "docker_container_block_read_bytes_total", "counter", "Bytes read from block devices.", metric_block_read, 1 },
+    { "docker_container_block_write_bytes_total", "counter", "Bytes written to block devices.", metric_block_write, 1 },
+};
+
+static int parse_listen(const char *listen_address, struct sockaddr_in *addr);
+static void *server_thread(void *arg);
+static void serve_client(metrics_exporter_t *exporter, int fd);
+static int send_all(int fd, const char *data, size_t len);
+static void append_label_value(text_buffer_t *out, const char *value);
+static void append_value(text_buffer_t *out, double value);
+
+metrics_exporter_t *metrics_exporter_start(const char *listen_address) {
+    struct sockaddr_in addr;
+    int yes = 1;
+    metrics_exporter_t *exporter;
+    
+    if (parse_listen(listen_address, &addr) != 0) {
+        return NULL;
+    }
+    
+    exporter = calloc(1, sizeof(metrics_exporter_t));
+    if (!exporter) {
+        return NULL;
+    }
+    
+    exporter->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (exporter->listen_fd == -1) {
+        free(exporter);
+        return NULL;
+    }
+    
+    setsockopt(exporter->listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(exporter->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(exporter->listen_fd, 16) == -1) {
+        close(exporter->listen_fd);
+        free(exporter);
+        return NULL;
+    }
+    
+    exporter->render_index = 0;
+    exporter->ready_index = 1;
+    exporter->serve_index = 2;
+    pthread_mutex_init(&exporter->lock, NULL);
+    
+    if (pthread_create(&exporter->thread, NULL, server_thread, exporter) != 0) {
+        pthread_mutex_destroy(&exporter->lock);
+        close(exporter->listen_fd);
+        free(exporter);
+        return NULL;
+    }
+    
+    return exporter;
+}
+
+void metrics_exporter_stop(metrics_exporter_t *exporter) {
+    if (!exporter) {
+        return;
+    }
+    
+    exporter->stop = 1;
+    pthread_join(exporter->thread, NULL);
+    close(exporter->listen_fd);
+    
+    for (int i = 0; i < 3; i++) {
+        text_buffer_free(&exporter->buffers[i]);
+    }
+    pthread_mutex_destroy(&exporter->lock);
+    free(exporter);
+}
+
+int metrics_exporter_publish(metrics_exporter_t *exporter, const monitor_state_t *state) {
+    text_buffer_t *out = &exporter->buffers[exporter->render_index];
+    
+    /* sized once for the current container count, then reused every tick */
+    text_buffer_reset(out);
+    if (text_buffer_reserve(out, (size_t)state->container_count * METRICS_BYTES_PER_CONTAINER) != 0 ||
+        metrics_render(out, state) != 0) {
+        return -1;
+    }
+    
+    pthread_mutex_lock(&exporter->lock);
+    int ready = exporter->ready_index;
+    exporter->ready_index = exporter->render_index;
+    exporter->render_index = ready;
+    exporter->fresh = 1;
+    exporter->published = 1;
+    pthread_mutex_unlock(&exporter->lock);
+    
+    return 0;
+}
+
+int metrics_render(text_buffer_t *out, const monitor_state_t *state) {
+    int running = 0;
+    
+    text_buffer_reset(out);
+    
+    for (int i = 0; i < state->container_slots; i++) {
+        if (state->containers[i].in_use && state->containers[i].is_running) {
+            running++;
+        }
+    }
+    
+    text_buffer_printf(out,
+                       "# HELP docker_monitor_containers Containers known to the monitor.\n"
+                       "# TYPE docker_monitor_containers gauge\n"
+                       "docker_monitor_containers %d\n"
+                       "# HELP docker_monitor_containers_running Containers with fresh statistics.\n"
+                       "# TYPE docker_monitor_containers_running gauge\n"
+                       "docker_monitor_containers_running %d\n"
+                       "# HELP docker_monitor_last_update_timestamp_seconds Time of the last collection.\n"
+                       "# TYPE docker_monitor_last_update_timestamp_seconds gauge\n"
+                       "docker_monitor_last_update_timestamp_seconds %ld\n",
+                       state->container_count, running, (long)state->last_update);
+    
+    text_buffer_append_str(out, "# HELP docker_monitor_host_up Whether the last poll of the host succeeded.\n"
+                                "# TYPE docker_monitor_host_up gauge\n");
+    for (int host = 0; host < state->host_count; host++) {
+        text_buffer_append(out, "docker_monitor_host_up{host=\"", 29);
+        append_label_value(out, state->hosts[host].name);
+        text_buffer_append(out, "\"} ", 3);
+        text_buffer_append_u64(out, state->hosts[host].reachable);
+        text_buffer_append(out, "\n", 1);
+    }
+    
+    for (size_t f = 0; f < sizeof(metric_families) / sizeof(metric_families[0]); f++) {
+        const metric_family_t *family = &metric_families[f];
+        
+        text_buffer_printf(out, "# HELP %s %s\n# TYPE %s %s\n", family->name, family->help, family->name, family->type);
+        
+        for (int i = 0; i < state->container_slots; i++) {
+            const container_monitor_t *container = &state->containers[i];
+            if (!container->in_use || (family->running_only && !container->is_running)) continue;
+            
+            text_buffer_append_str(out, family->name);
+            text_buffer_append(out, "{host=\"", 7);
+            append_label_value(out, monitor_host_name(state, container->info.host));
+            text_buffer_append(out, "\",id=\"", 6);
+            append_label_value(out, container->info.id);
+            text_buffer_append(out, "\",name=\"", 8);
+            append_label_value(out, container->info.name);
+            text_buffer_append(out, "\",image=\"", 9);
+            append_label_value(out, container->info.image);
+            text_buffer_append(out, "\"} ", 3);
+            append_value(out, family->value(container));
+            text_buffer_append(out, "\n", 1);
+        }
+    }
+    
+    return out->failed ? -1 : 0;
+}
+
+static int parse_listen(const char *listen_address, struct sockaddr_in *addr) {
+    char host[64];
+    const char *colon = strrchr(listen_address, ':');
+    const char *port_str = colon ? colon + 1 : listen_address;
+    char *end;
+    long port = strtol(port_str, &end, 10);
+    
+    if (*port_str == '\0' || *end != '\0' || port <= 0 || port > 65535) {
+        return -1;
+    }
+    
+    snprintf(host, sizeof(host), "%.*s", colon ? (int)(colon - listen_address) : 0, listen_address);
+    if (host[0] == '\0') {
+        snprintf(host, sizeof(host), "%s", METRICS_DEFAULT_ADDRESS);
+    }
+    
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons((uint16_t)port);
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1 ? 0 : -1;
+}
+
+static void *server_thread(void *arg) {
+    metrics_exporter_t *exporter = arg;
+    struct pollfd pfd = { .fd = exporter->listen_fd, .events = POLLIN };
+    
+    while (!exporter->stop) {
+        int ready = poll(&pfd, 1, METRICS_POLL_MS);
+        if (ready <= 0) {
+            continue;
+        }
+        
+        int fd = accept4(exporter->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+        
+        /* scrapes are served one at a time; a stuck client costs at most the timeout */
+        struct timeval timeout = { .tv_sec = METRICS_IO_TIMEOUT, .tv_usec = 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve_client(exporter, fd);
+        close(fd);
+    }
+    
+    return NULL;
+}
+
+static void serve_client(metrics_exporter_t *exporter, int fd) {
+    char request[METRICS_REQUEST_SIZE];
+    char header[256];
+    size_t len = 0;
+    
+    while (len < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        len += n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n")) break;
+    }
+    
+    int is_get = strncmp(request, "GET ", 4) == 0;
+    const char *path = request + (is_get ? 4 : 0);
+    
+    if (!is_get || (strncmp(path, "/metrics ", 9) != 0 && strncmp(path, "/metrics?", 9) != 0)) {
+        static const char not_found[] =
+            "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\nConnection: close\r\n\r\nnot found\n";
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+    
+    pthread_mutex_lock(&exporter->lock);
+    if (exporter->fresh) {
+        int serve = exporter->serve_index;
+        exporter->serve_index = exporter->ready_index;
+        exporter->ready_index = serve;
+        exporter->fresh = 0;
+    }
+    int published = exporter->published;
+    pthread_mutex_unlock(&exporter->lock);
+    
+    if (!published) {
+        static const char unavailable[] =
+            "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 15\r\nConnection: close\r\n\r\nno samples yet\n";
+        send_all(fd, unavailable, sizeof(unavailable) - 1);
+        return;
+    }
+    
+    /* only this thread touches the serve buffer, so it can be sent without the lock */
+    const text_buffer_t *body = &exporter->buffers[exporter->serve_index];
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n",
+                              body->len);
+    
+    if (send_all(fd, header, header_len) == 0) {
+        send_all(fd, body->data, body->len);
+    }
+}
+
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void append_label_value(text_buffer_t *out, const char *value) {
+    const char *run = value;
+    
+    for (const char *p = value; *p; p++) {
+        if (*p != '\\' && *p != '"' && *p != '\n') continue;
+        
+        text_buffer_append(out, run, p - run);
+        text_buffer_append(out, *p == '\n' ? "\\n" : *p == '"' ? "\\\"" : "\\\\", 2);
+        run = p + 1;
+    }
+    text_buffer_append_str(out, run);
+}
+
+static void append_value(text_buffer_t *out, double value) {
+    /* counters and byte gauges are whole numbers; skip printf for them */
+    if (value >= 0 && value < 9007199254740992.0 && value == (double)(uint64_t)value) {
+        text_buffer_append_u64(out, (uint64_t)value);
+    } else {
+        text_buffer_printf(out, "%.15g", value);
+    }
+}
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/poll_scheduler.h"
+
+/* every deadline is at most POLL_MAX_EVERY ticks ahead, so one turn of the
+   wheel never wraps onto itself */
+#define WHEEL_SLOTS 64
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+/* percentage points of CPU plus memory moved between two polls, smoothed */
+#define ACTIVE_CHANGE 1.0
+#define IDLE_CHANGE 0.2
+
+typedef struct {
+    int *slots;
+    int count;
+    int capacity;
+} wheel_bucket_t;
+
+typedef struct {
+    int slot;
+    uint64_t sample_ns;
+    double cpu_percent;
+    double memory_percent;
+} due_entry_t;
+
+struct poll_scheduler {
+    int64_t tick;
+    int max_every;
+    int budget;
+    wheel_bucket_t wheel[WHEEL_SLOTS];
+    due_entry_t *due;
+    int due_count;
+    int due_capacity;
+    int *spent;
+    int spent_capacity;
+};
+
+static int schedule(poll_scheduler_t *scheduler, container_monitor_t *container, int slot, int64_t tick);
+static int compare_due(const void *a, const void *b);
+static void apply_budget(poll_scheduler_t *scheduler, monitor_state_t *state);
+
+poll_scheduler_t *poll_scheduler_create(int max_every, int budget) {
+    poll_scheduler_t *scheduler = calloc(1, sizeof(poll_scheduler_t));
+    if (!scheduler) {
+        return NULL;
+    }
+    
+    if (max_every < 1) max_every = 1;
+    if (max_every > POLL_MAX_EVERY) max_every = POLL_MAX_EVERY;
+    scheduler->max_every = max_every;
+    scheduler->budget = budget > 0 ? budget : 0;
+    return scheduler;
+}
+
+void poll_scheduler_destroy(poll_scheduler_t *scheduler) {
+    if (!scheduler) {
+        return;
+    }
+    
+    for (int i = 0; i < WHEEL_SLOTS; i++) {
+        free(scheduler->wheel[i].slots);
+    }
+    free(scheduler->due);
+    free(scheduler->spent);
+    free(scheduler);
+}
+
+void poll_scheduler_add(poll_scheduler_t *scheduler, container_monitor_t *container, int slot) {
+    container->poll_every = 1;
+    container->poll_activity = 0.0f;
+    schedule(scheduler, container, slot, scheduler->tick + 1);
+}
+
+int poll_scheduler_begin(poll_scheduler_t *scheduler, monitor_state_t *state) {
+    wheel_bucket_t *bucket = &scheduler->wheel[++scheduler->tick & WHEEL_MASK];
+    
+    if (scheduler->due_capacity < bucket->count) {
+        due_entry_t *due = realloc(scheduler->due, bucket->count * sizeof(due_entry_t));
+        if (!due) {
+            return 0;
+        }
+        scheduler->due = due;
+        scheduler->due_capacity = bucket->count;
+    }
+    
+    /* entries left behind by removed containers or slots reused since no
+       longer match the container's deadline and are dropped here */
+    scheduler->due_count = 0;
+    for (int i = 0; i < bucket->count; i++) {
+        int slot = bucket->slots[i];
+        if (slot >= state->container_slots) {
+            continue;
+        }
+        
+        container_monitor_t *container = &state->containers[slot];
+        if (!container->in_use || container->poll_due != scheduler->tick) {
+            continue;
+        }
+        container->poll_due = -1;
+        
+        due_entry_t *entry = &scheduler->due[scheduler->due_count++];
+        entry->slot = slot;
+        entry->sample_ns = container->stats.sample_ns;
+        entry->cpu_percent = container->cpu_percent;
+        entry->memory_percent = container->memory_percent;
+    }
+    bucket->count = 0;
+    
+    if (scheduler->budget > 0) {
+        apply_budget(scheduler, state);
+    }
+    
+    return scheduler->due_count;
+}
+
+int poll_scheduler_slot(const poll_scheduler_t *scheduler, int index) {
+    return scheduler->due[index].slot;
+}
+
+void poll_scheduler_end(poll_scheduler_t *scheduler, monitor_state_t *state) {
+    for (int i = 0; i < scheduler->due_count; i++) {
+        const due_entry_t *entry = &scheduler->due[i];
+        container_monitor_t *container = &state->containers[entry->slot];
+        
+        if (!container->in_use) {
+            continue;
+        }
+        
+        /* a failed poll is retried, but not at full rate */
+        if (!container->is_running) {
+            container->poll_every = scheduler->max_every;
+        } else if (entry->sample_ns > 0) {
+            double cpu_change = container->cpu_percent - entry->cpu_percent;
+            double memory_change = container->memory_percent - entry->memory_percent;
+            double change = (cpu_change < 0 ? -cpu_change : cpu_change) +
+                            (memory_change < 0 ? -memory_change : memory_change);
+            
+            container->poll_activity = (container->poll_activity + change) / 2.0;
+            if (container->poll_activity >= ACTIVE_CHANGE) {
+                container->poll_every = 1;
+            } else if (container->poll_activity < IDLE_CHANGE && container->poll_every < scheduler->max_every) {
+                container->poll_every *= 2;
+                if (container->poll_every > scheduler->max_every) {
+                    container->poll_every = scheduler->max_every;
+                }
+            }
+        }
+        
+        schedule(scheduler, container, entry->slot, scheduler->tick + container->poll_every);
+    }
+    scheduler->due_count = 0;
+}
+
+static int schedule(poll_scheduler_t *scheduler, container_monitor_t *container, int slot, int64_t tick) {
+    wheel_bucket_t *bucket = &scheduler->wheel[tick & WHEEL_MASK];
+    
+    if (bucket->count == bucket->capacity) {
+        int capacity = bucket->capacity ? bucket->capacity * 2 : 16;
+        int *slots = realloc(bucket->slots, capacity * sizeof(int));
+        if (!slots) {
+            return -1;
+        }
+        bucket->slots = slots;
+        bucket->capacity = capacity;
+    }
+    
+    bucket->slots[bucket->count++] = slot;
+    container->poll_due = tick;
+    return 0;
+}
+
+static int compare_due(const void *a, const void *b) {
+    const due_entry_t *x = a;
+    const due_entry_t *y = b;
+    
+    if (x->sample_ns != y->sample_ns) {
+        return x->sample_ns < y->sample_ns ? -1 : 1;
+    }
+    return x->slot - y->slot;
+}
+
+/* oldest samples go first, so a daemon that is always over budget still
+   gets every container polled in turn */
+static void apply_budget(poll_scheduler_t *scheduler, monitor_state_t *state) {
+    if (scheduler->spent_capacity < state->host_count) {
+        int *spent = realloc(scheduler->spent, state->host_count * sizeof(int));
+        if (!spent) {
+            return;
+        }
+        scheduler->spent = spent;
+        scheduler->spent_capacity = state->host_count;
+    }
+    
+    /* a full list fetch this tick counts against the same daemon */
+    for (int host = 0; host < state->host_count; host++) {
+        scheduler->spent[host] = state->hosts[host].resync;
+    }
+    
+    qsort(scheduler->due, scheduler->due_count, sizeof(due_entry_t), compare_due);
+    
+    int kept = 0;
+    for (int i = 0; i < scheduler->due_count; i++) {
+        due_entry_t entry = scheduler->due[i];
+        container_monitor_t *container = &state->containers[entry.slot];
+        int host = container->info.host;
+        
+        if (host >= 0 && host < state->host_count && scheduler->spent[host] >= scheduler->budget) {
+            schedule(scheduler, container, entry.slot, scheduler->tick + 1);
+            continue;
+        }
+        if (host >= 0 && host < state->host_count) {
+            scheduler->spent[host]++;
+        }
+        scheduler->due[kept++] = entry;
+    }
+    scheduler->due_count = kept;
+}
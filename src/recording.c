@@ -0,0 +1,734 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "../include/recording.h"
+#include "../include/docker_api.h"
+#include "../include/text_buffer.h"
+
+#define FRAME_SESSION 1
+#define FRAME_TICK 2
+/* a tick that also carries the creation time of every container; plain
+   FRAME_TICK is only read, from files written before it existed */
+#define FRAME_TICK_CREATED 3
+#define VARINT_MAX_BYTES 10
+#define RECORD_FIELD_COUNT 14
+/* the creation time keeps its delta state after the stats counters */
+#define RECORD_FIELD_CREATED RECORD_FIELD_COUNT
+#define RECORD_FLAG_RUNNING 1
+#define RECORDING_MAX_STRINGS 65536
+#define STRING_MIN_CAPACITY 256
+
+typedef uint64_t record_fields_t[RECORD_FIELD_COUNT + 1];
+
+/* strings are numbered in order of first use within a session; a reference
+   is (number << 1 | new) and a new string is followed by its bytes */
+struct recording_writer {
+    int fd;
+    off_t size;
+    int need_session;
+    int64_t last_time;
+    text_buffer_t payload;
+    char **strings;
+    int string_count;
+    int string_capacity;
+    int32_t *index;
+    int index_capacity;
+    record_fields_t *previous;
+};
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t len;
+} record_string_t;
+
+struct recording_reader {
+    uint8_t *map;
+    size_t size;
+    size_t offset;
+    int64_t last_time;
+    record_string_t *strings;
+    int string_count;
+    int string_capacity;
+    record_fields_t *previous;
+    char *seen;
+    int seen_capacity;
+};
+
+typedef struct {
+    const uint8_t *pos;
+    const uint8_t *end;
+    int failed;
+} cursor_t;
+
+static int encode_varint(uint8_t *out, uint64_t value);
+static void put_varint(text_buffer_t *buffer, uint64_t value);
+static void put_signed(text_buffer_t *buffer, int64_t value);
+static int put_string_ref(recording_writer_t *writer, const char *str);
+static int writer_intern(recording_writer_t *writer, const char *str, int *is_new);
+static int writer_index_rebuild(recording_writer_t *writer, int capacity);
+static void writer_reset_strings(recording_writer_t *writer);
+static int writer_prepare_file(recording_writer_t *writer);
+static int write_frame(recording_writer_t *writer, int type);
+static int write_session(recording_writer_t *writer, const monitor_state_t *state);
+static size_t valid_length(const uint8_t *data, size_t size);
+static uint64_t get_varint(cursor_t *cursor);
+static int64_t get_signed(cursor_t *cursor);
+static int get_string(recording_reader_t *reader, cursor_t *cursor);
+static void copy_string(char *dest, size_t size, const record_string_t *str);
+static int read_session(recording_reader_t *reader, cursor_t *cursor, monitor_state_t *state);
+static int read_tick(recording_reader_t *reader, cursor_t *cursor, monitor_state_t *state, int has_created);
+static void stats_to_fields(const container_stats_t *stats, uint64_t *fields);
+static void fields_to_stats(const uint64_t *fields, container_stats_t *stats);
+static int grow_previous(record_fields_t **previous, int capacity, int new_capacity);
+static uint32_t hash_string(const char *str);
+
+recording_writer_t *recording_writer_open(const char *path) {
+    recording_writer_t *writer = calloc(1, sizeof(recording_writer_t));
+    if (!writer) {
+        return NULL;
+    }
+    
+    writer->need_session = 1;
+    writer->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        print_error("Не удалось открыть файл записи");
+        free(writer);
+        return NULL;
+    }
+    
+    if (writer_prepare_file(writer) != 0 || text_buffer_init(&writer->payload, 4096) != 0) {
+        recording_writer_close(writer);
+        return NULL;
+    }
+    
+    return writer;
+}
+
+int recording_write_tick(recording_writer_t *writer, const monitor_state_t *state) {
+    text_buffer_t *payload = &writer->payload;
+    
+    /* a new session bounds the string table, statuses like "Up 5 minutes" keep changing */
+    if (writer->need_session || writer->string_count > RECORDING_MAX_STRINGS) {
+        writer_reset_strings(writer);
+        if (write_session(writer, state) != 0) {
+            return -1;
+        }
+    }
+    
+    text_buffer_reset(payload);
+    put_signed(payload, (int64_t)state->last_update - writer->last_time);
+    put_varint(payload, state->container_count);
+    
+    for (int i = 0; i < state->container_slots; i++) {
+        const container_monitor_t *container = &state->containers[i];
+        if (!container->in_use) continue;
+        
+        int number = put_string_ref(writer, container->info.id);
+        put_string_ref(writer, monitor_host_name(state, container->info.host));
+        put_string_ref(writer, container->info.name);
+        put_string_ref(writer, container->info.image);
+        put_string_ref(writer, container->info.status);
+        if (number < 0) {
+            break;
+        }
+        
+        uint8_t flags = container->is_running ? RECORD_FLAG_RUNNING : 0;
+        uint64_t *previous = writer->previous[number];
+        text_buffer_append(payload, (const char *)&flags, 1);
+        put_signed(payload, (int64_t)((uint64_t)container->info.created - previous[RECORD_FIELD_CREATED]));
+        previous[RECORD_FIELD_CREATED] = (uint64_t)container->info.created;
+        if (!container->is_running) {
+            continue;
+        }
+        
+        uint64_t fields[RECORD_FIELD_COUNT];
+        stats_to_fields(&container->stats, fields);
+        for (int f = 0; f < RECORD_FIELD_COUNT; f++) {
+            put_signed(payload, (int64_t)(fields[f] - previous[f]));
+            previous[f] = fields[f];
+        }
+    }
+    
+    /* the string table and deltas already moved on, so start over rather than
+       leave later frames referring to a tick that was never written */
+    if (payload->failed) {
+        writer->need_session = 1;
+        return -1;
+    }
+    
+    writer->last_time = state->last_update;
+    return write_frame(writer, FRAME_TICK_CREATED);
+}
+
+void recording_writer_close(recording_writer_t *writer) {
+    if (!writer) {
+        return;
+    }
+    
+    if (writer->fd >= 0) {
+        close(writer->fd);
+    }
+    for (int i = 0; i < writer->string_count; i++) {
+        free(writer->strings[i]);
+    }
+    free(writer->strings);
+    free(writer->index);
+    free(writer->previous);
+    text_buffer_free(&writer->payload);
+    free(writer);
+}
+
+recording_reader_t *recording_reader_open(const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    
+    if (fd < 0) {
+        print_error("Не удалось открыть файл записи");
+        return NULL;
+    }
+    
+    if (fstat(fd, &st) != 0 || st.st_size < RECORDING_MAGIC_LEN) {
+        print_error("Файл не является записью docker_monitor");
+        close(fd);
+        return NULL;
+    }
+    
+    uint8_t *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        print_error("Не удалось отобразить файл записи в память");
+        return NULL;
+    }
+    
+    if (memcmp(map, RECORDING_MAGIC, RECORDING_MAGIC_LEN) != 0) {
+        print_error("Файл не является записью docker_monitor");
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    
+    recording_reader_t *reader = calloc(1, sizeof(recording_reader_t));
+    if (!reader) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    
+    reader->map = map;
+    reader->size = st.st_size;
+    reader->offset = RECORDING_MAGIC_LEN;
+    return reader;
+}
+
+int recording_reader_next(recording_reader_t *reader, monitor_state_t *state) {
+    while (reader->offset < reader->size) {
+        int type = reader->map[reader->offset];
+        cursor_t cursor = { reader->map + reader->offset + 1, reader->map + reader->size, 0 };
+        uint64_t len = get_varint(&cursor);
+        
+        /* a torn last frame is what an interrupted recording leaves behind */
+        if (cursor.failed || len > (uint64_t)(cursor.end - cursor.pos)) {
+            return 0;
+        }
+        
+        cursor.end = cursor.pos + len;
+        reader->offset = cursor.end - reader->map;
+        
+        if (type == FRAME_SESSION) {
+            if (read_session(reader, &cursor, state) != 0) {
+                return -1;
+            }
+        } else if (type == FRAME_TICK || type == FRAME_TICK_CREATED) {
+            return read_tick(reader, &cursor, state, type == FRAME_TICK_CREATED) == 0 ? 1 : -1;
+        }
+        /* unknown frame types are skipped so older readers survive format additions */
+    }
+    
+    return 0;
+}
+
+void recording_reader_close(recording_reader_t *reader) {
+    if (!reader) {
+        return;
+    }
+    
+    munmap(reader->map, reader->size);
+    free(reader->strings);
+    free(reader->previous);
+    free(reader->seen);
+    free(reader);
+}
+
+static int encode_varint(uint8_t *out, uint64_t value) {
+    int len = 0;
+    
+    while (value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    
+    return len;
+}
+
+static void put_varint(text_buffer_t *buffer, uint64_t value) {
+    if (text_buffer_reserve(buffer, VARINT_MAX_BYTES) != 0) {
+        return;
+    }
+    
+    buffer->len += encode_varint((uint8_t *)buffer->data + buffer->len, value);
+    buffer->data[buffer->len] = '\0';
+}
+
+/* zigzag keeps small negative deltas (counter resets, clock steps) short */
+static void put_signed(text_buffer_t *buffer, int64_t value) {
+    put_varint(buffer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static int put_string_ref(recording_writer_t *writer, const char *str) {
+    int is_new = 0;
+    int number = writer_intern(writer, str, &is_new);
+    
+    if (number < 0) {
+        writer->payload.failed = 1;
+        return -1;
+    }
+    
+    put_varint(&writer->payload, (uint64_t)number << 1 | is_new);
+    if (is_new) {
+        size_t len = strlen(str);
+        put_varint(&writer->payload, len);
+        text_buffer_append(&writer->payload, str, len);
+    }
+    
+    return number;
+}
+
+static int writer_intern(recording_writer_t *writer, const char *str, int *is_new) {
+    if ((writer->string_count + 1) * 2 > writer->index_capacity) {
+        int capacity = writer->index_capacity ? writer->index_capacity * 2 : STRING_MIN_CAPACITY;
+        if (writer_index_rebuild(writer, capacity) != 0) {
+            return -1;
+        }
+    }
+    
+    uint32_t mask = writer->index_capacity - 1;
+    uint32_t position = hash_string(str) & mask;
+    while (writer->index[position] != 0) {
+        int number = writer->index[position] - 1;
+        if (strcmp(writer->strings[number], str) == 0) {
+            *is_new = 0;
+            return number;
+        }
+        position = (position + 1) & mask;
+    }
+    
+    if (writer->string_count == writer->string_capacity) {
+        int capacity = writer->string_capacity ? writer->string_capacity * 2 : STRING_MIN_CAPACITY;
+        char **strings = realloc(writer->strings, capacity * sizeof(char *));
+        if (!strings) {
+            return -1;
+        }
+        writer->strings = strings;
+        if (grow_previous(&writer->previous, writer->string_capacity, capacity) != 0) {
+            return -1;
+        }
+        writer->string_capacity = capacity;
+    }
+    
+    char *copy = strdup(str);
+    if (!copy) {
+        return -1;
+    }
+    
+    writer->strings[writer->string_count] = copy;
+    writer->index[position] = writer->string_count + 1;
+    *is_new = 1;
+    return writer->string_count++;
+}
+
+static int writer_index_rebuild(recording_writer_t *writer, int capacity) {
+    int32_t *index = calloc(capacity, sizeof(int32_t));
+    if (!index) {
+        return -1;
+    }
+    
+    uint32_t mask = capacity - 1;
+    for (int i = 0; i < writer->string_count; i++) {
+        uint32_t position = hash_string(writer->strings[i]) & mask;
+        while (index[position] != 0) {
+            position = (position + 1) & mask;
+        }
+        index[position] = i + 1;
+    }
+    
+    free(writer->index);
+    writer->index = index;
+    writer->index_capacity = capacity;
+    return 0;
+}
+
+static void writer_reset_strings(recording_writer_t *writer) {
+    for (int i = 0; i < writer->string_count; i++) {
+        free(writer->strings[i]);
+    }
+    writer->string_count = 0;
+    
+    if (writer->index) {
+        memset(writer->index, 0, writer->index_capacity * sizeof(int32_t));
+    }
+    if (writer->previous) {
+        memset(writer->previous, 0, writer->string_capacity * sizeof(record_fields_t));
+    }
+}
+
+static int writer_prepare_file(recording_writer_t *writer) {
+    struct stat st;
+    
+    if (fstat(writer->fd, &st) != 0) {
+        print_error("Не удалось открыть файл записи");
+        return -1;
+    }
+    
+    if (st.st_size == 0) {
+        if (write(writer->fd, RECORDING_MAGIC, RECORDING_MAGIC_LEN) != RECORDING_MAGIC_LEN) {
+            print_error("Ошибка записи в файл записи");
+            return -1;
+        }
+        writer->size = RECORDING_MAGIC_LEN;
+        return 0;
+    }
+    
+    if (st.st_size < RECORDING_MAGIC_LEN) {
+        print_error("Файл не является записью docker_monitor");
+        return -1;
+    }
+    
+    uint8_t *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, writer->fd, 0);
+    if (map == MAP_FAILED) {
+        print_error("Не удалось отобразить файл записи в память");
+        return -1;
+    }
+    
+    if (memcmp(map, RECORDING_MAGIC, RECORDING_MAGIC_LEN) != 0) {
+        print_error("Файл не является записью docker_monitor");
+        munmap(map, st.st_size);
+        return -1;
+    }
+    
+    /* cut a torn frame off so the new session starts on a frame boundary */
+    writer->size = valid_length(map, st.st_size);
+    munmap(map, st.st_size);
+    if (writer->size < st.st_size && ftruncate(writer->fd, writer->size) != 0) {
+        print_error("Ошибка записи в файл записи");
+        return -1;
+    }
+    
+    return 0;
+}
+
+static int write_frame(recording_writer_t *writer, int type) {
+    uint8_t header[1 + VARINT_MAX_BYTES];
+    size_t header_len = 1;
+    
+    header[0] = (uint8_t)type;
+    header_len += encode_varint(header + 1, writer->payload.len);
+    
+    struct iovec iov[2] = {
+        { header, header_len },
+        { writer->payload.data, writer->payload.len }
+    };
+    ssize_t total = header_len + writer->payload.len;
+    ssize_t written = writev(writer->fd, iov, 2);
+    
+    if (written != total) {
+        /* never leave a partial frame in the middle of the file */
+        if (written > 0 && ftruncate(writer->fd, writer->size) != 0) {
+            print_error("Ошибка записи в файл записи");
+        }
+        writer->need_session = 1;
+        print_error("Ошибка записи в файл записи");
+        return -1;
+    }
+    
+    writer->size += total;
+    return 0;
+}
+
+static int write_session(recording_writer_t *writer, const monitor_state_t *state) {
+    text_buffer_t *payload = &writer->payload;
+    
+    text_buffer_reset(payload);
+    put_signed(payload, state->last_update);
+    put_varint(payload, state->interval > 0 ? state->interval : 0);
+    if (payload->failed) {
+        return -1;
+    }
+    
+    writer->last_time = state->last_update;
+    if (write_frame(writer, FRAME_SESSION) != 0) {
+        return -1;
+    }
+    
+    writer->need_session = 0;
+    return 0;
+}
+
+static size_t valid_length(const uint8_t *data, size_t size) {
+    size_t offset = RECORDING_MAGIC_LEN;
+    
+    while (offset < size) {
+        cursor_t cursor = { data + offset + 1, data + size, 0 };
+        uint64_t len = get_varint(&cursor);
+        if (cursor.failed || len > (uint64_t)(cursor.end - cursor.pos)) {
+            break;
+        }
+        offset = cursor.pos - data + len;
+    }
+    
+    return offset;
+}
+
+static uint64_t get_varint(cursor_t *cursor) {
+    uint64_t value = 0;
+    
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor->pos >= cursor->end) {
+            break;
+        }
+        uint8_t byte = *cursor->pos++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    
+    cursor->failed = 1;
+    return 0;
+}
+
+static int64_t get_signed(cursor_t *cursor) {
+    uint64_t value = get_varint(cursor);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static int get_string(recording_reader_t *reader, cursor_t *cursor) {
+    uint64_t ref = get_varint(cursor);
+    uint64_t number = ref >> 1;
+    
+    if (cursor->failed) {
+        return -1;
+    }
+    if (!(ref & 1)) {
+        return number < (uint64_t)reader->string_count ? (int)number : -1;
+    }
+    if (number != (uint64_t)reader->string_count) {
+        return -1;
+    }
+    
+    uint64_t len = get_varint(cursor);
+    if (cursor->failed || len > (uint64_t)(cursor->end - cursor->pos)) {
+        return -1;
+    }
+    
+    if (reader->string_count == reader->string_capacity) {
+        int capacity = reader->string_capacity ? reader->string_capacity * 2 : STRING_MIN_CAPACITY;
+        record_string_t *strings = realloc(reader->strings, capacity * sizeof(record_string_t));
+        if (!strings) {
+            return -1;
+        }
+        reader->strings = strings;
+        if (grow_previous(&reader->previous, reader->string_capacity, capacity) != 0) {
+            return -1;
+        }
+        reader->string_capacity = capacity;
+    }
+    
+    reader->strings[reader->string_count].data = cursor->pos;
+    reader->strings[reader->string_count].len = len;
+    cursor->pos += len;
+    return reader->string_count++;
+}
+
+static void copy_string(char *dest, size_t size, const record_string_t *str) {
+    size_t len = str->len < size - 1 ? str->len : size - 1;
+    memcpy(dest, str->data, len);
+    dest[len] = '\0';
+}
+
+static int read_session(recording_reader_t *reader, cursor_t *cursor, monitor_state_t *state) {
+    int64_t start = get_signed(cursor);
+    uint64_t interval = get_varint(cursor);
+    
+    if (cursor->failed) {
+        return -1;
+    }
+    
+    if (interval > 0) {
+        state->interval = interval;
+    }
+    
+    /* a session is a separate run that started from an empty table */
+    monitor_table_free(state);
+    
+    reader->last_time = start;
+    reader->string_count = 0;
+    if (reader->previous) {
+        memset(reader->previous, 0, reader->string_capacity * sizeof(record_fields_t));
+    }
+    
+    return 0;
+}
+
+static int read_tick(recording_reader_t *reader, cursor_t *cursor, monitor_state_t *state, int has_created) {
+    int64_t delta = get_signed(cursor);
+    uint64_t count = get_varint(cursor);
+    
+    /* every entry takes at least six bytes, which bounds count by the frame */
+    if (cursor->failed || count > (uint64_t)(cursor->end - cursor->pos)) {
+        return -1;
+    }
+    reader->last_time += delta;
+    
+    int needed = state->container_slots + (int)count + 1;
+    if (needed > reader->seen_capacity) {
+        char *seen = realloc(reader->seen, needed);
+        if (!seen) {
+            return -1;
+        }
+        reader->seen = seen;
+        reader->seen_capacity = needed;
+    }
+    memset(reader->seen, 0, needed);
+    
+    for (uint64_t i = 0; i < count; i++) {
+        container_info_t info;
+        char host_name[256];
+        int id = get_string(reader, cursor);
+        int host = get_string(reader, cursor);
+        int name = get_string(reader, cursor);
+        int image = get_string(reader, cursor);
+        int status = get_string(reader, cursor);
+        
+        if (id < 0 || host < 0 || name < 0 || image < 0 || status < 0 || cursor->pos >= cursor->end) {
+            return -1;
+        }
+        uint8_t flags = *cursor->pos++;
+        
+        memset(&info, 0, sizeof(info));
+        if (has_created) {
+            reader->previous[id][RECORD_FIELD_CREATED] += (uint64_t)get_signed(cursor);
+            info.created = (time_t)reader->previous[id][RECORD_FIELD_CREATED];
+            if (cursor->failed) {
+                return -1;
+            }
+        }
+        copy_string(info.id, sizeof(info.id), &reader->strings[id]);
+        copy_string(info.name, sizeof(info.name), &reader->strings[name]);
+        copy_string(info.image, sizeof(info.image), &reader->strings[image]);
+        copy_string(info.status, sizeof(info.status), &reader->strings[status]);
+        info.last_seen = reader->last_time;
+        
+        copy_string(host_name, sizeof(host_name), &reader->strings[host]);
+        info.host = monitor_add_host(state, host_name);
+        if (info.host < 0) {
+            return -1;
+        }
+        state->hosts[info.host].reachable = 1;
+        
+        container_monitor_t *container = monitor_add_container(state, &info);
+        
+        if (flags & RECORD_FLAG_RUNNING) {
+            uint64_t *previous = reader->previous[id];
+            for (int f = 0; f < RECORD_FIELD_COUNT; f++) {
+                previous[f] += (uint64_t)get_signed(cursor);
+            }
+            if (cursor->failed) {
+                return -1;
+            }
+            
+            container_stats_t stats;
+            fields_to_stats(previous, &stats);
+            /* a stream recording repeats a sample until the daemon sends the next one */
+            if (container && !(container->is_running && container->stats.sample_ns == stats.sample_ns)) {
+                update_container_stats(container, &stats);
+            }
+        } else if (container) {
+            container->is_running = 0;
+        }
+        
+        if (container) {
+            reader->seen[container - state->containers] = 1;
+        }
+    }
+    
+    for (int slot = 0; slot < state->container_slots; slot++) {
+        if (state->containers[slot].in_use && !reader->seen[slot]) {
+            monitor_remove_container(state, state->containers[slot].info.host, state->containers[slot].info.id);
+        }
+    }
+    
+    state->last_update = reader->last_time;
+    return 0;
+}
+
+static void stats_to_fields(const container_stats_t *stats, uint64_t *fields) {
+    fields[0] = stats->cpu_usage;
+    fields[1] = stats->cpu_system_usage;
+    fields[2] = stats->precpu_usage;
+    fields[3] = stats->precpu_system_usage;
+    fields[4] = stats->online_cpus;
+    fields[5] = stats->memory_usage;
+    fields[6] = stats->memory_limit;
+    fields[7] = stats->memory_inactive_file;
+    fields[8] = stats->network_rx_bytes;
+    fields[9] = stats->network_tx_bytes;
+    fields[10] = stats->block_read_bytes;
+    fields[11] = stats->block_write_bytes;
+    fields[12] = (uint64_t)stats->timestamp;
+    fields[13] = stats->sample_ns;
+}
+
+static void fields_to_stats(const uint64_t *fields, container_stats_t *stats) {
+    stats->cpu_usage = fields[0];
+    stats->cpu_system_usage = fields[1];
+    stats->precpu_usage = fields[2];
+    stats->precpu_system_usage = fields[3];
+    stats->online_cpus = (uint32_t)fields[4];
+    stats->memory_usage = fields[5];
+    stats->memory_limit = fields[6];
+    stats->memory_inactive_file = fields[7];
+    stats->network_rx_bytes = fields[8];
+    stats->network_tx_bytes = fields[9];
+    stats->block_read_bytes = fields[10];
+    stats->block_write_bytes = fields[11];
+    stats->timestamp = (time_t)fields[12];
+    stats->sample_ns = fields[13];
+}
+
+static int grow_previous(record_fields_t **previous, int capacity, int new_capacity) {
+    record_fields_t *grown = realloc(*previous, new_capacity * sizeof(record_fields_t));
+    if (!grown) {
+        return -1;
+    }
+    
+    memset(grown + capacity, 0, (new_capacity - capacity) * sizeof(record_fields_t));
+    *previous = grown;
+    return 0;
+}
+
+static uint32_t hash_string(const char *str) {
+    uint32_t hash = 2166136261u;
+    
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
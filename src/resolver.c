@@ -0,0 +1,206 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include "../include/resolver.h"
+
+struct resolver {
+    char host[256];
+    char service[8];
+    pthread_mutex_t lock;
+    resolver_addr_t addrs[RESOLVER_MAX_ADDRS];
+    int count;
+    int64_t expires;
+    /* the lookup in flight; getaddrinfo_a keeps pointers into it */
+    struct addrinfo hints;
+    struct gaicb request;
+    int pending;
+    int last_error;
+};
+
+static int64_t now_ms(void);
+static int start_lookup(resolver_t *resolver);
+static void finish_lookup(resolver_t *resolver, int64_t now);
+static void store_result(resolver_t *resolver, const struct addrinfo *list);
+static void move_to_front(resolver_t *resolver, const resolver_addr_t *addr);
+
+resolver_t *resolver_create(const char *host, int port) {
+    struct addrinfo hints;
+    struct addrinfo *list = NULL;
+    resolver_t *resolver = calloc(1, sizeof(resolver_t));
+    
+    if (!resolver) {
+        return NULL;
+    }
+    
+    snprintf(resolver->host, sizeof(resolver->host), "%s", host);
+    snprintf(resolver->service, sizeof(resolver->service), "%d", port);
+    pthread_mutex_init(&resolver->lock, NULL);
+    
+    resolver->hints.ai_family = AF_UNSPEC;
+    resolver->hints.ai_socktype = SOCK_STREAM;
+    resolver->hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
+    
+    /* an IP address needs no lookup at all */
+    hints = resolver->hints;
+    hints.ai_flags |= AI_NUMERICHOST;
+    if (getaddrinfo(host, resolver->service, &hints, &list) == 0) {
+        store_result(resolver, list);
+        resolver->expires = INT64_MAX;
+        freeaddrinfo(list);
+    }
+    
+    return resolver;
+}
+
+void resolver_destroy(resolver_t *resolver) {
+    if (!resolver) {
+        return;
+    }
+    
+    if (resolver->pending && gai_cancel(&resolver->request) != EAI_CANCELED) {
+        const struct gaicb *list[] = { &resolver->request };
+        
+        while (gai_error(&resolver->request) == EAI_INPROGRESS) {
+            gai_suspend(list, 1, NULL);
+        }
+    }
+    if (resolver->pending && resolver->request.ar_result) {
+        freeaddrinfo(resolver->request.ar_result);
+    }
+    
+    pthread_mutex_destroy(&resolver->lock);
+    free(resolver);
+}
+
+int resolver_lookup(resolver_t *resolver, int timeout_ms, resolver_addr_t *addrs, int max,
+                    char *error, size_t error_size) {
+    int64_t now = now_ms();
+    int count;
+    
+    pthread_mutex_lock(&resolver->lock);
+    finish_lookup(resolver, now);
+    if (!resolver->pending && now >= resolver->expires && start_lookup(resolver) != 0) {
+        resolver->expires = now + RESOLVER_RETRY_SECONDS * 1000;
+    }
+    
+    /* the first lookup of a name is the only one anybody waits for */
+    if (resolver->count == 0 && resolver->pending) {
+        const struct gaicb *list[] = { &resolver->request };
+        int64_t deadline = now + timeout_ms;
+        
+        while (resolver->pending && now < deadline) {
+            struct timespec wait = { (deadline - now) / 1000, (deadline - now) % 1000 * 1000000L };
+            
+            pthread_mutex_unlock(&resolver->lock);
+            gai_suspend(list, 1, &wait);
+            pthread_mutex_lock(&resolver->lock);
+            now = now_ms();
+            finish_lookup(resolver, now);
+        }
+    }
+    
+    count = resolver->count < max ? resolver->count : max;
+    memcpy(addrs, resolver->addrs, count * sizeof(resolver_addr_t));
+    
+    if (count == 0 && error) {
+        if (resolver->pending) {
+            snprintf(error, error_size, "имя не разрешено за %.1f с", timeout_ms / 1000.0);
+        } else {
+            snprintf(error, error_size, "%s", resolver->last_error ? gai_strerror(resolver->last_error)
+                                                                   : "адреса не найдены");
+        }
+    }
+    pthread_mutex_unlock(&resolver->lock);
+    
+    return count > 0 ? count : -1;
+}
+
+void resolver_prefer(resolver_t *resolver, const resolver_addr_t *addr) {
+    pthread_mutex_lock(&resolver->lock);
+    move_to_front(resolver, addr);
+    pthread_mutex_unlock(&resolver->lock);
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* getaddrinfo_a runs the blocking lookup on a glibc helper thread, so a
+   slow or dead resolver never holds up a worker or the main loop */
+static int start_lookup(resolver_t *resolver) {
+    struct gaicb *list[] = { &resolver->request };
+    
+    memset(&resolver->request, 0, sizeof(resolver->request));
+    resolver->request.ar_name = resolver->host;
+    resolver->request.ar_service = resolver->service;
+    resolver->request.ar_request = &resolver->hints;
+    
+    resolver->last_error = getaddrinfo_a(GAI_NOWAIT, list, 1, NULL);
+    resolver->pending = resolver->last_error == 0;
+    return resolver->pending ? 0 : -1;
+}
+
+/* a failed refresh keeps the old addresses and tries again a little later */
+static void finish_lookup(resolver_t *resolver, int64_t now) {
+    if (!resolver->pending) {
+        return;
+    }
+    
+    int result = gai_error(&resolver->request);
+    if (result == EAI_INPROGRESS) {
+        return;
+    }
+    
+    resolver->pending = 0;
+    resolver->last_error = result;
+    if (result == 0) {
+        store_result(resolver, resolver->request.ar_result);
+        resolver->expires = now + RESOLVER_TTL_SECONDS * 1000;
+    } else {
+        resolver->expires = now + RESOLVER_RETRY_SECONDS * 1000;
+    }
+    
+    if (resolver->request.ar_result) {
+        freeaddrinfo(resolver->request.ar_result);
+        resolver->request.ar_result = NULL;
+    }
+}
+
+/* the address that worked before stays in front if the new list has it */
+static void store_result(resolver_t *resolver, const struct addrinfo *list) {
+    resolver_addr_t preferred = resolver->addrs[0];
+    int had_preferred = resolver->count > 0;
+    int count = 0;
+    
+    for (const struct addrinfo *ai = list; ai && count < RESOLVER_MAX_ADDRS; ai = ai->ai_next) {
+        if (ai->ai_addrlen > sizeof(struct sockaddr_storage)) continue;
+        memset(&resolver->addrs[count], 0, sizeof(resolver_addr_t));
+        memcpy(&resolver->addrs[count].addr, ai->ai_addr, ai->ai_addrlen);
+        resolver->addrs[count].len = ai->ai_addrlen;
+        count++;
+    }
+    resolver->count = count;
+    
+    if (had_preferred) {
+        move_to_front(resolver, &preferred);
+    }
+}
+
+static void move_to_front(resolver_t *resolver, const resolver_addr_t *addr) {
+    for (int i = 1; i < resolver->count; i++) {
+        if (resolver->addrs[i].len == addr->len && memcmp(&resolver->addrs[i].addr, &addr->addr, addr->len) == 0) {
+            resolver_addr_t preferred = resolver->addrs[i];
+            
+            memmove(&resolver->addrs[1], &resolver->addrs[0], i * sizeof(resolver_addr_t));
+            resolver->addrs[0] = preferred;
+            break;
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdatomic.h>
+#include "../include/stage_timer.h"
+
+/* log-linear buckets: values below 16 ns get their own bucket, above that
+   every power of two is split into 16 linear steps; anything past 2^40 ns
+   (about 18 minutes) lands in the last bucket */
+#define SUB_BITS 4
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define MAX_MSB 39
+#define STAGE_BUCKETS ((MAX_MSB - SUB_BITS + 2) * SUB_BUCKETS)
+
+static const char *stage_names[STAGE_COUNT] = {
+    "connect", "wait", "receive", "parse_list", "parse_stats", "cgroup", "collect", "alerts", "render", "metrics"
+};
+
+static _Atomic uint64_t bucket_counts[STAGE_COUNT][STAGE_BUCKETS];
+static _Atomic uint64_t stage_counts[STAGE_COUNT];
+static _Atomic uint64_t stage_sums[STAGE_COUNT];
+static _Atomic uint64_t stage_max[STAGE_COUNT];
+
+static int bucket_index(uint64_t value);
+static uint64_t bucket_upper(int index);
+
+uint64_t stage_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint64_t stage_record(stage_id_t stage, uint64_t start) {
+    uint64_t now = stage_now();
+    uint64_t value = now > start ? now - start : 0;
+    uint64_t max = atomic_load_explicit(&stage_max[stage], memory_order_relaxed);
+    
+    atomic_fetch_add_explicit(&bucket_counts[stage][bucket_index(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage_counts[stage], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stage_sums[stage], value, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&stage_max[stage], &max, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    
+    return now;
+}
+
+const char *stage_name(stage_id_t stage) {
+    return (unsigned)stage < STAGE_COUNT ? stage_names[stage] : "";
+}
+
+/* readers race with writers, so the counters may be a few samples apart;
+   the rank is taken from the buckets themselves to stay consistent */
+void stage_summarize(stage_id_t stage, stage_summary_t *summary) {
+    static const double percentiles[] = { 0.50, 0.90, 0.99 };
+    uint64_t *targets[] = { &summary->p50_ns, &summary->p90_ns, &summary->p99_ns };
+    uint64_t counts[STAGE_BUCKETS];
+    uint64_t total = 0;
+    
+    for (int i = 0; i < STAGE_BUCKETS; i++) {
+        counts[i] = atomic_load_explicit(&bucket_counts[stage][i], memory_order_relaxed);
+        total += counts[i];
+    }
+    
+    summary->count = atomic_load_explicit(&stage_counts[stage], memory_order_relaxed);
+    summary->max_ns = atomic_load_explicit(&stage_max[stage], memory_order_relaxed);
+    summary->mean_ns = summary->count > 0
+                       ? atomic_load_explicit(&stage_sums[stage], memory_order_relaxed) / summary->count : 0;
+    
+    for (int p = 0; p < 3; p++) {
+        uint64_t rank = (uint64_t)(percentiles[p] * total + 0.999999);
+        uint64_t seen = 0;
+        
+        *targets[p] = 0;
+        for (int i = 0; i < STAGE_BUCKETS && total > 0; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                *targets[p] = bucket_upper(i);
+                break;
+            }
+        }
+        if (*targets[p] > summary->max_ns) {
+            *targets[p] = summary->max_ns;
+        }
+    }
+}
+
+void stage_print(FILE *out) {
+    fprintf(out, "Задержки по этапам, мкс:\n");
+    /* spelled out: printf pads by bytes, not by Cyrillic letters */
+    fprintf(out, "  этап              число    среднее        p50        p90        p99       макс\n");
+    
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        stage_summary_t summary;
+        
+        stage_summarize(stage, &summary);
+        if (summary.count == 0) {
+            continue;
+        }
+        fprintf(out, "  %-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                stage_names[stage], (unsigned long long)summary.count,
+                summary.mean_ns / 1e3, summary.p50_ns / 1e3, summary.p90_ns / 1e3,
+                summary.p99_ns / 1e3, summary.max_ns / 1e3);
+    }
+    fflush(out);
+}
+
+static int bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (int)value;
+    }
+    
+    int msb = 63 - __builtin_clzll(value);
+    if (msb > MAX_MSB) {
+        return STAGE_BUCKETS - 1;
+    }
+    return (msb - SUB_BITS + 1) * SUB_BUCKETS + (int)((value >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+static uint64_t bucket_upper(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t lower = (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include "../include/stats_stream.h"
+#include "../include/docker_api.h"
+
+#define STREAM_MAX_EVENTS 64
+
+typedef struct {
+    char id[MAX_CONTAINER_ID];
+    http_stream_t http;
+    monitor_state_t *state;
+    int slot;
+} stream_conn_t;
+
+/* streams are indexed by container slot, which stays stable while the container exists */
+struct stats_stream {
+    int epoll_fd;
+    stream_conn_t **by_slot;
+    int slot_capacity;
+    int count;
+};
+
+static container_monitor_t *find_container(stream_conn_t *conn);
+static void handle_stats_line(void *ctx, char *line, size_t len);
+static int open_conn(stats_stream_t *streams, monitor_state_t *state, int slot);
+static void close_conn(stats_stream_t *streams, int slot);
+
+stats_stream_t *stats_stream_create(void) {
+    stats_stream_t *streams = calloc(1, sizeof(stats_stream_t));
+    if (!streams) {
+        return NULL;
+    }
+    
+    streams->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (streams->epoll_fd == -1) {
+        free(streams);
+        return NULL;
+    }
+    
+    return streams;
+}
+
+void stats_stream_destroy(stats_stream_t *streams) {
+    if (!streams) {
+        return;
+    }
+    
+    for (int slot = 0; slot < streams->slot_capacity; slot++) {
+        close_conn(streams, slot);
+    }
+    
+    close(streams->epoll_fd);
+    free(streams->by_slot);
+    free(streams);
+}
+
+int stats_stream_count(const stats_stream_t *streams) {
+    return streams->count;
+}
+
+int stats_stream_sync(stats_stream_t *streams, monitor_state_t *state) {
+    if (state->container_slots > streams->slot_capacity) {
+        int capacity = state->container_capacity;
+        stream_conn_t **by_slot = realloc(streams->by_slot, capacity * sizeof(stream_conn_t *));
+        if (!by_slot) {
+            return -1;
+        }
+        memset(by_slot + streams->slot_capacity, 0, (capacity - streams->slot_capacity) * sizeof(stream_conn_t *));
+        streams->by_slot = by_slot;
+        streams->slot_capacity = capacity;
+    }
+    
+    for (int slot = 0; slot < streams->slot_capacity; slot++) {
+        stream_conn_t *conn = streams->by_slot[slot];
+        int in_use = slot < state->container_slots && state->containers[slot].in_use;
+        
+        if (conn && (!in_use || strcmp(conn->id, state->containers[slot].info.id) != 0)) {
+            close_conn(streams, slot);
+            conn = NULL;
+        }
+        
+        if (conn) {
+            conn->state = state;
+        } else if (in_use) {
+            open_conn(streams, state, slot);
+        }
+    }
+    
+    return streams->count;
+}
+
+int stats_stream_poll(stats_stream_t *streams, int timeout_ms) {
+    struct epoll_event events[STREAM_MAX_EVENTS];
+    struct timespec now, deadline;
+    
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long remaining = (deadline.tv_sec - now.tv_sec) * 1000L + (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+        if (remaining <= 0) {
+            break;
+        }
+        
+        int ready = epoll_wait(streams->epoll_fd, events, STREAM_MAX_EVENTS, (int)remaining);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                return 0;
+            }
+            return -1;
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            stream_conn_t *conn = events[i].data.ptr;
+            
+            if (http_stream_read(&conn->http, handle_stats_line, conn) != 0) {
+                container_monitor_t *container = find_container(conn);
+                if (container) {
+                    container->is_running = 0;
+                }
+                close_conn(streams, conn->slot);
+            }
+        }
+    }
+    
+    return 0;
+}
+
+static container_monitor_t *find_container(stream_conn_t *conn) {
+    monitor_state_t *state = conn->state;
+    
+    if (!state || conn->slot >= state->container_slots) {
+        return NULL;
+    }
+    
+    container_monitor_t *container = &state->containers[conn->slot];
+    if (!container->in_use || strcmp(container->info.id, conn->id) != 0) {
+        return NULL;
+    }
+    
+    return container;
+}
+
+static void handle_stats_line(void *ctx, char *line, size_t len) {
+    stream_conn_t *conn = ctx;
+    container_monitor_t *container = find_container(conn);
+    container_stats_t stats;
+    
+    if (container && docker_parse_container_stats(line, len, &stats) == 0) {
+        update_container_stats(container, &stats);
+    }
+}
+
+static int open_conn(stats_stream_t *streams, monitor_state_t *state, int slot) {
+    struct epoll_event event;
+    stream_conn_t *conn = calloc(1, sizeof(stream_conn_t));
+    
+    if (!conn) {
+        return -1;
+    }
+    
+    snprintf(conn->id, sizeof(conn->id), "%s", state->containers[slot].info.id);
+    conn->state = state;
+    conn->slot = slot;
+    
+    int host = state->containers[slot].info.host;
+    if (!state->hosts[host].client ||
+        docker_open_stats_stream(state->hosts[host].client, &conn->http, conn->id) != 0) {
+        free(conn);
+        return -1;
+    }
+    
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = conn;
+    if (epoll_ctl(streams->epoll_fd, EPOLL_CTL_ADD, conn->http.fd, &event) == -1) {
+        http_stream_close(&conn->http);
+        free(conn);
+        return -1;
+    }
+    
+    streams->by_slot[slot] = conn;
+    streams->count++;
+    return 0;
+}
+
+static void close_conn(stats_stream_t *streams, int slot) {
+    stream_conn_t *conn = streams->by_slot[slot];
+    
+    if (!conn) {
+        return;
+    }
+    
+    epoll_ctl(streams->epoll_fd, EPOLL_CTL_DEL, conn->http.fd, NULL);
+    http_stream_close(&conn->http);
+    free(conn);
+    
+    streams->by_slot[slot] = NULL;
+    streams->count--;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "../include/text_buffer.h"
+
+int text_buffer_init(text_buffer_t *buffer, size_t capacity) {
+    buffer->len = 0;
+    buffer->capacity = 0;
+    buffer->data = NULL;
+    buffer->failed = 0;
+    
+    if (capacity == 0) {
+        return 0;
+    }
+    return text_buffer_reserve(buffer, capacity);
+}
+
+void text_buffer_free(text_buffer_t *buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->len = 0;
+    buffer->capacity = 0;
+    buffer->failed = 0;
+}
+
+void text_buffer_reset(text_buffer_t *buffer) {
+    buffer->len = 0;
+    buffer->failed = 0;
+    if (buffer->data) {
+        buffer->data[0] = '\0';
+    }
+}
+
+int text_buffer_reserve(text_buffer_t *buffer, size_t extra) {
+    size_t needed = buffer->len + extra + 1;
+    
+    if (needed <= buffer->capacity) {
+        return 0;
+    }
+    
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    
+    char *data = realloc(buffer->data, capacity);
+    if (!data) {
+        buffer->failed = 1;
+        return -1;
+    }
+    
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+int text_buffer_append(text_buffer_t *buffer, const char *data, size_t len) {
+    if (text_buffer_reserve(buffer, len) != 0) {
+        return -1;
+    }
+    
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    buffer->data[buffer->len] = '\0';
+    return 0;
+}
+
+int text_buffer_append_str(text_buffer_t *buffer, const char *str) {
+    return text_buffer_append(buffer, str, strlen(str));
+}
+
+int text_buffer_append_u64(text_buffer_t *buffer, uint64_t value) {
+    char digits[20];
+    int count = 0;
+    
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    
+    if (text_buffer_reserve(buffer, count) != 0) {
+        return -1;
+    }
+    
+    while (count > 0) {
+        buffer->data[buffer->len++] = digits[--count];
+    }
+    buffer->data[buffer->len] = '\0';
+    return 0;
+}
+
+int text_buffer_append_i64(text_buffer_t *buffer, int64_t value) {
+    if (value < 0) {
+        if (text_buffer_append(buffer, "-", 1) != 0) {
+            return -1;
+        }
+        return text_buffer_append_u64(buffer, (uint64_t)0 - (uint64_t)value);
+    }
+    return text_buffer_append_u64(buffer, (uint64_t)value);
+}
+
+/* fixed-point formatting without printf; decimals is 0..9 */
+int text_buffer_append_fixed(text_buffer_t *buffer, double value, int decimals) {
+    static const uint64_t scales[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+    };
+    
+    if (value != value) {
+        value = 0.0;
+    }
+    if (value < 0) {
+        if (text_buffer_append(buffer, "-", 1) != 0) {
+            return -1;
+        }
+        value = -value;
+    }
+    if (decimals < 0) decimals = 0;
+    if (decimals > 9) decimals = 9;
+    
+    if (value >= 1e15) {
+        return text_buffer_printf(buffer, "%.*f", decimals, value);
+    }
+    
+    uint64_t scale = scales[decimals];
+    uint64_t scaled = (uint64_t)(value * scale + 0.5);
+    
+    if (text_buffer_append_u64(buffer, scaled / scale) != 0) {
+        return -1;
+    }
+    if (decimals == 0) {
+        return 0;
+    }
+    
+    char fraction[10];
+    uint64_t rest = scaled % scale;
+    
+    fraction[0] = '.';
+    for (int i = decimals; i > 0; i--) {
+        fraction[i] = '0' + rest % 10;
+        rest /= 10;
+    }
+    return text_buffer_append(buffer, fraction, decimals + 1);
+}
+
+int text_buffer_printf(text_buffer_t *buffer, const char *format, ...) {
+    va_list args;
+    int n;
+    
+    va_start(args, format);
+    n = vsnprintf(buffer->data ? buffer->data + buffer->len : NULL,
+                  buffer->data ? buffer->capacity - buffer->len : 0, format, args);
+    va_end(args);
+    if (n < 0) {
+        buffer->failed = 1;
+        return -1;
+    }
+    
+    if (!buffer->data || buffer->len + n >= buffer->capacity) {
+        if (text_buffer_reserve(buffer, n) != 0) {
+            return -1;
+        }
+        va_start(args, format);
+        vsnprintf(buffer->data + buffer->len, buffer->capacity - buffer->len, format, args);
+        va_end(args);
+    }
+    
+    buffer->len += n;
+    return 0;
+}
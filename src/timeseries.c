@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/timeseries.h"
+
+#define MINUTE_SECONDS 60
+#define HOUR_SECONDS 3600
+
+/* the two rollup tiers differ only in capacity, so code works on a view of either */
+typedef struct {
+    int *head;
+    int *count;
+    int capacity;
+    int width;
+    int64_t *start;
+    uint32_t *samples;
+    float *min;
+    float *max;
+    float *sum;
+    float *last;
+} rollup_view_t;
+
+#define ROLLUP_VIEW(tier, tier_capacity, tier_width) {                          \
+    (int *)&(tier).head, (int *)&(tier).count, (tier_capacity), (tier_width),   \
+    (int64_t *)(tier).start, (uint32_t *)(tier).samples,                        \
+    (float *)(tier).min, (float *)(tier).max, (float *)(tier).sum, (float *)(tier).last \
+}
+
+static void rollup_append(rollup_view_t *tier, int64_t time, const float values[TS_METRIC_COUNT]);
+static int rollup_covers(const rollup_view_t *tier, int64_t from);
+static int rollup_query(const rollup_view_t *tier, ts_metric_t metric, int64_t from, ts_summary_t *summary);
+static int raw_covers(const ts_raw_tier_t *raw, int64_t from);
+static int raw_query(const ts_raw_tier_t *raw, ts_metric_t metric, int64_t from, ts_summary_t *summary);
+static float select_percentile(float *values, int count, double percentile);
+
+timeseries_t *timeseries_create(void) {
+    return calloc(1, sizeof(timeseries_t));
+}
+
+void timeseries_destroy(timeseries_t *series) {
+    free(series);
+}
+
+void timeseries_append(timeseries_t *series, time_t time, const float values[TS_METRIC_COUNT]) {
+    ts_raw_tier_t *raw = &series->raw;
+    rollup_view_t minute = ROLLUP_VIEW(series->minute, TS_MINUTE_CAPACITY, MINUTE_SECONDS);
+    rollup_view_t hour = ROLLUP_VIEW(series->hour, TS_HOUR_CAPACITY, HOUR_SECONDS);
+    
+    if (raw->count > 0) {
+        raw->head = (raw->head + 1) % TS_RAW_CAPACITY;
+    }
+    if (raw->count < TS_RAW_CAPACITY) {
+        raw->count++;
+    }
+    
+    raw->time[raw->head] = time;
+    for (int m = 0; m < TS_METRIC_COUNT; m++) {
+        raw->value[m][raw->head] = values[m];
+    }
+    
+    rollup_append(&minute, time, values);
+    rollup_append(&hour, time, values);
+}
+
+int timeseries_query(const timeseries_t *series, ts_metric_t metric, time_t now, int window,
+                     ts_summary_t *summary) {
+    int64_t from = (int64_t)now - window;
+    rollup_view_t minute = ROLLUP_VIEW(series->minute, TS_MINUTE_CAPACITY, MINUTE_SECONDS);
+    rollup_view_t hour = ROLLUP_VIEW(series->hour, TS_HOUR_CAPACITY, HOUR_SECONDS);
+    
+    memset(summary, 0, sizeof(ts_summary_t));
+    if (metric < 0 || metric >= TS_METRIC_COUNT) {
+        return -1;
+    }
+    
+    if (raw_covers(&series->raw, from)) {
+        return raw_query(&series->raw, metric, from, summary);
+    }
+    if (rollup_covers(&minute, from)) {
+        return rollup_query(&minute, metric, from, summary);
+    }
+    return rollup_query(&hour, metric, from, summary);
+}
+
+int timeseries_recent(const timeseries_t *series, ts_metric_t metric, float *values, int max) {
+    const ts_raw_tier_t *raw = &series->raw;
+    int count = raw->count < max ? raw->count : max;
+    
+    for (int i = 0; i < count; i++) {
+        int index = (raw->head - (count - 1 - i) + TS_RAW_CAPACITY) % TS_RAW_CAPACITY;
+        values[i] = raw->value[metric][index];
+    }
+    
+    return count;
+}
+
+static void rollup_append(rollup_view_t *tier, int64_t time, const float values[TS_METRIC_COUNT]) {
+    int64_t bucket = time - time % tier->width;
+    int head = *tier->head;
+    
+    /* a sample older than the open bucket (clock step back) is folded into it */
+    if (*tier->count > 0 && bucket <= tier->start[head]) {
+        tier->samples[head]++;
+        for (int m = 0; m < TS_METRIC_COUNT; m++) {
+            int cell = m * tier->capacity + head;
+            if (values[m] < tier->min[cell]) tier->min[cell] = values[m];
+            if (values[m] > tier->max[cell]) tier->max[cell] = values[m];
+            tier->sum[cell] += values[m];
+            tier->last[cell] = values[m];
+        }
+        return;
+    }
+    
+    if (*tier->count > 0) {
+        head = (head + 1) % tier->capacity;
+    }
+    if (*tier->count < tier->capacity) {
+        (*tier->count)++;
+    }
+    *tier->head = head;
+    
+    tier->start[head] = bucket;
+    tier->samples[head] = 1;
+    for (int m = 0; m < TS_METRIC_COUNT; m++) {
+        int cell = m * tier->capacity + head;
+        tier->min[cell] = tier->max[cell] = tier->sum[cell] = tier->last[cell] = values[m];
+    }
+}
+
+static int rollup_covers(const rollup_view_t *tier, int64_t from) {
+    if (*tier->count < tier->capacity) {
+        return 1;
+    }
+    
+    int oldest = (*tier->head + 1) % tier->capacity;
+    return tier->start[oldest] <= from;
+}
+
+static int rollup_query(const rollup_view_t *tier, ts_metric_t metric, int64_t from, ts_summary_t *summary) {
+    float averages[TS_MINUTE_CAPACITY > TS_HOUR_CAPACITY ? TS_MINUTE_CAPACITY : TS_HOUR_CAPACITY];
+    double sum = 0.0;
+    int buckets = 0;
+    
+    for (int i = 0; i < *tier->count; i++) {
+        int index = (*tier->head - i + tier->capacity) % tier->capacity;
+        int cell = metric * tier->capacity + index;
+        
+        if (tier->start[index] + tier->width <= from) {
+            break;
+        }
+        
+        if (buckets == 0) {
+            summary->last = tier->last[cell];
+            summary->min = tier->min[cell];
+            summary->max = tier->max[cell];
+        } else {
+            if (tier->min[cell] < summary->min) summary->min = tier->min[cell];
+            if (tier->max[cell] > summary->max) summary->max = tier->max[cell];
+        }
+        sum += tier->sum[cell];
+        summary->samples += tier->samples[index];
+        averages[buckets++] = tier->sum[cell] / tier->samples[index];
+    }
+    
+    if (buckets == 0) {
+        return -1;
+    }
+    
+    summary->avg = sum / summary->samples;
+    summary->p95 = select_percentile(averages, buckets, 0.95);
+    summary->resolution = tier->width;
+    return 0;
+}
+
+static int raw_covers(const ts_raw_tier_t *raw, int64_t from) {
+    if (raw->count < TS_RAW_CAPACITY) {
+        return 1;
+    }
+    
+    int oldest = (raw->head + 1) % TS_RAW_CAPACITY;
+    return raw->time[oldest] <= from;
+}
+
+static int raw_query(const ts_raw_tier_t *raw, ts_metric_t metric, int64_t from, ts_summary_t *summary) {
+    float window[TS_RAW_CAPACITY];
+    const float *column = raw->value[metric];
+    double sum = 0.0;
+    int count = 0;
+    
+    for (int i = 0; i < raw->count; i++) {
+        int index = (raw->head - i + TS_RAW_CAPACITY) % TS_RAW_CAPACITY;
+        float value = column[index];
+        
+        if (raw->time[index] < from) {
+            break;
+        }
+        
+        if (count == 0) {
+            summary->last = summary->min = summary->max = value;
+        } else {
+            if (value < summary->min) summary->min = value;
+            if (value > summary->max) summary->max = value;
+        }
+        sum += value;
+        window[count++] = value;
+    }
+    
+    if (count == 0) {
+        return -1;
+    }
+    
+    summary->samples = count;
+    summary->avg = sum / count;
+    summary->p95 = select_percentile(window, count, 0.95);
+    summary->resolution = 0;
+    return 0;
+}
+
+/* nearest-rank percentile by quickselect; reorders values */
+static float select_percentile(float *values, int count, double percentile) {
+    int k = (int)(percentile * count + 0.999999) - 1;
+    int left = 0;
+    int right = count - 1;
+    
+    if (k < 0) k = 0;
+    if (k >= count) k = count - 1;
+    
+    while (left < right) {
+        float pivot = values[(left + right) / 2];
+        int i = left;
+        int j = right;
+        
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                float tmp = values[i];
+                values[i] = values[j];
+                values[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+        
+        if (k <= j) {
+            right = j;
+        } else if (k >= i) {
+            left = i;
+        } else {
+            break;
+        }
+    }
+    
+    return values[k];
+}
@@ -0,0 +1,335 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#include "../include/tls_client.h"
+#include "../include/docker_api.h"
+
+struct tls_client {
+    SSL_CTX *ctx;
+    char host[256];
+    int host_is_ip;
+    pthread_mutex_t lock;
+    SSL_SESSION *session;
+    char last_error[768];
+};
+
+/* the stock socket BIO writes with write(), so a daemon that resets the
+   connection would kill the process with SIGPIPE; this one sends with
+   MSG_NOSIGNAL like the plaintext path */
+static BIO_METHOD *socket_method;
+static pthread_once_t socket_method_once = PTHREAD_ONCE_INIT;
+
+static void init_socket_method(void);
+static int socket_write(BIO *bio, const char *data, int len);
+static int store_session(SSL *ssl, SSL_SESSION *session);
+static void report(tls_client_t *tls, const char *what, const char *detail);
+static const char *openssl_error(char *buffer, size_t size);
+
+tls_client_t *tls_client_create(const char *host, const char *ca_path, const char *cert_path,
+                                const char *key_path) {
+    char detail[256];
+    struct in6_addr addr;
+    
+    pthread_once(&socket_method_once, init_socket_method);
+    if (!socket_method) {
+        return NULL;
+    }
+    
+    tls_client_t *tls = calloc(1, sizeof(tls_client_t));
+    if (!tls) {
+        return NULL;
+    }
+    
+    snprintf(tls->host, sizeof(tls->host), "%s", host);
+    tls->host_is_ip = inet_pton(AF_INET, host, &addr) == 1 || inet_pton(AF_INET6, host, &addr) == 1;
+    pthread_mutex_init(&tls->lock, NULL);
+    
+    tls->ctx = SSL_CTX_new(TLS_client_method());
+    if (!tls->ctx) {
+        report(tls, "ошибка создания контекста", openssl_error(detail, sizeof(detail)));
+        tls_client_destroy(tls);
+        return NULL;
+    }
+    
+    SSL_CTX_set_min_proto_version(tls->ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(tls->ctx, SSL_VERIFY_PEER, NULL);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    /* a response framed by connection close ends without close_notify */
+    SSL_CTX_set_options(tls->ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    
+    if (ca_path && ca_path[0]) {
+        if (SSL_CTX_load_verify_locations(tls->ctx, ca_path, NULL) != 1) {
+            report(tls, "не удалось загрузить CA сертификат", ca_path);
+            tls_client_destroy(tls);
+            return NULL;
+        }
+    } else if (SSL_CTX_set_default_verify_paths(tls->ctx) != 1) {
+        report(tls, "не удалось загрузить системные CA сертификаты", openssl_error(detail, sizeof(detail)));
+        tls_client_destroy(tls);
+        return NULL;
+    }
+    
+    if (cert_path && cert_path[0]) {
+        if (SSL_CTX_use_certificate_chain_file(tls->ctx, cert_path) != 1) {
+            report(tls, "не удалось загрузить сертификат клиента", cert_path);
+            tls_client_destroy(tls);
+            return NULL;
+        }
+        if (SSL_CTX_use_PrivateKey_file(tls->ctx, key_path, SSL_FILETYPE_PEM) != 1 ||
+            SSL_CTX_check_private_key(tls->ctx) != 1) {
+            report(tls, "не удалось загрузить ключ клиента", key_path);
+            tls_client_destroy(tls);
+            return NULL;
+        }
+    }
+    
+    /* sessions are handed to store_session instead of OpenSSL's own cache */
+    SSL_CTX_set_app_data(tls->ctx, tls);
+    SSL_CTX_set_session_cache_mode(tls->ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(tls->ctx, store_session);
+    ERR_clear_error();
+    
+    return tls;
+}
+
+void tls_client_destroy(tls_client_t *tls) {
+    if (!tls) {
+        return;
+    }
+    SSL_SESSION_free(tls->session);
+    SSL_CTX_free(tls->ctx);
+    pthread_mutex_destroy(&tls->lock);
+    free(tls);
+}
+
+struct ssl_st *tls_client_connect(tls_client_t *tls, int fd, int *resumed) {
+    char detail[256];
+    SSL *ssl = SSL_new(tls->ctx);
+    BIO *bio = BIO_new(socket_method);
+    
+    if (!ssl || !bio) {
+        SSL_free(ssl);
+        BIO_free(bio);
+        return NULL;
+    }
+    
+    BIO_set_fd(bio, fd, BIO_NOCLOSE);
+    SSL_set_bio(ssl, bio, bio);
+    
+    if (tls->host_is_ip) {
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), tls->host);
+    } else {
+        SSL_set_tlsext_host_name(ssl, tls->host);
+        SSL_set1_host(ssl, tls->host);
+    }
+    
+    pthread_mutex_lock(&tls->lock);
+    if (tls->session) {
+        SSL_set_session(ssl, tls->session);
+    }
+    pthread_mutex_unlock(&tls->lock);
+    
+    ERR_clear_error();
+    if (SSL_connect(ssl) != 1) {
+        long verify = SSL_get_verify_result(ssl);
+        
+        if (verify != X509_V_OK) {
+            snprintf(detail, sizeof(detail), "%s", X509_verify_cert_error_string(verify));
+        } else {
+            openssl_error(detail, sizeof(detail));
+        }
+        report(tls, "ошибка рукопожатия", detail);
+        ERR_clear_error();
+        SSL_free(ssl);
+        return NULL;
+    }
+    
+    *resumed = SSL_session_reused(ssl);
+    
+    /* a failure that comes back after a recovery is worth reporting again */
+    pthread_mutex_lock(&tls->lock);
+    tls->last_error[0] = '\0';
+    pthread_mutex_unlock(&tls->lock);
+    return ssl;
+}
+
+void tls_close(struct ssl_st *ssl) {
+    if (!ssl) {
+        return;
+    }
+    /* sends close_notify without waiting for the daemon's */
+    ERR_clear_error();
+    SSL_shutdown(ssl);
+    ERR_clear_error();
+    SSL_free(ssl);
+}
+
+ssize_t tls_recv(struct ssl_st *ssl, void *buffer, size_t len) {
+    ERR_clear_error();
+    errno = 0;
+    int n = SSL_read(ssl, buffer, len > INT_MAX ? INT_MAX : (int)len);
+    
+    if (n > 0) {
+        return n;
+    }
+    switch (SSL_get_error(ssl, n)) {
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        errno = EAGAIN;
+        return -1;
+    case SSL_ERROR_SYSCALL:
+        if (errno == 0) {
+            return 0;
+        }
+        return -1;
+    default: {
+        /* with TLS 1.3 a rejected client certificate only shows up here,
+           as an alert in place of the first response */
+        char detail[256];
+        
+        report(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)), "ошибка приема", openssl_error(detail, sizeof(detail)));
+        errno = EIO;
+        return -1;
+    }
+    }
+}
+
+ssize_t tls_send(struct ssl_st *ssl, const void *data, size_t len) {
+    ERR_clear_error();
+    errno = 0;
+    int n = SSL_write(ssl, data, len > INT_MAX ? INT_MAX : (int)len);
+    
+    if (n > 0) {
+        return n;
+    }
+    switch (SSL_get_error(ssl, n)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        errno = EAGAIN;
+        return -1;
+    case SSL_ERROR_SYSCALL:
+        if (errno == 0) {
+            errno = EPIPE;
+        }
+        return -1;
+    default:
+        errno = EIO;
+        return -1;
+    }
+}
+
+int tls_idle_ok(struct ssl_st *ssl, int fd) {
+    char probe;
+    
+    if (SSL_pending(ssl) > 0) {
+        return 0;
+    }
+    
+    ssize_t n = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0) {
+        return 0;
+    }
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    
+    /* TLS 1.3 session tickets arrive after the handshake and may sit unread
+       until the first request; let OpenSSL consume whatever records are
+       there without blocking. Application data or an alert end the
+       connection */
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        return 0;
+    }
+    
+    ERR_clear_error();
+    int result = SSL_read(ssl, &probe, 1);
+    int error = SSL_get_error(ssl, result);
+    
+    ERR_clear_error();
+    fcntl(fd, F_SETFL, flags);
+    return result <= 0 && error == SSL_ERROR_WANT_READ;
+}
+
+static void init_socket_method(void) {
+    const BIO_METHOD *stock = BIO_s_socket();
+    BIO_METHOD *method = BIO_meth_new(BIO_TYPE_SOCKET, "socket without SIGPIPE");
+    
+    if (!method) {
+        return;
+    }
+    BIO_meth_set_write(method, socket_write);
+    BIO_meth_set_read(method, BIO_meth_get_read(stock));
+    BIO_meth_set_puts(method, BIO_meth_get_puts(stock));
+    BIO_meth_set_ctrl(method, BIO_meth_get_ctrl(stock));
+    BIO_meth_set_create(method, BIO_meth_get_create(stock));
+    BIO_meth_set_destroy(method, BIO_meth_get_destroy(stock));
+    socket_method = method;
+}
+
+static int socket_write(BIO *bio, const char *data, int len) {
+    int n;
+    
+    do {
+        n = send(BIO_get_fd(bio, NULL), data, len, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    
+    BIO_clear_retry_flags(bio);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        BIO_set_retry_write(bio);
+    }
+    return n;
+}
+
+/* called for every session ticket the daemon issues; taking the reference
+   (returning 1) keeps the newest one for the next connection */
+static int store_session(SSL *ssl, SSL_SESSION *session) {
+    tls_client_t *tls = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+    
+    pthread_mutex_lock(&tls->lock);
+    SSL_SESSION_free(tls->session);
+    tls->session = session;
+    pthread_mutex_unlock(&tls->lock);
+    return 1;
+}
+
+/* workers hit the same failure on every connection attempt; say it once */
+static void report(tls_client_t *tls, const char *what, const char *detail) {
+    char message[768];
+    int repeated;
+    
+    snprintf(message, sizeof(message), "TLS %s: %s: %s", tls->host, what, detail);
+    
+    pthread_mutex_lock(&tls->lock);
+    repeated = strcmp(tls->last_error, message) == 0;
+    snprintf(tls->last_error, sizeof(tls->last_error), "%s", message);
+    pthread_mutex_unlock(&tls->lock);
+    
+    if (!repeated) {
+        print_error(message);
+    }
+}
+
+static const char *openssl_error(char *buffer, size_t size) {
+    unsigned long code = ERR_get_error();
+    
+    if (code) {
+        ERR_error_string_n(code, buffer, size);
+    } else {
+        snprintf(buffer, size, "соединение закрыто");
+    }
+    return buffer;
+}
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/top_k.h"
+
+/* values[] and slots[] form one min-heap: the root is the smallest kept value */
+struct top_k {
+    top_metric_t metric;
+    int k;
+    int count;
+    double *values;
+    int *slots;
+};
+
+static const char *metric_names[TOP_METRIC_COUNT] = {"cpu", "memory", "network", "io"};
+
+static int heap_less(const top_k_t *top, int a, int b);
+static void heap_swap(top_k_t *top, int a, int b);
+static void sift_up(top_k_t *top, int index);
+static void sift_down(top_k_t *top, int index, int count);
+
+top_k_t *top_k_create(top_metric_t metric, int k) {
+    if (k <= 0 || k > MAX_TOP_K) {
+        return NULL;
+    }
+    
+    top_k_t *top = calloc(1, sizeof(top_k_t));
+    if (!top) {
+        return NULL;
+    }
+    
+    top->metric = metric;
+    top->k = k;
+    top->values = malloc(k * sizeof(double));
+    top->slots = malloc(k * sizeof(int));
+    if (!top->values || !top->slots) {
+        top_k_destroy(top);
+        return NULL;
+    }
+    
+    return top;
+}
+
+void top_k_destroy(top_k_t *top) {
+    if (!top) {
+        return;
+    }
+    free(top->values);
+    free(top->slots);
+    free(top);
+}
+
+int top_k_parse_metric(const char *name) {
+    for (top_metric_t metric = 0; metric < TOP_METRIC_COUNT; metric++) {
+        if (strcmp(name, metric_names[metric]) == 0) {
+            return metric;
+        }
+    }
+    return -1;
+}
+
+const char *top_k_metric_name(top_metric_t metric) {
+    return metric < TOP_METRIC_COUNT ? metric_names[metric] : "";
+}
+
+top_metric_t top_k_metric(const top_k_t *top) {
+    return top->metric;
+}
+
+double top_k_value(top_metric_t metric, const container_monitor_t *container) {
+    switch (metric) {
+    case TOP_CPU: return container->cpu_percent;
+    case TOP_MEMORY: return (double)container->memory_working_set;
+    case TOP_NETWORK: return container->network_rx_rate + container->network_tx_rate;
+    case TOP_IO: return container->block_read_rate + container->block_write_rate;
+    default: return 0.0;
+    }
+}
+
+void top_k_reset(top_k_t *top) {
+    top->count = 0;
+}
+
+void top_k_add(top_k_t *top, const container_monitor_t *container, int slot) {
+    double value = top_k_value(top->metric, container);
+    
+    if (top->count < top->k) {
+        top->values[top->count] = value;
+        top->slots[top->count] = slot;
+        sift_up(top, top->count++);
+        return;
+    }
+    
+    /* ties keep the lower slot, so the order does not flicker between ticks */
+    if (value < top->values[0] || (value == top->values[0] && slot > top->slots[0])) {
+        return;
+    }
+    top->values[0] = value;
+    top->slots[0] = slot;
+    sift_down(top, 0, top->count);
+}
+
+/* heapsort: popping the minimum to the end of the shrinking heap leaves
+   the array largest first */
+int top_k_sorted(top_k_t *top, const int **slots) {
+    for (int end = top->count - 1; end > 0; end--) {
+        heap_swap(top, 0, end);
+        sift_down(top, 0, end);
+    }
+    
+    *slots = top->slots;
+    return top->count;
+}
+
+static int heap_less(const top_k_t *top, int a, int b) {
+    if (top->values[a] != top->values[b]) {
+        return top->values[a] < top->values[b];
+    }
+    return top->slots[a] > top->slots[b];
+}
+
+static void heap_swap(top_k_t *top, int a, int b) {
+    double value = top->values[a];
+    int slot = top->slots[a];
+    
+    top->values[a] = top->values[b];
+    top->slots[a] = top->slots[b];
+    top->values[b] = value;
+    top->slots[b] = slot;
+}
+
+static void sift_up(top_k_t *top, int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!heap_less(top, index, parent)) break;
+        heap_swap(top, index, parent);
+        index = parent;
+    }
+}
+
+static void sift_down(top_k_t *top, int index, int count) {
+    for (;;) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        
+        if (left < count && heap_less(top, left, smallest)) smallest = left;
+        if (right < count && heap_less(top, right, smallest)) smallest = right;
+        if (smallest == index) break;
+        
+        heap_swap(top, index, smallest);
+        index = smallest;
+    }
+}
@@ -0,0 +1,838 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "../include/tui.h"
+#include "../include/docker_api.h"
+#include "../include/text_buffer.h"
+#include "../include/timeseries.h"
+
+#define ATTR_BOLD 1
+#define ATTR_REVERSE 2
+#define MIN_ROWS 6
+#define MIN_COLS 40
+#define NAME_MIN_WIDTH 12
+#define HOST_WIDTH 12
+#define VALUE_WIDTH 7
+#define SPARK_WIDTH 20
+/* a cursor move costs 6-8 bytes, shorter runs of unchanged cells are rewritten */
+#define MAX_REWRITE_GAP 4
+#define MESSAGE_SIZE 256
+#define MESSAGE_SECONDS 10
+
+#define ENTER_SCREEN "\x1b[?1049h\x1b[?25l"
+#define LEAVE_SCREEN "\x1b[0m\x1b[?25h\x1b[?1049l"
+
+enum {
+    KEY_UP = 256,
+    KEY_DOWN,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+    KEY_HOME,
+    KEY_END
+};
+
+/* one UTF-8 character; unused bytes of ch stay zero so cells compare with memcmp */
+typedef struct {
+    char ch[4];
+    uint8_t len;
+    uint8_t attr;
+} tui_cell_t;
+
+typedef struct {
+    double key;
+    int name_order;
+    const container_monitor_t *container;
+} tui_row_t;
+
+struct tui {
+    int rows;
+    int cols;
+    tui_cell_t *frame;
+    tui_cell_t *shown;
+    int shown_valid;
+    text_buffer_t out;
+    tui_row_t *order;
+    int order_capacity;
+    tui_sort_t sort;
+    int reversed;
+    int selected;
+    int top;
+    int page;
+    int moved;
+    char selected_id[MAX_CONTAINER_ID];
+    int selected_host;
+    int stderr_fd;
+    int message_fd;
+    char pending[MESSAGE_SIZE];
+    size_t pending_len;
+    char message[MESSAGE_SIZE];
+    uint64_t message_ns;
+    uint64_t frames;
+    uint64_t bytes;
+};
+
+static const struct {
+    const char *title;
+    tui_sort_t sort;
+} value_columns[] = {
+    {"CPU%", TUI_SORT_CPU},
+    {"ПАМ", TUI_SORT_MEMORY},
+    {"ПАМ%", TUI_SORT_MEMORY},
+    {"RX/с", TUI_SORT_NETWORK},
+    {"TX/с", TUI_SORT_NETWORK},
+    {"ЧТЕН/с", TUI_SORT_IO},
+    {"ЗАП/с", TUI_SORT_IO},
+};
+
+static const char *sort_names[TUI_SORT_COUNT] = {"CPU", "память", "сеть", "диск", "имя"};
+static const char *sparks[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+
+static volatile sig_atomic_t resized = 0;
+static struct termios saved_termios;
+static int terminal_raw = 0;
+
+static void resize_handler(int sig);
+static void restore_terminal(void);
+static void capture_stderr(tui_t *tui);
+static void read_messages(tui_t *tui);
+static int resize(tui_t *tui);
+static int decode_key(const unsigned char *keys, int len, int *key);
+static tui_action_t apply_key(tui_t *tui, int key);
+static int utf8_length(const unsigned char *p);
+static int text_cells(const char *text);
+static void fill_row(tui_t *tui, int row, uint8_t attr);
+static int put_text(tui_t *tui, int row, int col, int width, const char *text, uint8_t attr, int right);
+static void format_compact(char *buffer, size_t size, double value);
+static int sort_rows(tui_t *tui, const monitor_state_t *state);
+static int compare_rows(const void *a, const void *b);
+static void draw_header(tui_t *tui, const monitor_state_t *state);
+static void draw_table(tui_t *tui, const monitor_state_t *state);
+static void draw_row(tui_t *tui, const monitor_state_t *state, int row, const container_monitor_t *container,
+                     int value_count, int name_width, int spark_width, uint8_t attr);
+static void draw_footer(tui_t *tui, const monitor_state_t *state, int count);
+static int flush_frame(tui_t *tui);
+static void emit_cell(text_buffer_t *out, const tui_cell_t *cell, uint8_t *attr);
+static int write_all(int fd, const char *data, size_t len);
+
+tui_t *tui_open(void) {
+    static int registered = 0;
+    struct termios raw;
+    struct sigaction action;
+    
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &saved_termios) != 0) {
+        return NULL;
+    }
+    
+    tui_t *tui = calloc(1, sizeof(tui_t));
+    if (!tui || text_buffer_init(&tui->out, 16384) != 0) {
+        free(tui);
+        return NULL;
+    }
+    tui->stderr_fd = -1;
+    tui->message_fd = -1;
+    tui->selected_host = -1;
+    
+    /* messages written over the screen would stay there, the diff never repaints them */
+    if (isatty(STDERR_FILENO)) {
+        capture_stderr(tui);
+    }
+    
+    /* Ctrl+C arrives as a key, a read returns at once with whatever is there */
+    raw = saved_termios;
+    raw.c_iflag &= ~(IXON | ICRNL | BRKINT | INPCK | ISTRIP);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+    terminal_raw = 1;
+    if (!registered) {
+        atexit(restore_terminal);
+        registered = 1;
+    }
+    
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = resize_handler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, NULL);
+    
+    write_all(STDOUT_FILENO, ENTER_SCREEN, strlen(ENTER_SCREEN));
+    resized = 1;
+    return tui;
+}
+
+void tui_close(tui_t *tui) {
+    if (!tui) {
+        return;
+    }
+    
+    restore_terminal();
+    signal(SIGWINCH, SIG_DFL);
+    
+    if (tui->message_fd >= 0) {
+        read_messages(tui);
+        dup2(tui->stderr_fd, STDERR_FILENO);
+        close(tui->stderr_fd);
+        close(tui->message_fd);
+        /* the last message is kept, it is often why the monitor stopped */
+        if (tui->message[0]) {
+            fprintf(stderr, "%s\n", tui->message);
+        }
+    }
+    
+    text_buffer_free(&tui->out);
+    free(tui->frame);
+    free(tui->shown);
+    free(tui->order);
+    free(tui);
+}
+
+int tui_input_fd(const tui_t *tui) {
+    (void)tui;
+    return STDIN_FILENO;
+}
+
+tui_action_t tui_handle_input(tui_t *tui) {
+    unsigned char keys[64];
+    tui_action_t action = resized ? TUI_REDRAW : TUI_NONE;
+    ssize_t n = read(STDIN_FILENO, keys, sizeof(keys));
+    
+    for (int i = 0; i < n; ) {
+        int key;
+        i += decode_key(keys + i, (int)n - i, &key);
+        
+        tui_action_t result = apply_key(tui, key);
+        if (result == TUI_QUIT) {
+            return TUI_QUIT;
+        }
+        if (result == TUI_REDRAW) {
+            action = TUI_REDRAW;
+        }
+    }
+    
+    return action;
+}
+
+int tui_render(tui_t *tui, const monitor_state_t *state) {
+    if (resized) {
+        resized = 0;
+        if (resize(tui) != 0) {
+            return -1;
+        }
+    }
+    read_messages(tui);
+    
+    for (int row = 0; row < tui->rows; row++) {
+        fill_row(tui, row, 0);
+    }
+    
+    if (tui->rows < MIN_ROWS || tui->cols < MIN_COLS) {
+        put_text(tui, 0, 0, tui->cols, "Окно слишком мало", 0, 0);
+    } else {
+        draw_header(tui, state);
+        draw_table(tui, state);
+    }
+    
+    return flush_frame(tui);
+}
+
+void tui_get_stats(const tui_t *tui, uint64_t *frames, uint64_t *bytes) {
+    *frames = tui->frames;
+    *bytes = tui->bytes;
+}
+
+static void resize_handler(int sig) {
+    (void)sig;
+    resized = 1;
+}
+
+static void restore_terminal(void) {
+    if (!terminal_raw) {
+        return;
+    }
+    write_all(STDOUT_FILENO, LEAVE_SCREEN, strlen(LEAVE_SCREEN));
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_termios);
+    terminal_raw = 0;
+}
+
+/* stderr goes to a non-blocking pipe: a writer never stalls on a full one,
+   its message is dropped instead */
+static void capture_stderr(tui_t *tui) {
+    int fds[2];
+    
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+        return;
+    }
+    
+    fflush(stderr);
+    tui->stderr_fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (tui->stderr_fd < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
+        if (tui->stderr_fd >= 0) close(tui->stderr_fd);
+        tui->stderr_fd = -1;
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    
+    close(fds[1]);
+    tui->message_fd = fds[0];
+}
+
+static void read_messages(tui_t *tui) {
+    char chunk[1024];
+    ssize_t n;
+    
+    if (tui->message_fd < 0) {
+        return;
+    }
+    
+    while ((n = read(tui->message_fd, chunk, sizeof(chunk))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (chunk[i] != '\n') {
+                if (tui->pending_len < MESSAGE_SIZE - 1) {
+                    tui->pending[tui->pending_len++] = chunk[i];
+                }
+            } else if (tui->pending_len > 0) {
+                memcpy(tui->message, tui->pending, tui->pending_len);
+                tui->message[tui->pending_len] = '\0';
+                tui->message_ns = monotonic_ns();
+                tui->pending_len = 0;
+            }
+        }
+    }
+}
+
+static int resize(tui_t *tui) {
+    struct winsize size;
+    int rows = 24;
+    int cols = 80;
+    
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row;
+        cols = size.ws_col;
+    }
+    
+    tui_cell_t *frame = realloc(tui->frame, (size_t)rows * cols * sizeof(tui_cell_t));
+    if (!frame) {
+        return -1;
+    }
+    tui->frame = frame;
+    
+    tui_cell_t *shown = realloc(tui->shown, (size_t)rows * cols * sizeof(tui_cell_t));
+    if (!shown) {
+        return -1;
+    }
+    tui->shown = shown;
+    
+    tui->rows = rows;
+    tui->cols = cols;
+    tui->shown_valid = 0;
+    return 0;
+}
+
+/* returns the number of bytes taken; arrows, Home/End and PgUp/PgDn come
+   as CSI or SS3 sequences, other sequences are skipped whole */
+static int decode_key(const unsigned char *keys, int len, int *key) {
+    *key = keys[0];
+    if (keys[0] != 0x1b || len < 3 || (keys[1] != '[' && keys[1] != 'O')) {
+        return 1;
+    }
+    
+    switch (keys[2]) {
+    case 'A': *key = KEY_UP; return 3;
+    case 'B': *key = KEY_DOWN; return 3;
+    case 'H': *key = KEY_HOME; return 3;
+    case 'F': *key = KEY_END; return 3;
+    }
+    
+    if (len >= 4 && keys[3] == '~') {
+        switch (keys[2]) {
+        case '1': case '7': *key = KEY_HOME; return 4;
+        case '4': case '8': *key = KEY_END; return 4;
+        case '5': *key = KEY_PAGE_UP; return 4;
+        case '6': *key = KEY_PAGE_DOWN; return 4;
+        }
+    }
+    
+    int i = 2;
+    while (i < len && !(keys[i] >= 0x40 && keys[i] <= 0x7e)) i++;
+    *key = 0;
+    return i < len ? i + 1 : len;
+}
+
+static tui_action_t apply_key(tui_t *tui, int key) {
+    tui_sort_t sort;
+    
+    switch (key) {
+    case 'q': case 'Q': case 3:
+        return TUI_QUIT;
+    case KEY_UP: case 'k':
+        tui->selected--;
+        break;
+    case KEY_DOWN: case 'j':
+        tui->selected++;
+        break;
+    case KEY_PAGE_UP:
+        tui->selected -= tui->page;
+        break;
+    case KEY_PAGE_DOWN:
+        tui->selected += tui->page;
+        break;
+    case KEY_HOME: case 'g':
+        tui->selected = 0;
+        break;
+    case KEY_END: case 'G':
+        tui->selected = 1 << 30;
+        break;
+    case 'r':
+        tui->reversed = !tui->reversed;
+        return TUI_REDRAW;
+    case 'l': case 12:
+        tui->shown_valid = 0;
+        return TUI_REDRAW;
+    case '<': case '>':
+        tui->sort = (tui->sort + (key == '>' ? 1 : TUI_SORT_COUNT - 1)) % TUI_SORT_COUNT;
+        tui->reversed = 0;
+        return TUI_REDRAW;
+    case 'c': case 'm': case 'n': case 'd': case 'a':
+        sort = key == 'c' ? TUI_SORT_CPU : key == 'm' ? TUI_SORT_MEMORY :
+               key == 'n' ? TUI_SORT_NETWORK : key == 'd' ? TUI_SORT_IO : TUI_SORT_NAME;
+        /* the key of the current column flips the order */
+        tui->reversed = sort == tui->sort ? !tui->reversed : 0;
+        tui->sort = sort;
+        return TUI_REDRAW;
+    default:
+        return TUI_NONE;
+    }
+    
+    tui->moved = 1;
+    return TUI_REDRAW;
+}
+
+/* bytes in the character at p, 0 for a control byte or broken UTF-8 */
+static int utf8_length(const unsigned char *p) {
+    int len;
+    
+    if (p[0] < 0x20 || p[0] == 0x7f) return 0;
+    if (p[0] < 0x80) return 1;
+    if (p[0] >= 0xc2 && p[0] <= 0xdf) len = 2;
+    else if (p[0] >= 0xe0 && p[0] <= 0xef) len = 3;
+    else if (p[0] >= 0xf0 && p[0] <= 0xf4) len = 4;
+    else return 0;
+    
+    for (int i = 1; i < len; i++) {
+        if ((p[i] & 0xc0) != 0x80) return 0;
+    }
+    return len;
+}
+
+static int text_cells(const char *text) {
+    const unsigned char *p = (const unsigned char *)text;
+    int cells = 0;
+    
+    while (*p) {
+        int len = utf8_length(p);
+        p += len > 0 ? len : 1;
+        cells++;
+    }
+    return cells;
+}
+
+static void fill_row(tui_t *tui, int row, uint8_t attr) {
+    tui_cell_t blank = {{' '}, 1, attr};
+    tui_cell_t *cells = &tui->frame[row * tui->cols];
+    
+    for (int col = 0; col < tui->cols; col++) {
+        cells[col] = blank;
+    }
+}
+
+/* writes at most width cells of text from col, right aligned when asked;
+   unprintable bytes show as '?'. Returns the column after the text */
+static int put_text(tui_t *tui, int row, int col, int width, const char *text, uint8_t attr, int right) {
+    const unsigned char *p = (const unsigned char *)text;
+    
+    if (row < 0 || row >= tui->rows || col >= tui->cols) {
+        return col;
+    }
+    if (col + width > tui->cols) {
+        width = tui->cols - col;
+    }
+    if (right) {
+        int cells = text_cells(text);
+        if (cells < width) {
+            col += width - cells;
+            width = cells;
+        }
+    }
+    
+    tui_cell_t *cell = &tui->frame[row * tui->cols + col];
+    int written = 0;
+    while (*p && written < width) {
+        tui_cell_t next = {{0}, 1, attr};
+        int len = utf8_length(p);
+        
+        if (len == 0) {
+            next.ch[0] = '?';
+            p++;
+        } else {
+            memcpy(next.ch, p, len);
+            next.len = (uint8_t)len;
+            p += len;
+        }
+        *cell++ = next;
+        written++;
+    }
+    
+    return col + written;
+}
+
+/* at most five cells: 999B, 9.8K, 512M */
+static void format_compact(char *buffer, size_t size, double value) {
+    const char units[] = "BKMGT";
+    int unit = 0;
+    
+    while (value >= 1000.0 && unit < 4) {
+        value /= 1024.0;
+        unit++;
+    }
+    
+    if (unit > 0 && value < 10.0) {
+        snprintf(buffer, size, "%.1f%c", value, units[unit]);
+    } else {
+        snprintf(buffer, size, "%.0f%c", value, units[unit]);
+    }
+}
+
+/* running containers come first in descending orders, stopped ones have no rates */
+static int sort_rows(tui_t *tui, const monitor_state_t *state) {
+    int descending = (tui->sort != TUI_SORT_NAME) != tui->reversed;
+    int count = 0;
+    
+    if (state->container_count > tui->order_capacity) {
+        int capacity = state->container_count * 2;
+        tui_row_t *order = realloc(tui->order, capacity * sizeof(tui_row_t));
+        if (!order) {
+            return 0;
+        }
+        tui->order = order;
+        tui->order_capacity = capacity;
+    }
+    
+    for (int i = 0; i < state->container_slots && count < tui->order_capacity; i++) {
+        const container_monitor_t *container = &state->containers[i];
+        tui_row_t *row = &tui->order[count];
+        double value = 0.0;
+        
+        if (!container->in_use) continue;
+        
+        switch (tui->sort) {
+        case TUI_SORT_CPU: value = container->cpu_percent; break;
+        case TUI_SORT_MEMORY: value = container->memory_working_set; break;
+        case TUI_SORT_NETWORK: value = container->network_rx_rate + container->network_tx_rate; break;
+        case TUI_SORT_IO: value = container->block_read_rate + container->block_write_rate; break;
+        default: break;
+        }
+        if (!container->is_running && tui->sort != TUI_SORT_NAME) {
+            value = -1.0;
+        }
+        
+        row->key = descending ? -value : value;
+        row->name_order = tui->sort == TUI_SORT_NAME && tui->reversed ? -1 : 1;
+        row->container = container;
+        count++;
+    }
+    
+    qsort(tui->order, count, sizeof(tui_row_t), compare_rows);
+    return count;
+}
+
+static int compare_rows(const void *a, const void *b) {
+    const tui_row_t *left = a;
+    const tui_row_t *right = b;
+    
+    if (left->key != right->key) {
+        return left->key < right->key ? -1 : 1;
+    }
+    
+    int result = strcmp(left->container->info.name, right->container->info.name);
+    if (result != 0) {
+        return result * left->name_order;
+    }
+    return left->container->info.host - right->container->info.host;
+}
+
+static void draw_header(tui_t *tui, const monitor_state_t *state) {
+    monitor_summary_t summary;
+    char time_str[64];
+    char line[1024];
+    time_t now = state->last_update;
+    struct tm tm_info;
+    int len;
+    
+    localtime_r(&now, &tm_info);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
+    monitor_summarize(state, -1, &summary, NULL);
+    snprintf(line, sizeof(line), "docker_monitor  %s  запущено %d/%d  CPU %s  память %s / %s",
+             time_str,
+             summary.running,
+             summary.containers,
+             format_percentage(summary.cpu_percent),
+             format_bytes(summary.memory),
+             format_bytes(summary.memory_limit));
+    put_text(tui, 0, 0, tui->cols, line, ATTR_BOLD, 0);
+    
+    len = snprintf(line, sizeof(line), "%s:", state->host_count > 1 ? "хосты" : "хост");
+    for (int i = 0; i < state->host_count && len < (int)sizeof(line); i++) {
+        const monitor_host_t *host = &state->hosts[i];
+        len += snprintf(line + len, sizeof(line) - len, "%s %s%s", i > 0 ? "," : "", host->name,
+                        host->client && !host->reachable ? " (недоступен)" : "");
+    }
+    if (len < (int)sizeof(line)) {
+        snprintf(line + len, sizeof(line) - len, "  интервал: %d с  сортировка: %s%s",
+                 state->interval, sort_names[tui->sort], tui->reversed ? " (обратная)" : "");
+    }
+    put_text(tui, 1, 0, tui->cols, line, 0, 0);
+}
+
+static void draw_table(tui_t *tui, const monitor_state_t *state) {
+    int value_count = sizeof(value_columns) / sizeof(value_columns[0]);
+    int host_width = state->host_count > 1 ? HOST_WIDTH + 1 : 0;
+    int visible = tui->rows - 5;
+    int name_width;
+    int spark_width = 0;
+    int descending = (tui->sort != TUI_SORT_NAME) != tui->reversed;
+    
+    /* narrow windows lose the disk and then the network columns */
+    name_width = tui->cols - host_width - value_count * (VALUE_WIDTH + 1);
+    while (name_width < NAME_MIN_WIDTH && value_count > 3) {
+        value_count -= 2;
+        name_width += 2 * (VALUE_WIDTH + 1);
+    }
+    if (name_width >= NAME_MIN_WIDTH + SPARK_WIDTH + 1) {
+        spark_width = SPARK_WIDTH;
+        name_width -= SPARK_WIDTH + 1;
+    }
+    
+    fill_row(tui, 2, ATTR_REVERSE);
+    put_text(tui, 2, 0, name_width,
+             tui->sort == TUI_SORT_NAME ? (descending ? "▼КОНТЕЙНЕР" : "▲КОНТЕЙНЕР") : "КОНТЕЙНЕР",
+             ATTR_REVERSE, 0);
+    int col = name_width + 1;
+    if (host_width) {
+        put_text(tui, 2, col, HOST_WIDTH, "ХОСТ", ATTR_REVERSE, 0);
+        col += host_width;
+    }
+    for (int i = 0; i < value_count; i++) {
+        char title[32];
+        snprintf(title, sizeof(title), "%s%s",
+                 value_columns[i].sort == tui->sort ? (descending ? "▼" : "▲") : "", value_columns[i].title);
+        put_text(tui, 2, col, VALUE_WIDTH, title, ATTR_REVERSE, 1);
+        col += VALUE_WIDTH + 1;
+    }
+    if (spark_width) {
+        put_text(tui, 2, col, spark_width, "CPU, история", ATTR_REVERSE, 0);
+    }
+    
+    int count = sort_rows(tui, state);
+    
+    /* the selection follows its container across resorts unless a key moved it */
+    if (!tui->moved && tui->selected_id[0]) {
+        for (int i = 0; i < count; i++) {
+            const container_info_t *info = &tui->order[i].container->info;
+            if (info->host == tui->selected_host && strcmp(info->id, tui->selected_id) == 0) {
+                tui->selected = i;
+                break;
+            }
+        }
+    }
+    tui->moved = 0;
+    if (tui->selected >= count) tui->selected = count - 1;
+    if (tui->selected < 0) tui->selected = 0;
+    
+    tui->page = visible;
+    if (tui->selected < tui->top) tui->top = tui->selected;
+    if (tui->selected >= tui->top + visible) tui->top = tui->selected - visible + 1;
+    if (tui->top > count - visible) tui->top = count - visible;
+    if (tui->top < 0) tui->top = 0;
+    
+    if (count > 0) {
+        const container_info_t *info = &tui->order[tui->selected].container->info;
+        memcpy(tui->selected_id, info->id, sizeof(tui->selected_id));
+        tui->selected_host = info->host;
+    } else {
+        tui->selected_id[0] = '\0';
+    }
+    
+    for (int i = tui->top; i < count && i < tui->top + visible; i++) {
+        draw_row(tui, state, 3 + i - tui->top, tui->order[i].container, value_count, name_width, spark_width,
+                 i == tui->selected ? ATTR_REVERSE : 0);
+    }
+    
+    draw_footer(tui, state, count);
+}
+
+static void draw_row(tui_t *tui, const monitor_state_t *state, int row, const container_monitor_t *container,
+                     int value_count, int name_width, int spark_width, uint8_t attr) {
+    char values[7][16];
+    int col;
+    
+    if (attr) {
+        fill_row(tui, row, attr);
+    }
+    put_text(tui, row, 0, name_width, container->info.name, attr, 0);
+    col = name_width + 1;
+    if (state->host_count > 1) {
+        put_text(tui, row, col, HOST_WIDTH, monitor_host_name(state, container->info.host), attr, 0);
+        col += HOST_WIDTH + 1;
+    }
+    
+    if (!container->is_running) {
+        put_text(tui, row, col, tui->cols - col, container->info.status, attr, 0);
+        return;
+    }
+    
+    snprintf(values[0], sizeof(values[0]), "%.1f", container->cpu_percent);
+    format_compact(values[1], sizeof(values[1]), (double)container->memory_working_set);
+    snprintf(values[2], sizeof(values[2]), "%.1f", container->memory_percent);
+    format_compact(values[3], sizeof(values[3]), container->network_rx_rate);
+    format_compact(values[4], sizeof(values[4]), container->network_tx_rate);
+    format_compact(values[5], sizeof(values[5]), container->block_read_rate);
+    format_compact(values[6], sizeof(values[6]), container->block_write_rate);
+    for (int i = 0; i < value_count; i++) {
+        put_text(tui, row, col, VALUE_WIDTH, values[i], attr, 1);
+        col += VALUE_WIDTH + 1;
+    }
+    
+    /* scaled to the row's own peak so idle containers still show their shape */
+    if (spark_width && container->history) {
+        float history[SPARK_WIDTH];
+        int samples = timeseries_recent(container->history, TS_CPU_PERCENT, history, spark_width);
+        float peak = 1.0f;
+        
+        for (int i = 0; i < samples; i++) {
+            if (history[i] > peak) peak = history[i];
+        }
+        col += spark_width - samples;
+        for (int i = 0; i < samples; i++) {
+            int level = history[i] > 0.0f ? (int)(history[i] / peak * 7.0f + 0.5f) : 0;
+            put_text(tui, row, col++, 1, sparks[level], attr, 0);
+        }
+    }
+}
+
+/* the selected container's details and the key help, replaced by the last
+   stderr line for a while after one arrives */
+static void draw_footer(tui_t *tui, const monitor_state_t *state, int count) {
+    char line[1024];
+    
+    if (count > 0) {
+        const container_monitor_t *container = tui->order[tui->selected].container;
+        snprintf(line, sizeof(line), "%.12s  %s  %s  [%d/%d]",
+                 container->info.id,
+                 container->info.image,
+                 container->info.status,
+                 tui->selected + 1,
+                 count);
+        put_text(tui, tui->rows - 2, 0, tui->cols, line, 0, 0);
+    } else {
+        put_text(tui, tui->rows - 2, 0, tui->cols,
+                 state->container_count > 0 ? "" : "Нет контейнеров", 0, 0);
+    }
+    
+    fill_row(tui, tui->rows - 1, ATTR_REVERSE);
+    if (tui->message[0] && monotonic_ns() - tui->message_ns < MESSAGE_SECONDS * 1000000000ULL) {
+        put_text(tui, tui->rows - 1, 0, tui->cols - 1, tui->message, ATTR_REVERSE | ATTR_BOLD, 0);
+    } else {
+        put_text(tui, tui->rows - 1, 0, tui->cols - 1,
+                 "q выход  ↑↓ PgUp PgDn выбор  c m n d a сортировка  r обратный порядок  l перерисовать",
+                 ATTR_REVERSE, 0);
+    }
+}
+
+/* only cells that differ from the shown frame are written; the cursor is
+   moved over long runs of unchanged cells and short ones are rewritten */
+static int flush_frame(tui_t *tui) {
+    text_buffer_t *out = &tui->out;
+    tui_cell_t blank = {{' '}, 1, 0};
+    int cursor_row = -1;
+    int cursor_col = -1;
+    uint8_t attr = 0;
+    
+    text_buffer_reset(out);
+    if (!tui->shown_valid) {
+        text_buffer_append_str(out, "\x1b[0m\x1b[2J");
+        for (int i = 0; i < tui->rows * tui->cols; i++) {
+            tui->shown[i] = blank;
+        }
+        tui->shown_valid = 1;
+    }
+    
+    for (int row = 0; row < tui->rows; row++) {
+        tui_cell_t *frame = &tui->frame[row * tui->cols];
+        tui_cell_t *shown = &tui->shown[row * tui->cols];
+        
+        for (int col = 0; col < tui->cols; col++) {
+            if (memcmp(&frame[col], &shown[col], sizeof(tui_cell_t)) == 0) continue;
+            
+            if (row == cursor_row && col > cursor_col && col - cursor_col <= MAX_REWRITE_GAP) {
+                for (; cursor_col < col; cursor_col++) {
+                    emit_cell(out, &frame[cursor_col], &attr);
+                }
+            } else if (row != cursor_row || col != cursor_col) {
+                text_buffer_printf(out, "\x1b[%d;%dH", row + 1, col + 1);
+            }
+            
+            emit_cell(out, &frame[col], &attr);
+            shown[col] = frame[col];
+            cursor_row = row;
+            cursor_col = col + 1;
+        }
+    }
+    
+    if (attr) {
+        text_buffer_append_str(out, "\x1b[0m");
+    }
+    if (out->failed) {
+        tui->shown_valid = 0;
+        return -1;
+    }
+    if (out->len > 0 && write_all(STDOUT_FILENO, out->data, out->len) != 0) {
+        tui->shown_valid = 0;
+        return -1;
+    }
+    
+    tui->frames++;
+    tui->bytes += out->len;
+    return 0;
+}
+
+static void emit_cell(text_buffer_t *out, const tui_cell_t *cell, uint8_t *attr) {
+    if (cell->attr != *attr) {
+        text_buffer_append(out, "\x1b[0", 3);
+        if (cell->attr & ATTR_BOLD) text_buffer_append(out, ";1", 2);
+        if (cell->attr & ATTR_REVERSE) text_buffer_append(out, ";7", 2);
+        text_buffer_append(out, "m", 1);
+        *attr = cell->attr;
+    }
+    text_buffer_append(out, cell->ch, cell->len);
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -7,7 +8,9 @@
 void print_timestamp(void) {
     time_t now = time(NULL);
     char time_str[64];
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_info);
     printf("[%s] ", time_str);
 }
 
@@ -40,4 +43,10 @@ void format_duration(time_t duration, char *buffer, size_t size) {
     } else {
         snprintf(buffer, size, "%02ds", seconds);
     }
-} 
\ No newline at end of file
+}
+
+uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}